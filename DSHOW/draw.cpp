@@ -31,190 +31,115 @@
 #include "draw.h"
 #include <windows.h>
 
-void draw_8bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count, unsigned char *mem2)
-{
-	for(U32 y=0; y<h; y++)
-	{
-		unsigned char *mem1 = mem;
-		unsigned char color1 = count * y / h * add + color;
-#ifdef _M_AMD64
-		__stosq((unsigned long long *)mem1, ((unsigned long long)color1) * 0x0101010101010101, w >> 3);
-		__stosb(&mem1[w & ~7], color1, w & 7);
-#else
-		__stosd((unsigned long *)mem1, ((unsigned int)color1) * 0x01010101, w >> 2);
-		__stosb(&mem1[w & ~3], color1, w & 3);
-#endif
-		mem += pitch;
-		if(mem2)
+// count * y / h for each row in turn, stepped so there is no divide per row.
+// Kept in 64 bits, count * y passes 32 bits on 16 bit frames taller than 65535.
+struct RowStep
+{
+	U32 step;
+	U32 rem;
+	U32 whole;
+	U32 part;
+	U32 h;
+	RowStep(U32 count, U32 h, U32 y) : step(0), rem(0), whole(0), part(0), h(h)
+	{
+		if(h == 0)
+			return;
+		whole = count / h;
+		part = count % h;
+		step = (U32)((U64)count * y / h);
+		rem = (U32)((U64)count * y % h);
+	}
+	void next()
+	{
+		step += whole;
+		rem += part;
+		if(rem >= h)
 		{
-			unsigned char *tmp1 = mem;
-			mem=mem2;
-			mem2=tmp1;
+			rem -= h;
+			step++;
 		}
 	}
-}
-void draw_16bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count)
-{
-	for(U32 y=0; y<h; y++)
-	{
-		unsigned short *mem1 = (unsigned short *)&mem[(intptr_t)y*pitch];
-		unsigned short color1 = count * y / h * add + color;
-		__stosw(mem1, color1, w);
-		//for(U32 x=0; x<w; x++)
-		//	mem1[x] = color1;
-	}
-}
-void draw_16bit_swap(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count)
+};
+
+// the rows of first to end that pass draws
+static void stripeRows(const DrawPass &pass, U32 first, U32 end, U32 &y0, U32 &y1)
 {
-	for(U32 y=0; y<h; y++)
+	if(pass.stripes <= 1)
 	{
-		unsigned short *mem1 = (unsigned short *)&mem[(intptr_t)y*pitch];
-		unsigned short color1 = _byteswap_ushort((U16)(count * y / h * add + color));
-		__stosw(mem1, color1, w);
-		//for(U32 x=0; x<w; x++)
-		//	mem1[x] = color1;
-	}
-}
-void draw_24bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count)
-{
-	if(w == 0)
+		y0 = first;
+		y1 = end;
 		return;
-	for(U32 y=0; y<h; y++)
-	{
-		unsigned char *mem1 = &mem[(intptr_t)y*pitch];
-		unsigned int color1 = (count * y / h * add + color) & 0xFFFFFF;
-		unsigned int color2 = (color1 >> 8) | (color1 << 16);
-		unsigned int color3 = (color1 >> 16) | (color1 << 8);
-		color1 = color1 | (color1 << 24);
-		U32 x=0;
-		while(x+4<=w)
-		{
-			*((U32*)&mem1[x*3]) = color1;
-			*((U32*)&mem1[x*3+(uintptr_t)4]) = color2;
-			*((U32*)&mem1[x*3+(uintptr_t)8]) = color3;
-			x+=4;
-		}
-		while(x<w)
-		{
-			*((U16*)&mem1[x*3]) = (U16)color1;
-			mem1[x*3+2] = color3;
-			x++;
-		}
-	}
-}
-void draw_32bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count)
-{
-	for(U32 y=0; y<h; y++)
-	{
-		unsigned int *mem1 = (unsigned int *)&mem[(intptr_t)y*pitch];
-		unsigned int color1 = count * y / h * add + color;
-		__stosd((unsigned long *)mem1, color1, w);
-		//for(U32 x=0; x<w; x++)
-		//	mem1[x] = color1;
-	}
-}
-void draw_32bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count, unsigned char *mem2)
-{
-	for(U32 y=0; y<h; y++)
-	{
-		unsigned int *mem1 = (unsigned int *)mem;
-		unsigned int color1 = count * y / h * add + color;
-		__stosd((unsigned long *)mem1, color1, w);
-		//for(U32 x=0; x<w; x++)
-		//	mem1[x] = color1;
-		mem += pitch;
-		if(mem2)
-		{
-			unsigned char *tmp1 = mem;
-			mem=mem2;
-			mem2=tmp1;
-		}
 	}
+	y0 = first + (U32)((U64)(end - first) * pass.stripe / pass.stripes);
+	y1 = first + (U32)((U64)(end - first) * (pass.stripe + 1) / pass.stripes);
 }
-void draw_32bit_swap(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count)
-{
-	for(U32 y=0; y<h; y++)
-	{
-		unsigned int *mem1 = (unsigned int *)&mem[(intptr_t)y*pitch];
-		unsigned int color1 = _byteswap_ulong(count * y / h * add + color);
-		__stosd((unsigned long *)mem1, color1, w);
-		//for(U32 x=0; x<w; x++)
-		//	mem1[x] = color1;
-	}
-}
-void draw_48bit(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count)
+
+// with mem2, rows alternate between mem and mem2
+static unsigned char *rowPointer(unsigned char *mem, unsigned char *mem2, int pitch, U32 y)
 {
-	for(U32 y=0; y<h; y++)
-	{
-		U16 *mem1 = (U16 *)&mem[(intptr_t)y*pitch];
-		U64 color1 = count * y / h * add + color;
-		U16 color1b = color1 >> 32;
-		for(U32 x=0; x<w; x++)
-		{
-			*((U32*)&mem1[x*3]) = (U32)color1;
-			mem1[x*3+2] = color1b;
-		}
-	}
+	if(mem2)
+		return (y & 1 ? mem2 : mem) + (intptr_t)(y >> 1)*pitch;
+	return mem + (intptr_t)y*pitch;
 }
-void draw_48bit_swap16(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count)
+
+// per pixel byte order, SWAP_16 swaps each 16 bit channel on its own
+template<int BYTES, DRAW_SWAP SWAP>
+static inline U64 swapPixel(U64 c)
 {
-	for(U32 y=0; y<h; y++)
+	if(SWAP == SWAP_16)
+		return ((c >> 8) & 0x00FF00FF00FF00FF) | ((c & 0x00FF00FF00FF00FF) << 8);
+	if(SWAP == SWAP_BYTES)
 	{
-		U16 *mem1 = (U16 *)&mem[(intptr_t)y*pitch];
-		U64 color1 = count * y / h * add + color;
-		color1 = ((color1 >> 8) & 0x00FF00FF00FF00FF) | ((color1 & 0x00FF00FF00FF00FF) << 8);
-		U16 color1b = color1 >> 32;
-		for(U32 x=0; x<w; x++)
+		switch(BYTES)
 		{
-			*((U32*)&mem1[x*3]) = (U32)color1;
-			mem1[x*3+2] = color1b;
+		case 2: return _byteswap_ushort((U16)c);
+		case 4: return _byteswap_ulong((U32)c);
+		case 8: return _byteswap_uint64(c);
 		}
 	}
+	return c;
 }
-void draw_64bit(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count)
-{
-	for(U32 y=0; y<h; y++)
-	{
-		U64 *mem1 = (U64 *)&mem[(intptr_t)y*pitch];
-		U64 color1 = count * y / h * add + color;
-#ifdef _M_AMD64
-		__stosq(mem1, color1, w);
-#else
-		for(U32 x=0; x<w; x++)
-			mem1[x] = color1;
-#endif
-	}
-}
-void draw_64bit_swap(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count)
+
+template<int BYTES>
+static inline void fillPixels(unsigned char *mem, U64 c, U32 w, bool streaming)
 {
-	for(U32 y=0; y<h; y++)
+	switch(BYTES)
 	{
-		U64 *mem1 = (U64 *)&mem[(intptr_t)y*pitch];
-		U64 color1 = _byteswap_uint64(count * y / h * add + color);
-#ifdef _M_AMD64
-		__stosq(mem1, color1, w);
-#else
-		for(U32 x=0; x<w; x++)
-			mem1[x] = color1;
-#endif
+	case 1: fill_row(mem, (U8)c * 0x0101010101010101ull, w, streaming); break;
+	case 2: fill_row(mem, (U16)c * 0x0001000100010001ull, (size_t)w*2, streaming); break;
+	case 3: fill_row24(mem, (U32)c & 0xFFFFFF, (size_t)w*3, streaming); break;
+	case 4: fill_row(mem, (U32)c * 0x0000000100000001ull, (size_t)w*4, streaming); break;
+	case 6: fill_row48(mem, c, (size_t)w*6, streaming); break;
+	case 8: fill_row(mem, c, (size_t)w*8, streaming); break;
 	}
 }
-void draw_64bit_swap16(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count)
+
+template<int BYTES, DRAW_SWAP SWAP, bool FIELDS>
+void draw_rows(const DrawPass &pass, unsigned char *mem, unsigned char *mem2, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count)
 {
-	for(U32 y=0; y<h; y++)
+	U32 y0, y1;
+	stripeRows(pass, 0, h, y0, y1);
+	RowStep row(count, h, y0);
+	for(U32 y=y0; y<y1; y++, row.next())
 	{
-		U64 *mem1 = (U64 *)&mem[(intptr_t)y*pitch];
-		U64 color1 = count * y / h * add + color;
-		color1 = ((color1 >> 8) & 0x00FF00FF00FF00FF) | ((color1 & 0x00FF00FF00FF00FF) << 8);
-#ifdef _M_AMD64
-		__stosq(mem1, color1, w);
-#else
-		for(U32 x=0; x<w; x++)
-			mem1[x] = color1;
-#endif
+		unsigned char *mem1 = FIELDS ? rowPointer(mem, mem2, pitch, y) : &mem[(intptr_t)y*pitch];
+		fillPixels<BYTES>(mem1, swapPixel<BYTES, SWAP>(row.step * add + color), w, pass.streaming);
 	}
 }
-void draw_8bit_bayer(unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h, U32 color, U32 add, U32 count)
+template void draw_rows<1, SWAP_NONE, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<1, SWAP_NONE, true>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<2, SWAP_NONE, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<2, SWAP_BYTES, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<3, SWAP_NONE, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<4, SWAP_NONE, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<4, SWAP_NONE, true>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<4, SWAP_BYTES, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<6, SWAP_NONE, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<6, SWAP_16, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<8, SWAP_NONE, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<8, SWAP_BYTES, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+template void draw_rows<8, SWAP_16, false>(const DrawPass &, unsigned char *, unsigned char *, int, U32, U32, U64, U64, U32);
+void draw_8bit_bayer(const DrawPass &pass, unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h, U32 color, U32 add, U32 count)
 {
 	if(x & 1)
 	{
@@ -222,18 +147,21 @@ void draw_8bit_bayer(unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h,
 		add = ((add >> 8) & 0xFF00FF) | ((add << 8) & 0xFF00FF00);
 	}
 	h += y;
-	for(; y<h; y++)
+	U32 y1;
+	stripeRows(pass, y, h, y, y1);
+	RowStep row(count, h, y);
+	for(; y<y1; y++, row.next())
 	{
-		unsigned int color1 = count * y / h * add + color;
+		unsigned int color1 = row.step * add + color;
 		if(y & 1) color1 = color1 >> 16;
 		unsigned char *mem1 = &mem[(intptr_t)y*pitch+x];
-		for(U32 x2=0; x2<w; x2+=2)
+		for(U32 x2=0; x2+1<w; x2+=2)
 			*((unsigned short *)&mem1[x2]) = color1;
 		if(w & 1)
 			mem1[w-1] = color1;
 	}
 }
-void draw_16bit_bayer(unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h, U64 color, U64 add, U32 count)
+void draw_16bit_bayer(const DrawPass &pass, unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h, U64 color, U64 add, U32 count)
 {
 	if(x & 1)
 	{
@@ -241,12 +169,15 @@ void draw_16bit_bayer(unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h,
 		add = ((add >> 16) & 0xFFFF0000FFFF) | ((add << 16) & 0xFFFF0000FFFF0000);
 	}
 	h += y;
-	for(; y<h; y++)
+	U32 y1;
+	stripeRows(pass, y, h, y, y1);
+	RowStep row(count, h, y);
+	for(; y<y1; y++, row.next())
 	{
-		U64 color1 = count * y / h * add + color;
+		U64 color1 = row.step * add + color;
 		if(y & 1) color1 = color1 >> 32;
 		unsigned short *mem1 = ((unsigned short *)&mem[(intptr_t)y*pitch]) + x;
-		for(U32 x2=0; x2<w; x2+=2)
+		for(U32 x2=0; x2+1<w; x2+=2)
 			*((unsigned int *)&mem1[x2]) = color1;
 		if(w & 1)
 			mem1[w-1] = color1;
@@ -262,7 +193,7 @@ static void colorconvert_v210(unsigned int *out, unsigned int in)
 	out[3] = (in >> 10) | ((in << 10) & 0x3FF00000);
 }
 
-void draw_v210(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 color, U32 add, U32 count)
+void draw_v210(const DrawPass &pass, unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 color, U32 add, U32 count)
 {
 	static const unsigned char xstartlist[6] = {0,1,1,2,2,3};
 	static const unsigned char xendlist[6] = {0,1,2,2,3,3};
@@ -276,14 +207,17 @@ void draw_v210(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 co
 	if(x1 == xend)
 		xmaskend &= xmaskstart;
 
-	for(U32 y=0; y<h; y++)
+	U32 y0, y1;
+	stripeRows(pass, 0, h, y0, y1);
+	RowStep row(count, h, y0);
+	for(U32 y=y0; y<y1; y++, row.next())
 	{
 		unsigned int *mem1 = (unsigned int *)&mem[(intptr_t)y*pitch];
 		union M128U32{
 			unsigned long long u64[2];  // on 64 bit, faster copy
 			unsigned int u32[4];
 		} color1;
-		colorconvert_v210(color1.u32, count * y / h * add + color);
+		colorconvert_v210(color1.u32, row.step * add + color);
 		U32 x = x1;
 		if(x < xend)
 		{
@@ -312,7 +246,7 @@ void draw_v210(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 co
 	}
 }
 
-void draw_Y41P(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 color, U32 add, U32 count, unsigned char *mem2)
+void draw_Y41P(const DrawPass &pass, unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 color, U32 add, U32 count, unsigned char *mem2)
 {
 	static const unsigned char xstartlist[8] = {0,0,1,1,1,2,2,2};
 	static const unsigned char xendlist[8] = {0,0,1,1,1,2,2,2};
@@ -335,20 +269,24 @@ void draw_Y41P(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 co
 	}
 
 
-	for(U32 y=0; y<h; y++)
+	U32 y0, y1;
+	stripeRows(pass, 0, h, y0, y1);
+	RowStep row(count, h, y0);
+	for(U32 y=y0; y<y1; y++, row.next())
 	{
-		unsigned int *mem1 = (unsigned int *)mem;
-		unsigned int color1 = count * y / h * add + color;
+		unsigned int *mem1 = (unsigned int *)rowPointer(mem, mem2, pitch, y);
+		unsigned int color1 = row.step * add + color;
 		unsigned int color1y = U8(color1 >> 8);
 		color1y = color1y << 8 | color1y;
 		color1y = color1y << 16 | color1y;
 		U32 x = x1;
+		U32 xmask1 = xmaskstart;
 		if(xpos)
 		{
 			if(x == 0)
 			{
-				mem1[0] = (mem1[0] & ~xmaskstart) | (color1 & xmaskstart);
-				xmaskstart = 0xFFFFFFFF;
+				mem1[0] = (mem1[0] & ~xmask1) | (color1 & xmask1);
+				xmask1 = 0xFFFFFFFF;
 				if(xend <= 1)
 				{
 					if(xend == 1)
@@ -358,7 +296,7 @@ void draw_Y41P(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 co
 			}
 			if(x <= 1)
 			{
-				mem1[1] = (mem1[1] & ~xmaskstart) | (color1 & xmaskstart);
+				mem1[1] = (mem1[1] & ~xmask1) | (color1 & xmask1);
 				if(xend <= 2)
 				{
 					if(xend == 2)
@@ -368,7 +306,7 @@ void draw_Y41P(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 co
 				mem1[2] = color1y;
 			}
 			else
-				mem1[2] = (mem1[2] & ~xmaskstart) | (color1y & xmaskstart);
+				mem1[2] = (mem1[2] & ~xmask1) | (color1y & xmask1);
 			x = 3;
 		}
 		while(x < xend - 2)
@@ -385,59 +323,56 @@ void draw_Y41P(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 co
 		case 1: mem1[x] = color1; mem1[x+1] = (mem1[x+1] & ~xmaskend) | (color1 & xmaskend); break;
 		case 2: mem1[x+1] = mem1[x] = color1; mem1[x+2] = (mem1[x+2] & ~xmaskend) | (color1y & xmaskend);
 		}
-		mem += pitch;
-		if(mem2)
-		{
-			unsigned char *tmp1 = mem;
-			mem=mem2;
-			mem2=tmp1;
-		}
-
 	}
 }
 
 
-void drawIntinsityLayer8(unsigned char *pData, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, unsigned char *mem2)
+void drawIntinsityLayer8(const DrawPass &pass, unsigned char *pData, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, unsigned char *mem2)
 {
-	draw_8bit(&pData[0], pitch, width3, height, 0x80, 0x00, 256, mem2);
-	if(mem2) mem2 += width3;
-	draw_8bit(&pData[width3], pitch, width-width3, height, 0x00, 0x01, 256, mem2);
+	if(mem2)
+	{
+		draw_bits<1, SWAP_NONE>(pass, &pData[0], pitch, width3, height, 0x80, 0x00, 256, mem2);
+		draw_bits<1, SWAP_NONE>(pass, &pData[width3], pitch, width-width3, height, 0x00, 0x01, 256, &mem2[width3]);
+		return;
+	}
+	draw_bits<1, SWAP_NONE>(pass, &pData[0], pitch, width3, height, 0x80, 0x00, 256);
+	draw_bits<1, SWAP_NONE>(pass, &pData[width3], pitch, width-width3, height, 0x00, 0x01, 256);
 }
-void drawColorLayer8(unsigned char *pDatau, unsigned char *pDatav, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width)
+void drawColorLayer8(const DrawPass &pass, unsigned char *pDatau, unsigned char *pDatav, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width)
 {
-	draw_8bit(&pDatau[0], pitch, width2, height, 0x00, 0x01, 256);
-	draw_8bit(&pDatau[width2], pitch, width-width2, height, 0x80, 0x00, 256);
-	draw_8bit(&pDatav[0], pitch, width1, height, 0x80, 0x00, 256);
-	draw_8bit(&pDatav[width1], pitch, width3-width1, height, 0x00, 0x01, 256);
-	draw_8bit(&pDatav[width3], pitch, width-width3, height, 0x80, 0x00, 256);
+	draw_bits<1, SWAP_NONE>(pass, &pDatau[0], pitch, width2, height, 0x00, 0x01, 256);
+	draw_bits<1, SWAP_NONE>(pass, &pDatau[width2], pitch, width-width2, height, 0x80, 0x00, 256);
+	draw_bits<1, SWAP_NONE>(pass, &pDatav[0], pitch, width1, height, 0x80, 0x00, 256);
+	draw_bits<1, SWAP_NONE>(pass, &pDatav[width1], pitch, width3-width1, height, 0x00, 0x01, 256);
+	draw_bits<1, SWAP_NONE>(pass, &pDatav[width3], pitch, width-width3, height, 0x80, 0x00, 256);
 }
-void drawColorLayer8_interleaved(unsigned char *pDatac, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, bool reversed)
+void drawColorLayer8_interleaved(const DrawPass &pass, unsigned char *pDatac, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, bool reversed)
 {
-	draw_16bit(&pDatac[0], pitch, width1, height, reversed ? 0x0080 : 0x8000, reversed ? 0x0100 : 0x0001, 256);
-	draw_16bit(&pDatac[width1*2], pitch, width2-width1, height, 0x0000, 0x0101, 256);
-	draw_16bit(&pDatac[width2*2], pitch, width3-width2, height, reversed ? 0x8000 : 0x0080, reversed ? 0x0001 : 0x0100, 256);
-	draw_16bit(&pDatac[width3*2], pitch, width-width3, height, 0x8080, 0x0000, 256);
+	draw_bits<2, SWAP_NONE>(pass, &pDatac[0], pitch, width1, height, reversed ? 0x0080 : 0x8000, reversed ? 0x0100 : 0x0001, 256);
+	draw_bits<2, SWAP_NONE>(pass, &pDatac[width1*2], pitch, width2-width1, height, 0x0000, 0x0101, 256);
+	draw_bits<2, SWAP_NONE>(pass, &pDatac[width2*2], pitch, width3-width2, height, reversed ? 0x8000 : 0x0080, reversed ? 0x0001 : 0x0100, 256);
+	draw_bits<2, SWAP_NONE>(pass, &pDatac[width3*2], pitch, width-width3, height, 0x8080, 0x0000, 256);
 }
 
-void drawIntinsityLayer16(unsigned char *pData, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width)
+void drawIntinsityLayer16(const DrawPass &pass, unsigned char *pData, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width)
 {
-	draw_16bit(&pData[0], pitch, width3, height, 0x8000, 0x0000, 65536);
-	draw_16bit(&pData[width3*2], pitch, width-width3, height, 0x0000, 0x0001, 65536);
+	draw_bits<2, SWAP_NONE>(pass, &pData[0], pitch, width3, height, 0x8000, 0x0000, 65536);
+	draw_bits<2, SWAP_NONE>(pass, &pData[width3*2], pitch, width-width3, height, 0x0000, 0x0001, 65536);
 }
-void drawColorLayer16(unsigned char *pDatau, unsigned char *pDatav, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width)
+void drawColorLayer16(const DrawPass &pass, unsigned char *pDatau, unsigned char *pDatav, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width)
 {
-	draw_16bit(&pDatau[0], pitch, width2, height, 0x0000, 0x0001, 65536);
-	draw_16bit(&pDatau[width2*2], pitch, width-width2, height, 0x8000, 0x0000, 65536);
-	draw_16bit(&pDatav[0], pitch, width1, height, 0x8000, 0x0000, 65536);
-	draw_16bit(&pDatav[width1*2], pitch, width3-width1, height, 0x0000, 0x0001, 65536);
-	draw_16bit(&pDatav[width3*2], pitch, width-width3, height, 0x8000, 0x0000, 65536);
+	draw_bits<2, SWAP_NONE>(pass, &pDatau[0], pitch, width2, height, 0x0000, 0x0001, 65536);
+	draw_bits<2, SWAP_NONE>(pass, &pDatau[width2*2], pitch, width-width2, height, 0x8000, 0x0000, 65536);
+	draw_bits<2, SWAP_NONE>(pass, &pDatav[0], pitch, width1, height, 0x8000, 0x0000, 65536);
+	draw_bits<2, SWAP_NONE>(pass, &pDatav[width1*2], pitch, width3-width1, height, 0x0000, 0x0001, 65536);
+	draw_bits<2, SWAP_NONE>(pass, &pDatav[width3*2], pitch, width-width3, height, 0x8000, 0x0000, 65536);
 }
-void drawColorLayer16_interleaved(unsigned char *pDatac, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, bool reversed)
+void drawColorLayer16_interleaved(const DrawPass &pass, unsigned char *pDatac, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, bool reversed)
 {
-	draw_32bit(&pDatac[0], pitch, width1, height, reversed ? 0x00008000 : 0x80000000, reversed ? 0x00010000 : 0x00000001, 65536);
-	draw_32bit(&pDatac[width1*4], pitch, width2-width1, height, 0x00000000, 0x00010001, 65536);
-	draw_32bit(&pDatac[width2*4], pitch, width3-width2, height, reversed ? 0x80000000 : 0x00008000, reversed ? 0x00000001 : 0x00010000, 65536);
-	draw_32bit(&pDatac[width3*4], pitch, width-width3, height, 0x80008000, 0x00000000, 65536);
+	draw_bits<4, SWAP_NONE>(pass, &pDatac[0], pitch, width1, height, reversed ? 0x00008000 : 0x80000000, reversed ? 0x00010000 : 0x00000001, 65536);
+	draw_bits<4, SWAP_NONE>(pass, &pDatac[width1*4], pitch, width2-width1, height, 0x00000000, 0x00010001, 65536);
+	draw_bits<4, SWAP_NONE>(pass, &pDatac[width2*4], pitch, width3-width2, height, reversed ? 0x80000000 : 0x00008000, reversed ? 0x00000001 : 0x00010000, 65536);
+	draw_bits<4, SWAP_NONE>(pass, &pDatac[width3*4], pitch, width-width3, height, 0x80008000, 0x00000000, 65536);
 }
 
 
@@ -34,30 +34,55 @@ typedef unsigned short U16;
 typedef unsigned int U32;
 typedef unsigned long long U64;
 
-void draw_8bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count, unsigned char *mem2 = 0);
-void draw_16bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count);
-void draw_16bit_swap(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count);
-void draw_24bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count);
-void draw_32bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 countunsigned);
-void draw_32bit(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 countunsigned, unsigned char *mem2);
-void draw_32bit_swap(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count);
-void draw_48bit(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count);
-void draw_48bit_swap16(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count);
-void draw_64bit(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count);
-void draw_64bit_swap(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count);
-void draw_64bit_swap16(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count);
-void draw_8bit_bayer(unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h, U32 color, U32 add, U32 count);
-void draw_16bit_bayer(unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h, U64 color, U64 add, U32 count);
-void draw_v210(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 color, U32 add, U32 count);
-void draw_Y41P(unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 color, U32 add, U32 count, unsigned char *mem2 = 0);
-void drawIntinsityLayer8(unsigned char *pData, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, unsigned char *mem2 = 0);
-void drawColorLayer8(unsigned char *pDatau, unsigned char *pDatav, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width);
-void drawColorLayer8_interleaved(unsigned char *pDatac, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, bool reversed);
-void drawIntinsityLayer16(unsigned char *pData, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width);
-void drawColorLayer16(unsigned char *pDatau, unsigned char *pDatav, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width);
-void drawColorLayer16_interleaved(unsigned char *pDatac, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, bool reversed);
-typedef void (*(DrawBitFunc64))(unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count);
-typedef void (*(DrawBitFunc32))(unsigned char *mem, int pitch, U32 w, U32 h, U32 color, U32 add, U32 count);
+// fill a row with a repeating 8 byte pattern, see fill.cpp.  streaming
+// uses non-temporal stores, fillFlush when done.
+void fill_row(unsigned char *mem, U64 pattern, size_t bytes, bool streaming);
+void fill_row24(unsigned char *mem, U32 pattern, size_t bytes, bool streaming);
+void fill_row48(unsigned char *mem, U64 pattern, size_t bytes, bool streaming);
+void fillFlush();
+// memcpy, with non-temporal stores when streaming
+void fill_copy(unsigned char *dst, const unsigned char *src, size_t bytes, bool streaming);
+
+// Each draw call splits its rows into "stripes" parts and only draws part
+// "stripe", so threads can share a frame.  {0, 1} draws every row.
+struct DrawPass
+{
+	U32 stripe;
+	U32 stripes;
+	bool streaming;		// Fills use non-temporal stores
+};
+
+enum DRAW_SWAP
+{
+	SWAP_NONE,
+	SWAP_BYTES,	// whole pixel byte swapped
+	SWAP_16,	// each 16 bit channel byte swapped
+};
+// fills w pixels of BYTES bytes on each row with color + count * y / h * add,
+// instantiated for the pixel sizes in use in draw.cpp
+template<int BYTES, DRAW_SWAP SWAP, bool FIELDS>
+void draw_rows(const DrawPass &pass, unsigned char *mem, unsigned char *mem2, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count);
+template<int BYTES, DRAW_SWAP SWAP>
+inline void draw_bits(const DrawPass &pass, unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count)
+{
+	draw_rows<BYTES, SWAP, false>(pass, mem, 0, pitch, w, h, color, add, count);
+}
+// rows alternate between mem and mem2
+template<int BYTES, DRAW_SWAP SWAP>
+inline void draw_bits(const DrawPass &pass, unsigned char *mem, int pitch, U32 w, U32 h, U64 color, U64 add, U32 count, unsigned char *mem2)
+{
+	draw_rows<BYTES, SWAP, true>(pass, mem, mem2, pitch, w, h, color, add, count);
+}
+void draw_8bit_bayer(const DrawPass &pass, unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h, U32 color, U32 add, U32 count);
+void draw_16bit_bayer(const DrawPass &pass, unsigned char *mem, int pitch, U32 x, U32 y, U32 w, U32 h, U64 color, U64 add, U32 count);
+void draw_v210(const DrawPass &pass, unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 color, U32 add, U32 count);
+void draw_Y41P(const DrawPass &pass, unsigned char *mem, int pitch, U32 xpos, U32 xend1, U32 h, U32 color, U32 add, U32 count, unsigned char *mem2 = 0);
+void drawIntinsityLayer8(const DrawPass &pass, unsigned char *pData, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, unsigned char *mem2 = 0);
+void drawColorLayer8(const DrawPass &pass, unsigned char *pDatau, unsigned char *pDatav, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width);
+void drawColorLayer8_interleaved(const DrawPass &pass, unsigned char *pDatac, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, bool reversed);
+void drawIntinsityLayer16(const DrawPass &pass, unsigned char *pData, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width);
+void drawColorLayer16(const DrawPass &pass, unsigned char *pDatau, unsigned char *pDatav, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width);
+void drawColorLayer16_interleaved(const DrawPass &pass, unsigned char *pDatac, int pitch, U32 height, U32 width1, U32 width2, U32 width3, U32 width, bool reversed);
 
 
 
@@ -0,0 +1,623 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <intrin.h>
+#include "draw.h"
+
+// Row fill kernels.  Every kernel writes "bytes" bytes of a repeating 8 byte
+// pattern (3 or 6 bytes for fill_row24 and fill_row48), byte 0 of the pattern
+// going to mem[0].  8, 16, 32 and 64 bit fills all become this by repeating
+// the pixel value across the pattern.  Odd byte counts just end part way
+// through the pattern.
+
+#if _MSC_VER >= 1800
+#define FILL_HAVE_AVX2
+#endif
+#if _MSC_VER >= 1911 && defined(_M_AMD64)
+#define FILL_HAVE_AVX512
+#endif
+
+// pattern as seen from a store starting "offset" bytes into the row
+static U64 fill_phase(U64 pattern, size_t offset)
+{
+	return _rotr64(pattern, (int)(offset & 7) * 8);
+}
+
+static void fill_row_c(unsigned char *mem, U64 pattern, size_t bytes)
+{
+	size_t n = bytes >> 3;
+#ifdef _M_AMD64
+	__stosq((unsigned long long *)mem, pattern, n);
+#else
+	U64 *mem1 = (U64 *)mem;
+	for(size_t x=0; x<n; x++)
+		mem1[x] = pattern;
+#endif
+	mem += n * 8;
+	for(size_t x=0; x<(bytes & 7); x++)
+	{
+		mem[x] = (unsigned char)pattern;
+		pattern >>= 8;
+	}
+}
+
+static __m128i fill_set128(U64 pattern)
+{
+	return _mm_set_epi32((int)(pattern >> 32), (int)pattern, (int)(pattern >> 32), (int)pattern);
+}
+
+// "stream" selects non-temporal stores for the aligned body, they bypass the
+// cache so a frame bigger than the cache does not have to be read in first
+
+static __forceinline void fill_sse2(unsigned char *mem, U64 pattern, size_t bytes, bool stream)
+{
+	if(bytes < 16)
+	{
+		fill_row_c(mem, pattern, bytes);
+		return;
+	}
+	unsigned char *end = mem + bytes;
+	size_t head = (0 - (uintptr_t)mem) & 15;
+
+	// unaligned head, aligned body, then an unaligned tail overlapping the body
+	_mm_storeu_si128((__m128i *)mem, fill_set128(pattern));
+	__m128i color = fill_set128(fill_phase(pattern, head));
+	unsigned char *mem1 = mem + head;
+	while(mem1 + 64 <= end)
+	{
+		if(stream)
+		{
+			_mm_stream_si128((__m128i *)&mem1[0], color);
+			_mm_stream_si128((__m128i *)&mem1[16], color);
+			_mm_stream_si128((__m128i *)&mem1[32], color);
+			_mm_stream_si128((__m128i *)&mem1[48], color);
+		}
+		else
+		{
+			_mm_store_si128((__m128i *)&mem1[0], color);
+			_mm_store_si128((__m128i *)&mem1[16], color);
+			_mm_store_si128((__m128i *)&mem1[32], color);
+			_mm_store_si128((__m128i *)&mem1[48], color);
+		}
+		mem1 += 64;
+	}
+	while(mem1 + 16 <= end)
+	{
+		if(stream)
+			_mm_stream_si128((__m128i *)mem1, color);
+		else
+			_mm_store_si128((__m128i *)mem1, color);
+		mem1 += 16;
+	}
+	if(mem1 < end)
+		_mm_storeu_si128((__m128i *)(end - 16), fill_set128(fill_phase(pattern, bytes - 16)));
+}
+static void fill_row_sse2(unsigned char *mem, U64 pattern, size_t bytes)	{fill_sse2(mem, pattern, bytes, false);}
+static void fill_row_sse2_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_sse2(mem, pattern, bytes, true);}
+
+#ifdef FILL_HAVE_AVX2
+static __m256i fill_set256(U64 pattern)
+{
+	int lo = (int)pattern;
+	int hi = (int)(pattern >> 32);
+	return _mm256_set_epi32(hi, lo, hi, lo, hi, lo, hi, lo);
+}
+
+static __forceinline void fill_avx2(unsigned char *mem, U64 pattern, size_t bytes, bool stream)
+{
+	if(bytes < 32)
+	{
+		fill_sse2(mem, pattern, bytes, false);
+		return;
+	}
+	unsigned char *end = mem + bytes;
+	size_t head = (0 - (uintptr_t)mem) & 31;
+
+	_mm256_storeu_si256((__m256i *)mem, fill_set256(pattern));
+	__m256i color = fill_set256(fill_phase(pattern, head));
+	unsigned char *mem1 = mem + head;
+	while(mem1 + 128 <= end)
+	{
+		if(stream)
+		{
+			_mm256_stream_si256((__m256i *)&mem1[0], color);
+			_mm256_stream_si256((__m256i *)&mem1[32], color);
+			_mm256_stream_si256((__m256i *)&mem1[64], color);
+			_mm256_stream_si256((__m256i *)&mem1[96], color);
+		}
+		else
+		{
+			_mm256_store_si256((__m256i *)&mem1[0], color);
+			_mm256_store_si256((__m256i *)&mem1[32], color);
+			_mm256_store_si256((__m256i *)&mem1[64], color);
+			_mm256_store_si256((__m256i *)&mem1[96], color);
+		}
+		mem1 += 128;
+	}
+	while(mem1 + 32 <= end)
+	{
+		if(stream)
+			_mm256_stream_si256((__m256i *)mem1, color);
+		else
+			_mm256_store_si256((__m256i *)mem1, color);
+		mem1 += 32;
+	}
+	if(mem1 < end)
+		_mm256_storeu_si256((__m256i *)(end - 32), fill_set256(fill_phase(pattern, bytes - 32)));
+	_mm256_zeroupper();
+}
+static void fill_row_avx2(unsigned char *mem, U64 pattern, size_t bytes)	{fill_avx2(mem, pattern, bytes, false);}
+static void fill_row_avx2_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_avx2(mem, pattern, bytes, true);}
+#endif
+
+#ifdef FILL_HAVE_AVX512
+static __mmask64 fill_mask(size_t bytes)
+{
+	return bytes >= 64 ? ~0ull : (1ull << bytes) - 1;
+}
+
+static __forceinline void fill_avx512(unsigned char *mem, U64 pattern, size_t bytes, bool stream)
+{
+	size_t head = (0 - (uintptr_t)mem) & 63;
+	if(head >= bytes)
+	{
+		_mm512_mask_storeu_epi8(mem, fill_mask(bytes), _mm512_set1_epi64(pattern));
+		_mm256_zeroupper();
+		return;
+	}
+
+	// masked head up to the first 64 byte boundary, then whole cache lines,
+	// then a masked tail; nothing outside the row is touched
+	if(head)
+		_mm512_mask_storeu_epi8(mem, fill_mask(head), _mm512_set1_epi64(pattern));
+	__m512i color = _mm512_set1_epi64(fill_phase(pattern, head));
+	unsigned char *mem1 = mem + head;
+	unsigned char *end = mem + bytes;
+	while(mem1 + 256 <= end)
+	{
+		if(stream)
+		{
+			_mm512_stream_si512((__m512i *)&mem1[0], color);
+			_mm512_stream_si512((__m512i *)&mem1[64], color);
+			_mm512_stream_si512((__m512i *)&mem1[128], color);
+			_mm512_stream_si512((__m512i *)&mem1[192], color);
+		}
+		else
+		{
+			_mm512_store_si512(&mem1[0], color);
+			_mm512_store_si512(&mem1[64], color);
+			_mm512_store_si512(&mem1[128], color);
+			_mm512_store_si512(&mem1[192], color);
+		}
+		mem1 += 256;
+	}
+	while(mem1 + 64 <= end)
+	{
+		if(stream)
+			_mm512_stream_si512((__m512i *)mem1, color);
+		else
+			_mm512_store_si512(mem1, color);
+		mem1 += 64;
+	}
+	if(mem1 < end)
+		_mm512_mask_storeu_epi8(mem1, fill_mask(end - mem1), color);
+	_mm256_zeroupper();
+}
+static void fill_row_avx512(unsigned char *mem, U64 pattern, size_t bytes)	{fill_avx512(mem, pattern, bytes, false);}
+static void fill_row_avx512_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_avx512(mem, pattern, bytes, true);}
+#endif
+
+
+// 24 and 48 bit fills repeat every 3 or 6 bytes.  A run of three vectors
+// (48 bytes for SSSE3, 96 for AVX2, 192 for AVX-512) holds a whole number of
+// periods, so each row shuffles the pixel into three registers once and then
+// stores them in turn.  fill_shuffle?[period == 6][phase][k] gives the bytes
+// of register k for a run starting "phase" bytes into the pattern.
+
+static __declspec(align(64)) unsigned char fill_shuffle16[2][6][3][16];
+static __declspec(align(64)) unsigned char fill_shuffle32[2][6][3][32];
+static __declspec(align(64)) unsigned char fill_shuffle64[2][6][3][64];
+
+static bool fill_build_shuffles()
+{
+	for(unsigned int p=0; p<2; p++)
+	{
+		unsigned int period = p ? 6 : 3;
+		for(unsigned int phase=0; phase<period; phase++)
+			for(unsigned int k=0; k<3; k++)
+			{
+				for(unsigned int x=0; x<16; x++)
+					fill_shuffle16[p][phase][k][x] = (phase + k*16 + x) % period;
+				for(unsigned int x=0; x<32; x++)
+					fill_shuffle32[p][phase][k][x] = (phase + k*32 + x) % period;
+				for(unsigned int x=0; x<64; x++)
+					fill_shuffle64[p][phase][k][x] = (phase + k*64 + x) % period;
+			}
+	}
+	return true;
+}
+
+static void fill_row3_c(unsigned char *mem, U64 pattern, size_t bytes)
+{
+	U32 color1 = (U32)pattern & 0xFFFFFF;
+	U32 color2 = (color1 >> 8) | (color1 << 16);
+	U32 color3 = (color1 >> 16) | (color1 << 8);
+	color1 = color1 | (color1 << 24);
+	size_t x=0;
+	while(x+12<=bytes)
+	{
+		*((U32*)&mem[x]) = color1;
+		*((U32*)&mem[x+4]) = color2;
+		*((U32*)&mem[x+8]) = color3;
+		x+=12;
+	}
+	for(; x<bytes; x++)
+		mem[x] = (unsigned char)(pattern >> ((x % 3) * 8));
+}
+
+static void fill_row6_c(unsigned char *mem, U64 pattern, size_t bytes)
+{
+	U16 color1b = (U16)(pattern >> 32);
+	size_t x=0;
+	while(x+6<=bytes)
+	{
+		*((U32*)&mem[x]) = (U32)pattern;
+		*((U16*)&mem[x+4]) = color1b;
+		x+=6;
+	}
+	for(; x<bytes; x++)
+		mem[x] = (unsigned char)(pattern >> ((x % 6) * 8));
+}
+
+static void fill_period_c(unsigned char *mem, U64 pattern, unsigned int period, size_t bytes)
+{
+	if(period == 6)
+		fill_row6_c(mem, pattern, bytes);
+	else
+		fill_row3_c(mem, pattern, bytes);
+}
+
+static __forceinline void fill_period_ssse3(unsigned char *mem, U64 pattern, unsigned int period, size_t bytes, bool stream)
+{
+	if(bytes < 16)
+	{
+		fill_period_c(mem, pattern, period, bytes);
+		return;
+	}
+	unsigned char (*shuffle)[3][16] = fill_shuffle16[period == 6];
+	__m128i color = _mm_loadl_epi64((const __m128i *)&pattern);
+	unsigned char *end = mem + bytes;
+	size_t head = (0 - (uintptr_t)mem) & 15;
+
+	_mm_storeu_si128((__m128i *)mem, _mm_shuffle_epi8(color, _mm_load_si128((const __m128i *)shuffle[0][0])));
+	unsigned int phase = head % period;
+	__m128i color0 = _mm_shuffle_epi8(color, _mm_load_si128((const __m128i *)shuffle[phase][0]));
+	__m128i color1 = _mm_shuffle_epi8(color, _mm_load_si128((const __m128i *)shuffle[phase][1]));
+	__m128i color2 = _mm_shuffle_epi8(color, _mm_load_si128((const __m128i *)shuffle[phase][2]));
+	unsigned char *mem1 = mem + head;
+	while(mem1 + 48 <= end)
+	{
+		if(stream)
+		{
+			_mm_stream_si128((__m128i *)&mem1[0], color0);
+			_mm_stream_si128((__m128i *)&mem1[16], color1);
+			_mm_stream_si128((__m128i *)&mem1[32], color2);
+		}
+		else
+		{
+			_mm_store_si128((__m128i *)&mem1[0], color0);
+			_mm_store_si128((__m128i *)&mem1[16], color1);
+			_mm_store_si128((__m128i *)&mem1[32], color2);
+		}
+		mem1 += 48;
+	}
+	if(mem1 + 16 <= end)
+	{
+		_mm_store_si128((__m128i *)mem1, color0);
+		mem1 += 16;
+		if(mem1 + 16 <= end)
+		{
+			_mm_store_si128((__m128i *)mem1, color1);
+			mem1 += 16;
+		}
+	}
+	if(mem1 < end)
+		_mm_storeu_si128((__m128i *)(end - 16), _mm_shuffle_epi8(color, _mm_load_si128((const __m128i *)shuffle[(bytes - 16) % period][0])));
+}
+static void fill_row3_ssse3(unsigned char *mem, U64 pattern, size_t bytes)	{fill_period_ssse3(mem, pattern, 3, bytes, false);}
+static void fill_row3_ssse3_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_period_ssse3(mem, pattern, 3, bytes, true);}
+static void fill_row6_ssse3(unsigned char *mem, U64 pattern, size_t bytes)	{fill_period_ssse3(mem, pattern, 6, bytes, false);}
+static void fill_row6_ssse3_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_period_ssse3(mem, pattern, 6, bytes, true);}
+
+#ifdef FILL_HAVE_AVX2
+static __forceinline void fill_period_avx2(unsigned char *mem, U64 pattern, unsigned int period, size_t bytes, bool stream)
+{
+	if(bytes < 32)
+	{
+		fill_period_ssse3(mem, pattern, period, bytes, false);
+		return;
+	}
+	unsigned char (*shuffle)[3][32] = fill_shuffle32[period == 6];
+	__m256i color = _mm256_broadcastsi128_si256(_mm_loadl_epi64((const __m128i *)&pattern));
+	unsigned char *end = mem + bytes;
+	size_t head = (0 - (uintptr_t)mem) & 31;
+
+	_mm256_storeu_si256((__m256i *)mem, _mm256_shuffle_epi8(color, _mm256_load_si256((const __m256i *)shuffle[0][0])));
+	unsigned int phase = head % period;
+	__m256i color0 = _mm256_shuffle_epi8(color, _mm256_load_si256((const __m256i *)shuffle[phase][0]));
+	__m256i color1 = _mm256_shuffle_epi8(color, _mm256_load_si256((const __m256i *)shuffle[phase][1]));
+	__m256i color2 = _mm256_shuffle_epi8(color, _mm256_load_si256((const __m256i *)shuffle[phase][2]));
+	unsigned char *mem1 = mem + head;
+	while(mem1 + 96 <= end)
+	{
+		if(stream)
+		{
+			_mm256_stream_si256((__m256i *)&mem1[0], color0);
+			_mm256_stream_si256((__m256i *)&mem1[32], color1);
+			_mm256_stream_si256((__m256i *)&mem1[64], color2);
+		}
+		else
+		{
+			_mm256_store_si256((__m256i *)&mem1[0], color0);
+			_mm256_store_si256((__m256i *)&mem1[32], color1);
+			_mm256_store_si256((__m256i *)&mem1[64], color2);
+		}
+		mem1 += 96;
+	}
+	if(mem1 + 32 <= end)
+	{
+		_mm256_store_si256((__m256i *)mem1, color0);
+		mem1 += 32;
+		if(mem1 + 32 <= end)
+		{
+			_mm256_store_si256((__m256i *)mem1, color1);
+			mem1 += 32;
+		}
+	}
+	if(mem1 < end)
+		_mm256_storeu_si256((__m256i *)(end - 32), _mm256_shuffle_epi8(color, _mm256_load_si256((const __m256i *)shuffle[(bytes - 32) % period][0])));
+	_mm256_zeroupper();
+}
+static void fill_row3_avx2(unsigned char *mem, U64 pattern, size_t bytes)	{fill_period_avx2(mem, pattern, 3, bytes, false);}
+static void fill_row3_avx2_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_period_avx2(mem, pattern, 3, bytes, true);}
+static void fill_row6_avx2(unsigned char *mem, U64 pattern, size_t bytes)	{fill_period_avx2(mem, pattern, 6, bytes, false);}
+static void fill_row6_avx2_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_period_avx2(mem, pattern, 6, bytes, true);}
+#endif
+
+#ifdef FILL_HAVE_AVX512
+static __forceinline void fill_period_avx512(unsigned char *mem, U64 pattern, unsigned int period, size_t bytes, bool stream)
+{
+	unsigned char (*shuffle)[3][64] = fill_shuffle64[period == 6];
+	__m512i color = _mm512_broadcast_i32x4(_mm_loadl_epi64((const __m128i *)&pattern));
+	size_t head = (0 - (uintptr_t)mem) & 63;
+	if(head >= bytes)
+	{
+		_mm512_mask_storeu_epi8(mem, fill_mask(bytes), _mm512_shuffle_epi8(color, _mm512_load_si512(shuffle[0][0])));
+		_mm256_zeroupper();
+		return;
+	}
+
+	if(head)
+		_mm512_mask_storeu_epi8(mem, fill_mask(head), _mm512_shuffle_epi8(color, _mm512_load_si512(shuffle[0][0])));
+	unsigned int phase = head % period;
+	__m512i color0 = _mm512_shuffle_epi8(color, _mm512_load_si512(shuffle[phase][0]));
+	__m512i color1 = _mm512_shuffle_epi8(color, _mm512_load_si512(shuffle[phase][1]));
+	__m512i color2 = _mm512_shuffle_epi8(color, _mm512_load_si512(shuffle[phase][2]));
+	unsigned char *mem1 = mem + head;
+	unsigned char *end = mem + bytes;
+	while(mem1 + 192 <= end)
+	{
+		if(stream)
+		{
+			_mm512_stream_si512((__m512i *)&mem1[0], color0);
+			_mm512_stream_si512((__m512i *)&mem1[64], color1);
+			_mm512_stream_si512((__m512i *)&mem1[128], color2);
+		}
+		else
+		{
+			_mm512_store_si512(&mem1[0], color0);
+			_mm512_store_si512(&mem1[64], color1);
+			_mm512_store_si512(&mem1[128], color2);
+		}
+		mem1 += 192;
+	}
+	// the rest of the row continues the color0, color1, color2 sequence
+	if(mem1 + 64 <= end)
+	{
+		_mm512_store_si512(mem1, color0);
+		mem1 += 64;
+		color0 = color1;
+		if(mem1 + 64 <= end)
+		{
+			_mm512_store_si512(mem1, color1);
+			mem1 += 64;
+			color0 = color2;
+		}
+	}
+	if(mem1 < end)
+		_mm512_mask_storeu_epi8(mem1, fill_mask(end - mem1), color0);
+	_mm256_zeroupper();
+}
+static void fill_row3_avx512(unsigned char *mem, U64 pattern, size_t bytes)	{fill_period_avx512(mem, pattern, 3, bytes, false);}
+static void fill_row3_avx512_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_period_avx512(mem, pattern, 3, bytes, true);}
+static void fill_row6_avx512(unsigned char *mem, U64 pattern, size_t bytes)	{fill_period_avx512(mem, pattern, 6, bytes, false);}
+static void fill_row6_avx512_nt(unsigned char *mem, U64 pattern, size_t bytes) {fill_period_avx512(mem, pattern, 6, bytes, true);}
+#endif
+
+
+typedef void (*(FillRowFunc))(unsigned char *mem, U64 pattern, size_t bytes);
+
+enum FILL_LEVEL
+{
+	FILL_C,
+	FILL_SSE2,
+	FILL_SSSE3,
+	FILL_AVX2,
+	FILL_AVX512,
+};
+
+static FILL_LEVEL fill_cpu_level()
+{
+	int info[4];
+	__cpuid(info, 0);
+	int maxleaf = info[0];
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool ssse3 = (info[2] & (1 << 9)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool avx2 = false;
+	bool avx512 = false;
+	if(maxleaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+		avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 30)); // F + BW
+	}
+	U64 xcr0 = 0;
+#ifdef FILL_HAVE_AVX2
+	if(osxsave)
+		xcr0 = _xgetbv(0);
+#endif
+
+#ifdef FILL_HAVE_AVX512
+	if(avx512 && (xcr0 & 0xE6) == 0xE6) // xmm, ymm, opmask and zmm state enabled
+		return FILL_AVX512;
+#endif
+#ifdef FILL_HAVE_AVX2
+	if(avx && avx2 && (xcr0 & 0x06) == 0x06)
+		return FILL_AVX2;
+#endif
+	if(ssse3)
+		return FILL_SSSE3;
+	if(sse2)
+		return FILL_SSE2;
+	return FILL_C;
+}
+
+struct FillFuncs
+{
+	FillRowFunc row8;
+	FillRowFunc row3;
+	FillRowFunc row6;
+};
+
+static FillFuncs fill_select(bool stream)
+{
+	FillFuncs f;
+	switch(fill_cpu_level())
+	{
+#ifdef FILL_HAVE_AVX512
+	case FILL_AVX512:
+		f.row8 = stream ? fill_row_avx512_nt : fill_row_avx512;
+		f.row3 = stream ? fill_row3_avx512_nt : fill_row3_avx512;
+		f.row6 = stream ? fill_row6_avx512_nt : fill_row6_avx512;
+		break;
+#endif
+#ifdef FILL_HAVE_AVX2
+	case FILL_AVX2:
+		f.row8 = stream ? fill_row_avx2_nt : fill_row_avx2;
+		f.row3 = stream ? fill_row3_avx2_nt : fill_row3_avx2;
+		f.row6 = stream ? fill_row6_avx2_nt : fill_row6_avx2;
+		break;
+#endif
+	case FILL_SSSE3:
+		f.row8 = stream ? fill_row_sse2_nt : fill_row_sse2;
+		f.row3 = stream ? fill_row3_ssse3_nt : fill_row3_ssse3;
+		f.row6 = stream ? fill_row6_ssse3_nt : fill_row6_ssse3;
+		break;
+	case FILL_SSE2:
+		f.row8 = stream ? fill_row_sse2_nt : fill_row_sse2;
+		f.row3 = fill_row3_c;
+		f.row6 = fill_row6_c;
+		break;
+	default:
+		f.row8 = fill_row_c;
+		f.row3 = fill_row3_c;
+		f.row6 = fill_row6_c;
+	}
+	return f;
+}
+
+// picked once, when the dll loads
+static bool fill_shuffles_built = fill_build_shuffles();
+static FillFuncs fill_cached = fill_select(false);
+static FillFuncs fill_stream = fill_select(true);
+
+void fill_row(unsigned char *mem, U64 pattern, size_t bytes, bool streaming)
+{
+	(streaming ? fill_stream : fill_cached).row8(mem, pattern, bytes);
+}
+void fill_row24(unsigned char *mem, U32 pattern, size_t bytes, bool streaming)
+{
+	(streaming ? fill_stream : fill_cached).row3(mem, pattern, bytes);
+}
+void fill_row48(unsigned char *mem, U64 pattern, size_t bytes, bool streaming)
+{
+	(streaming ? fill_stream : fill_cached).row6(mem, pattern, bytes);
+}
+
+// copying into a sample, the frame cache is 64 byte aligned and sample
+// buffers normally are too
+static bool fill_have_sse2 = fill_cpu_level() >= FILL_SSE2;
+
+void fill_copy(unsigned char *dst, const unsigned char *src, size_t bytes, bool streaming)
+{
+	if(!streaming || !fill_have_sse2 || bytes < 128 || (((uintptr_t)dst ^ (uintptr_t)src) & 15))
+	{
+		memcpy(dst, src, bytes);
+		return;
+	}
+	size_t head = (0 - (uintptr_t)dst) & 15;
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	bytes -= head;
+	while(bytes >= 64)
+	{
+		__m128i a = _mm_load_si128((const __m128i *)&src[0]);
+		__m128i b = _mm_load_si128((const __m128i *)&src[16]);
+		__m128i c = _mm_load_si128((const __m128i *)&src[32]);
+		__m128i d = _mm_load_si128((const __m128i *)&src[48]);
+		_mm_stream_si128((__m128i *)&dst[0], a);
+		_mm_stream_si128((__m128i *)&dst[16], b);
+		_mm_stream_si128((__m128i *)&dst[32], c);
+		_mm_stream_si128((__m128i *)&dst[48], d);
+		dst += 64;
+		src += 64;
+		bytes -= 64;
+	}
+	memcpy(dst, src, bytes);
+}
+
+// streaming stores are weakly ordered, fence them before the frame is handed on
+void fillFlush()
+{
+	_mm_sfence();
+}
@@ -28,6 +28,13 @@
 #include <olectl.h>
 #include <initguid.h>
 #include <objidl.h>
+#include "draw.h"
+#include "render.h"
+#include "schedule.h"
+#include "queue.h"
+#include "stats.h"
+#include "trace.h"
+#include "ring.h"
 #include "filter.h"
 #include "output.h"
 
@@ -437,11 +444,14 @@ CFilter1::CFilter1()
 	//m_paStreams = (CSourceStream **) new COutputPin1*[1];
 	pin = new COutputPin1(this);
 	graph = NULL;
+	clock = NULL;
 	state = State_Stopped;
 }
 CFilter1::~CFilter1()
 {
 	delete pin;
+	if(clock)
+		clock->Release();
 	WaitForSingleObject(mutex, INFINITE);
 	if(InterlockedDecrement(&global_lock) == -1)
 		__debugbreak();
@@ -489,8 +499,27 @@ STDMETHODIMP CFilter1::GetClassID(CLSID *pClsID) {return E_NOTIMPL;}
 
 // IMediaFilter methods
 STDMETHODIMP CFilter1::GetState(DWORD dwMSecs, FILTER_STATE *State)   {*State = state; return S_OK;}
-STDMETHODIMP CFilter1::SetSyncSource(IReferenceClock *pClock)		 {return S_OK;}
-STDMETHODIMP CFilter1::GetSyncSource(IReferenceClock **pClock)		{*pClock = NULL; return NOERROR;}
+STDMETHODIMP CFilter1::SetSyncSource(IReferenceClock *pClock)
+{
+	debuglog("filter1 SetSyncSource");
+	WaitForSingleObject(mutex, INFINITE);
+	if(pClock)
+		pClock->AddRef();
+	if(clock)
+		clock->Release();
+	clock = pClock;
+	ReleaseMutex(mutex);
+	return S_OK;
+}
+STDMETHODIMP CFilter1::GetSyncSource(IReferenceClock **pClock)
+{
+	WaitForSingleObject(mutex, INFINITE);
+	*pClock = clock;
+	if(clock)
+		clock->AddRef();
+	ReleaseMutex(mutex);
+	return NOERROR;
+}
 STDMETHODIMP CFilter1::Stop()
 {
 	debuglog("filter1 stop");
@@ -515,7 +544,7 @@ STDMETHODIMP CFilter1::Run(REFERENCE_TIME tStart)
 {
 	debuglog("filter1 run");
 	WaitForSingleObject(mutex, INFINITE);
-	pin->run();
+	pin->run(tStart);
 	state = State_Running;
 	ReleaseMutex(mutex);
 	debuglog("filter1 run done");
@@ -553,5 +582,10 @@ STDMETHODIMP_(ULONG) CFilter1::GetMiscFlags() {return AM_FILTER_MISC_FLAGS_IS_SO
 
 // IPersistPropertyBag
 STDMETHODIMP CFilter1::InitNew() {return S_OK;}
-STDMETHODIMP CFilter1::Load(IPropertyBag *pPropBag, IErrorLog *pErrorLog) {return S_OK;}
+STDMETHODIMP CFilter1::Load(IPropertyBag *pPropBag, IErrorLog *pErrorLog)
+{
+	if(pPropBag)
+		pin->loadSettings(pPropBag, pErrorLog);
+	return S_OK;
+}
 STDMETHODIMP CFilter1::Save(IPropertyBag *pPropBag, BOOL fClearDirty, BOOL fSaveAllProperties) {return S_OK;}
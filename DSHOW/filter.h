@@ -93,6 +93,7 @@ public:
 
 	COutputPin1 *pin;
 	IFilterGraph *graph;
+	IReferenceClock *clock;	// From SetSyncSource, NULL for none
 
 	CFilter1();
 	~CFilter1();
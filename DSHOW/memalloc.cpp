@@ -0,0 +1,527 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <dshow.h>
+#include <string.h>
+#include "memalloc.h"
+
+// output.cpp
+HRESULT CopyMediaType(AM_MEDIA_TYPE *pmtTarget, const AM_MEDIA_TYPE *pmtSource);
+
+static void deleteMediaType(AM_MEDIA_TYPE *mt)
+{
+	if(!mt)
+		return;
+	if(mt->cbFormat != 0)
+		CoTaskMemFree((LPVOID)mt->pbFormat);
+	if(mt->pUnk)
+		mt->pUnk->Release();
+	CoTaskMemFree(mt);
+}
+
+static AM_MEDIA_TYPE *newMediaType(const AM_MEDIA_TYPE *source)
+{
+	AM_MEDIA_TYPE *mt = (AM_MEDIA_TYPE*) CoTaskMemAlloc(sizeof(AM_MEDIA_TYPE));
+	if(mt && CopyMediaType(mt, source) != S_OK)
+	{
+		CoTaskMemFree(mt);
+		mt = NULL;
+	}
+	return mt;
+}
+
+static SIZE_T roundUp(SIZE_T size, SIZE_T align)
+{
+	return (size + align - 1) & ~(align - 1);
+}
+
+// Large pages need SeLockMemoryPrivilege enabled, which only accounts
+// granted "Lock pages in memory" have
+static bool enableLockMemory()
+{
+	HANDLE token;
+	if(!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		return false;
+	TOKEN_PRIVILEGES tp;
+	tp.PrivilegeCount = 1;
+	tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	bool ok = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid)
+		&& AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL)
+		&& GetLastError() == ERROR_SUCCESS;
+	CloseHandle(token);
+	return ok;
+}
+
+// Smallest large page, 0 when there are none.  GetLargePageMinimum is not
+// in XP's kernel32, so it is looked up rather than imported and the filter
+// still loads there.
+static SIZE_T largePageMinimum()
+{
+	typedef SIZE_T (WINAPI *GetLargePageMinimumFunc)(void);
+	GetLargePageMinimumFunc getLargePageMinimum = (GetLargePageMinimumFunc)
+		GetProcAddress(GetModuleHandle(L"kernel32"), "GetLargePageMinimum");
+	return getLargePageMinimum ? getLargePageMinimum() : 0;
+}
+
+
+
+DShowMediaSample::DShowMediaSample()
+{
+	m_allocator = NULL;
+	m_buffer = NULL;
+	m_size = 0;
+	m_actual = 0;
+	m_refCount = 0;
+	m_mediaType = NULL;
+	recycle();
+}
+
+DShowMediaSample::~DShowMediaSample()
+{
+	deleteMediaType(m_mediaType);
+}
+
+void DShowMediaSample::recycle()
+{
+	m_flags = 0;
+	m_start = m_stop = 0;
+	m_mediaStart = m_mediaStop = 0;
+	if(m_mediaType)
+	{
+		deleteMediaType(m_mediaType);
+		m_mediaType = NULL;
+	}
+}
+
+STDMETHODIMP DShowMediaSample::QueryInterface(REFIID riid, void **ppv)
+{
+	if(riid == IID_IMediaSample)
+		*ppv = (IMediaSample*)this;
+	else if(riid == IID_IUnknown)
+		*ppv = (IUnknown*)this;
+	else
+	{
+		*ppv = NULL;
+		return E_NOINTERFACE;
+	}
+	AddRef();
+	return NOERROR;
+}
+
+STDMETHODIMP_(ULONG) DShowMediaSample::AddRef() {return InterlockedIncrement(&m_refCount);}
+STDMETHODIMP_(ULONG) DShowMediaSample::Release()
+{
+	// the last reference hands the sample back instead of deleting it
+	ULONG ref = InterlockedDecrement(&m_refCount);
+	if(!ref)
+		m_allocator->ReleaseBuffer(this);
+	return ref;
+}
+
+STDMETHODIMP DShowMediaSample::GetPointer(BYTE **ppBuffer)
+{
+	if(!ppBuffer)
+		return E_POINTER;
+	*ppBuffer = m_buffer;
+	return S_OK;
+}
+
+STDMETHODIMP_(long) DShowMediaSample::GetSize() {return m_size;}
+
+STDMETHODIMP DShowMediaSample::GetTime(REFERENCE_TIME *pTimeStart, REFERENCE_TIME *pTimeEnd)
+{
+	if(!(m_flags & SAMPLE_START_VALID))
+		return VFW_E_SAMPLE_TIME_NOT_SET;
+	*pTimeStart = m_start;
+	if(!(m_flags & SAMPLE_STOP_VALID))
+	{
+		*pTimeEnd = m_start + 1;
+		return VFW_S_NO_STOP_TIME;
+	}
+	*pTimeEnd = m_stop;
+	return S_OK;
+}
+
+STDMETHODIMP DShowMediaSample::SetTime(REFERENCE_TIME *pTimeStart, REFERENCE_TIME *pTimeEnd)
+{
+	m_flags &= ~(SAMPLE_START_VALID | SAMPLE_STOP_VALID);
+	if(pTimeStart)
+	{
+		m_start = *pTimeStart;
+		m_flags |= SAMPLE_START_VALID;
+		if(pTimeEnd)
+		{
+			m_stop = *pTimeEnd;
+			m_flags |= SAMPLE_STOP_VALID;
+		}
+	}
+	return S_OK;
+}
+
+STDMETHODIMP DShowMediaSample::IsSyncPoint() {return (m_flags & SAMPLE_SYNCPOINT) ? S_OK : S_FALSE;}
+STDMETHODIMP DShowMediaSample::SetSyncPoint(BOOL bIsSyncPoint)
+{
+	m_flags = bIsSyncPoint ? (m_flags | SAMPLE_SYNCPOINT) : (m_flags & ~SAMPLE_SYNCPOINT);
+	return S_OK;
+}
+
+STDMETHODIMP DShowMediaSample::IsPreroll() {return (m_flags & SAMPLE_PREROLL) ? S_OK : S_FALSE;}
+STDMETHODIMP DShowMediaSample::SetPreroll(BOOL bIsPreroll)
+{
+	m_flags = bIsPreroll ? (m_flags | SAMPLE_PREROLL) : (m_flags & ~SAMPLE_PREROLL);
+	return S_OK;
+}
+
+STDMETHODIMP_(long) DShowMediaSample::GetActualDataLength() {return m_actual;}
+STDMETHODIMP DShowMediaSample::SetActualDataLength(long length)
+{
+	if(length < 0 || length > m_size)
+		return VFW_E_BUFFER_OVERFLOW;
+	m_actual = length;
+	return S_OK;
+}
+
+STDMETHODIMP DShowMediaSample::GetMediaType(AM_MEDIA_TYPE **ppMediaType)
+{
+	if(!ppMediaType)
+		return E_POINTER;
+	if(!m_mediaType)
+	{
+		*ppMediaType = NULL;
+		return S_FALSE;
+	}
+	*ppMediaType = newMediaType(m_mediaType);
+	return *ppMediaType ? S_OK : E_OUTOFMEMORY;
+}
+
+STDMETHODIMP DShowMediaSample::SetMediaType(AM_MEDIA_TYPE *pMediaType)
+{
+	deleteMediaType(m_mediaType);
+	m_mediaType = NULL;
+	if(!pMediaType)
+		return S_OK;
+	m_mediaType = newMediaType(pMediaType);
+	return m_mediaType ? S_OK : E_OUTOFMEMORY;
+}
+
+STDMETHODIMP DShowMediaSample::IsDiscontinuity() {return (m_flags & SAMPLE_DISCONTINUITY) ? S_OK : S_FALSE;}
+STDMETHODIMP DShowMediaSample::SetDiscontinuity(BOOL bDiscontinuity)
+{
+	m_flags = bDiscontinuity ? (m_flags | SAMPLE_DISCONTINUITY) : (m_flags & ~SAMPLE_DISCONTINUITY);
+	return S_OK;
+}
+
+STDMETHODIMP DShowMediaSample::GetMediaTime(LONGLONG *pTimeStart, LONGLONG *pTimeEnd)
+{
+	if(!(m_flags & SAMPLE_MEDIATIME_VALID))
+		return VFW_E_MEDIA_TIME_NOT_SET;
+	*pTimeStart = m_mediaStart;
+	*pTimeEnd = m_mediaStop;
+	return S_OK;
+}
+
+STDMETHODIMP DShowMediaSample::SetMediaTime(LONGLONG *pTimeStart, LONGLONG *pTimeEnd)
+{
+	if(!pTimeStart)
+	{
+		m_flags &= ~SAMPLE_MEDIATIME_VALID;
+		return S_OK;
+	}
+	if(!pTimeEnd)
+		return E_POINTER;
+	m_mediaStart = *pTimeStart;
+	m_mediaStop = *pTimeEnd;
+	m_flags |= SAMPLE_MEDIATIME_VALID;
+	return S_OK;
+}
+
+
+
+DShowMemAllocator::DShowMemAllocator()
+{
+	InitializeSListHead(&m_free);
+	m_refCount = 1;
+	m_committed = 0;
+	m_waiting = 0;
+	m_outstanding = 0;
+	m_freeEvent = CreateEvent(NULL, false, false, NULL);
+	m_decommitEvent = CreateEvent(NULL, true, true, NULL);
+	mutex = CreateMutex(NULL, false, NULL);
+	memset(&m_props, 0, sizeof(m_props));
+	m_useLargePages = false;
+	m_memory = NULL;
+	m_memorySize = 0;
+	m_largePages = false;
+	m_prefaulted = false;
+	m_samples = NULL;
+	m_sampleCount = 0;
+}
+
+DShowMemAllocator::~DShowMemAllocator()
+{
+	// every sample holds a reference, so they are all back by now
+	release();
+	CloseHandle(m_freeEvent);
+	CloseHandle(m_decommitEvent);
+	CloseHandle(mutex);
+}
+
+STDMETHODIMP DShowMemAllocator::QueryInterface(REFIID riid, void **ppv)
+{
+	if(riid == IID_IMemAllocator)
+		*ppv = (IMemAllocator*)this;
+	else if(riid == IID_IUnknown)
+		*ppv = (IUnknown*)this;
+	else
+	{
+		*ppv = NULL;
+		return E_NOINTERFACE;
+	}
+	AddRef();
+	return NOERROR;
+}
+
+STDMETHODIMP_(ULONG) DShowMemAllocator::AddRef()  {return InterlockedIncrement(&m_refCount);}
+STDMETHODIMP_(ULONG) DShowMemAllocator::Release() {ULONG ref = InterlockedDecrement(&m_refCount); if(!ref) {delete this;} return ref;}
+
+// Lays the buffers out in one block.  Each starts on a page when it is at
+// least a page long, otherwise on cbAlign, with cbPrefix bytes free before
+// it.  All the samples go on the free list.
+HRESULT DShowMemAllocator::allocate()
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	SIZE_T bufferAlign = m_props.cbAlign;
+	if(m_props.cbBuffer + m_props.cbPrefix >= (long)si.dwPageSize)
+		bufferAlign = si.dwPageSize;
+	SIZE_T first = roundUp(m_props.cbPrefix, bufferAlign);
+	SIZE_T stride = roundUp(m_props.cbBuffer + m_props.cbPrefix, bufferAlign);
+	SIZE_T size = first + stride * (m_props.cBuffers - 1) + m_props.cbBuffer;
+
+	m_largePages = false;
+	m_memory = NULL;
+	SIZE_T largePage = m_useLargePages ? largePageMinimum() : 0;
+	if(largePage && enableLockMemory())
+	{
+		m_memorySize = roundUp(size, largePage);
+		m_memory = (BYTE*) VirtualAlloc(NULL, m_memorySize,
+			MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		m_largePages = m_memory != NULL;
+	}
+	if(!m_memory)
+	{
+		m_memorySize = roundUp(size, si.dwPageSize);
+		m_memory = (BYTE*) VirtualAlloc(NULL, m_memorySize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+	if(!m_memory)
+		return E_OUTOFMEMORY;
+
+	m_samples = new DShowMediaSample[m_props.cBuffers];
+	if(!m_samples)
+	{
+		VirtualFree(m_memory, 0, MEM_RELEASE);
+		m_memory = NULL;
+		return E_OUTOFMEMORY;
+	}
+	m_sampleCount = m_props.cBuffers;
+	m_prefaulted = false;
+	for(long i = 0; i < m_sampleCount; i++)
+	{
+		DShowMediaSample &s = m_samples[i];
+		s.m_allocator = this;
+		s.m_buffer = m_memory + first + stride * i;
+		s.m_size = m_props.cbBuffer;
+		s.m_actual = m_props.cbBuffer;
+		InterlockedPushEntrySList(&m_free, &s.m_entry);
+	}
+	return S_OK;
+}
+
+// Only with no samples outstanding
+void DShowMemAllocator::release()
+{
+	InterlockedFlushSList(&m_free);
+	delete[] m_samples;
+	m_samples = NULL;
+	m_sampleCount = 0;
+	if(m_memory)
+		VirtualFree(m_memory, 0, MEM_RELEASE);
+	m_memory = NULL;
+	m_memorySize = 0;
+	m_largePages = false;
+	m_prefaulted = false;
+}
+
+// Writes to every page so none faults when the first frames are drawn,
+// then asks to keep them resident.  Large pages are never paged out, and
+// the lock is only a request, a working set too small to hold the
+// buffers leaves them to be touched again if they are trimmed.
+void DShowMemAllocator::prefault()
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	for(SIZE_T offset = 0; offset < m_memorySize; offset += si.dwPageSize)
+		((volatile BYTE*)m_memory)[offset] = 0;
+	if(!m_largePages)
+		VirtualLock(m_memory, m_memorySize);
+	m_prefaulted = true;
+}
+
+STDMETHODIMP DShowMemAllocator::SetProperties(ALLOCATOR_PROPERTIES *pRequest, ALLOCATOR_PROPERTIES *pActual)
+{
+	if(!pRequest || !pActual)
+		return E_POINTER;
+	// cbAlign a power of two, cbAlign 0 taken as 1
+	long align = pRequest->cbAlign ? pRequest->cbAlign : 1;
+	if(align < 0 || (align & (align - 1)))
+		return VFW_E_BADALIGN;
+	if(pRequest->cbBuffer < 0 || pRequest->cbPrefix < 0)
+		return E_INVALIDARG;
+	// at least a cache line, so no two buffers share one
+	if(align < 64)
+		align = 64;
+
+	WaitForSingleObject(mutex, INFINITE);
+	HRESULT hr = S_OK;
+	if(m_committed)
+		hr = VFW_E_ALREADY_COMMITTED;
+	else if(m_outstanding)
+		hr = VFW_E_BUFFERS_OUTSTANDING;
+	else
+	{
+		ALLOCATOR_PROPERTIES props;
+		props.cBuffers = pRequest->cBuffers > 0 ? pRequest->cBuffers : 1;
+		props.cbBuffer = pRequest->cbBuffer;
+		props.cbAlign = align;
+		props.cbPrefix = pRequest->cbPrefix;
+		// the buffers already made are kept if they still fit
+		if(memcmp(&props, &m_props, sizeof(props)) != 0)
+			release();
+		m_props = props;
+		*pActual = props;
+	}
+	ReleaseMutex(mutex);
+	return hr;
+}
+
+STDMETHODIMP DShowMemAllocator::GetProperties(ALLOCATOR_PROPERTIES *pProps)
+{
+	if(!pProps)
+		return E_POINTER;
+	*pProps = m_props;
+	return S_OK;
+}
+
+STDMETHODIMP DShowMemAllocator::Commit()
+{
+	WaitForSingleObject(mutex, INFINITE);
+	HRESULT hr = S_OK;
+	if(m_props.cbBuffer == 0)
+		hr = VFW_E_SIZENOTSET;
+	else if(!m_committed)
+	{
+		if(!m_memory)
+			hr = allocate();
+		if(hr == S_OK)
+		{
+			if(!m_prefaulted)
+				prefault();
+			ResetEvent(m_decommitEvent);
+			InterlockedExchange(&m_committed, 1);
+		}
+	}
+	ReleaseMutex(mutex);
+	return hr;
+}
+
+// Keeps the buffers for the next Commit.  Samples still downstream come
+// back to the free list as they are released.
+STDMETHODIMP DShowMemAllocator::Decommit()
+{
+	WaitForSingleObject(mutex, INFINITE);
+	InterlockedExchange(&m_committed, 0);
+	SetEvent(m_decommitEvent);
+	ReleaseMutex(mutex);
+	return S_OK;
+}
+
+STDMETHODIMP DShowMemAllocator::GetBuffer(IMediaSample **ppBuffer, REFERENCE_TIME *pStartTime, REFERENCE_TIME *pEndTime, DWORD dwFlags)
+{
+	if(!ppBuffer)
+		return E_POINTER;
+	*ppBuffer = NULL;
+	PSLIST_ENTRY entry = NULL;
+	while(!entry)
+	{
+		if(!m_committed)
+			return VFW_E_NOT_COMMITTED;
+		entry = InterlockedPopEntrySList(&m_free);
+		if(entry)
+			break;
+		if(dwFlags & AM_GBF_NOWAIT)
+			return VFW_E_TIMEOUT;
+		// ReleaseBuffer pushes before it looks at m_waiting, so a sample
+		// freed before the increment is found by the second pop
+		InterlockedIncrement(&m_waiting);
+		entry = InterlockedPopEntrySList(&m_free);
+		if(!entry && m_committed)
+		{
+			HANDLE events[2] = {m_freeEvent, m_decommitEvent};
+			WaitForMultipleObjects(2, events, FALSE, INFINITE);
+		}
+		InterlockedDecrement(&m_waiting);
+	}
+	// a Decommit racing the pop gets the sample back
+	if(!m_committed)
+	{
+		InterlockedPushEntrySList(&m_free, entry);
+		if(m_waiting)
+			SetEvent(m_freeEvent);
+		return VFW_E_NOT_COMMITTED;
+	}
+
+	DShowMediaSample *s = CONTAINING_RECORD(entry, DShowMediaSample, m_entry);
+	AddRef();
+	InterlockedIncrement(&m_outstanding);
+	s->m_refCount = 1;
+	*ppBuffer = s;
+	return S_OK;
+}
+
+STDMETHODIMP DShowMemAllocator::ReleaseBuffer(IMediaSample *pBuffer)
+{
+	DShowMediaSample *s = static_cast<DShowMediaSample*>(pBuffer);
+	if(!s || s->m_allocator != this)
+		return E_INVALIDARG;
+	s->recycle();
+	InterlockedPushEntrySList(&m_free, &s->m_entry);
+	if(m_waiting)
+		SetEvent(m_freeEvent);
+	InterlockedDecrement(&m_outstanding);
+	// the reference GetBuffer took, this may be the last
+	Release();
+	return S_OK;
+}
@@ -0,0 +1,133 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// The allocator the pin uses when downstream has none of its own.  The
+// buffers and samples are made once, on the first Commit after the
+// properties are set, and kept until the properties change, so stopping
+// and starting again allocates nothing.  Free samples sit on an interlocked
+// list, GetBuffer and a sample's last Release only touch that list and
+// only wait on an event when it is empty.
+class DShowMemAllocator;
+
+class DShowMediaSample : public IMediaSample
+{
+	friend class DShowMemAllocator;
+
+	SLIST_ENTRY m_entry;		// Link on the allocator's free list
+	DShowMemAllocator *m_allocator;
+	BYTE *m_buffer;
+	long m_size;
+	long m_actual;
+	volatile LONG m_refCount;
+	DWORD m_flags;				// SAMPLE_FLAGS
+	REFERENCE_TIME m_start;
+	REFERENCE_TIME m_stop;
+	LONGLONG m_mediaStart;
+	LONGLONG m_mediaStop;
+	AM_MEDIA_TYPE *m_mediaType;	// Set with SetMediaType, NULL if unchanged
+
+	enum SAMPLE_FLAGS
+	{
+		SAMPLE_SYNCPOINT = 1,
+		SAMPLE_PREROLL = 2,
+		SAMPLE_DISCONTINUITY = 4,
+		SAMPLE_START_VALID = 8,
+		SAMPLE_STOP_VALID = 16,
+		SAMPLE_MEDIATIME_VALID = 32
+	};
+	// Back to how GetBuffer hands it out
+	void recycle();
+
+public:
+	DShowMediaSample();
+	~DShowMediaSample();
+	// IUnknown
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv);
+	STDMETHODIMP_(ULONG) AddRef();
+	STDMETHODIMP_(ULONG) Release();
+	// IMediaSample
+	STDMETHODIMP GetPointer(BYTE **ppBuffer);
+	STDMETHODIMP_(long) GetSize();
+	STDMETHODIMP GetTime(REFERENCE_TIME *pTimeStart, REFERENCE_TIME *pTimeEnd);
+	STDMETHODIMP SetTime(REFERENCE_TIME *pTimeStart, REFERENCE_TIME *pTimeEnd);
+	STDMETHODIMP IsSyncPoint();
+	STDMETHODIMP SetSyncPoint(BOOL bIsSyncPoint);
+	STDMETHODIMP IsPreroll();
+	STDMETHODIMP SetPreroll(BOOL bIsPreroll);
+	STDMETHODIMP_(long) GetActualDataLength();
+	STDMETHODIMP SetActualDataLength(long length);
+	STDMETHODIMP GetMediaType(AM_MEDIA_TYPE **ppMediaType);
+	STDMETHODIMP SetMediaType(AM_MEDIA_TYPE *pMediaType);
+	STDMETHODIMP IsDiscontinuity();
+	STDMETHODIMP SetDiscontinuity(BOOL bDiscontinuity);
+	STDMETHODIMP GetMediaTime(LONGLONG *pTimeStart, LONGLONG *pTimeEnd);
+	STDMETHODIMP SetMediaTime(LONGLONG *pTimeStart, LONGLONG *pTimeEnd);
+};
+
+class DShowMemAllocator : public IMemAllocator
+{
+	SLIST_HEADER m_free;		// Samples not handed out
+	volatile LONG m_refCount;
+	volatile LONG m_committed;
+	volatile LONG m_waiting;	// GetBuffer calls about to wait for a free sample
+	volatile LONG m_outstanding;	// Samples handed out and not yet released
+	HANDLE m_freeEvent;			// Set when a sample is freed while someone waits
+	HANDLE m_decommitEvent;		// Set while decommitted, wakes GetBuffer
+	HANDLE mutex;				// Serialises SetProperties, Commit and Decommit
+
+	ALLOCATOR_PROPERTIES m_props;	// As agreed, cbBuffer 0 until SetProperties
+	bool m_useLargePages;
+	BYTE *m_memory;				// Every buffer, one VirtualAlloc block
+	SIZE_T m_memorySize;
+	bool m_largePages;			// m_memory came from large pages
+	bool m_prefaulted;			// m_memory has been touched and locked
+	DShowMediaSample *m_samples;
+	long m_sampleCount;
+
+	HRESULT allocate();
+	void release();
+	void prefault();
+
+public:
+	// Starts with the one reference the caller holds
+	DShowMemAllocator();
+	~DShowMemAllocator();
+	// Takes effect from the next allocation.  Falls back to ordinary pages
+	// when the account may not lock memory.
+	void useLargePages(bool use) {m_useLargePages = use;}
+
+	// IUnknown
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv);
+	STDMETHODIMP_(ULONG) AddRef();
+	STDMETHODIMP_(ULONG) Release();
+	// IMemAllocator
+	STDMETHODIMP SetProperties(ALLOCATOR_PROPERTIES *pRequest, ALLOCATOR_PROPERTIES *pActual);
+	STDMETHODIMP GetProperties(ALLOCATOR_PROPERTIES *pProps);
+	STDMETHODIMP Commit();
+	STDMETHODIMP Decommit();
+	STDMETHODIMP GetBuffer(IMediaSample **ppBuffer, REFERENCE_TIME *pStartTime, REFERENCE_TIME *pEndTime, DWORD dwFlags);
+	STDMETHODIMP ReleaseBuffer(IMediaSample *pBuffer);
+};
@@ -25,536 +25,179 @@
 
 //#include <streams.h>
 #include <assert.h>
+#include <malloc.h>
+#include <stdio.h>
 #include <dshow.h>
 #include <olectl.h>
 #include <initguid.h>
 #include <dvdmedia.h>
+#include "draw.h"
+#include "render.h"
+#include "schedule.h"
+#include "queue.h"
+#include "stats.h"
+#include "trace.h"
+#include "ring.h"
 #include "filter.h"
 #include "output.h"
-#include "draw.h"
 #include "memalloc.h"
 
 WCHAR VIDEO_PIN_NAME[] = L"Output Pin";
 
 #define MK4CC(a,b,c,d) (a | (b << 8) | (c << 16) | (d << 24))
 
+#ifndef MAX_TIME
+#define MAX_TIME 0x7FFFFFFFFFFFFFFF
+#endif
 
-enum OUR_FORMATS
-{
-	FORMATS_RGB32,
-	FORMATS_ARGB32,
-	FORMATS_A2RGB32, // a2 r10 g10 b10
-	FORMATS_A2BGR32, // a2 b10 g10 r10
-	FORMATS_RGB24,
-	FORMATS_RGB16_555,
-	FORMATS_RGB16_565,
-	FORMATS_ARGB16_1555,
-	FORMATS_ARGB16_4444,
-	FORMATS_RGB8,
-	FORMATS_r210, // rgb 10 bit bswap (each 32 bit have 10 bit rgb with 2 bit unused)
-	FORMATS_v210, // 4:2:2, uyvy 10 bit, with 30/32 bits used
-	FORMATS_v408, // 4:4:4  UYVA total of 32 bit
-	FORMATS_v410, // 4:4:4  VYU 2 bit unused with 10 bit, total of 32 bit
-	FORMATS_R10k, // rgb 10 bit bswap (each 32 bit have 2 bit unused and 10 bit rgb)
-	FORMATS_AYUV, // 4:4:4 packed total of 32 bit
-	FORMATS_v308, // 4:4:4  UYV  total of 24 bit
-	FORMATS_YUY2, // 4:2:2  YUYV
-	FORMATS_UYVY, // 4:2:2  UYVY
-	FORMATS_YVYU, // 4:2:2  YVYU
-	FORMATS_HDYC, // 4:2:2, UYVY, bt709
-	FORMATS_I420, // 4:2:0, Y,U,V
-	FORMATS_YV12, // 4:2:0, Y,V,U
-	FORMATS_I422, // 4:2:2, Y,U,V
-	FORMATS_YV16, // 4:2:2, Y,V,U
-	FORMATS_I444, // 4:4:4, Y,U,V
-	FORMATS_YV24, // 4:4:4, Y,V,U
-	FORMATS_NV12, // 4:2:0, Y,U+V
-	FORMATS_NV21, // 4:2:0, Y,V+U
-	FORMATS_NV16, // 4:2:0, Y,U+V
-	FORMATS_NV11, // 4:1:1, Y,U+V
-	FORMATS_444P, // 4:4:4, Y,U,V, same as I444
-	FORMATS_440P, // 4:4:0, Y,U,V
-	FORMATS_422P, // 4:2:2, Y,U,V, same as I422
-	FORMATS_411P, // 4:1:1, Y,U,V
-	FORMATS_YUV9, // 4:1:0, Y,U,V chroma: 1/4 width, 1/4 height
-	FORMATS_YVU9, // 4:1:0, Y,V,U chroma: 1/4 width, 1/4 height
-	FORMATS_Y800, // 8 bit gray
-	FORMATS_Y416, // AVYU 16 bit, total of 64 bit
-	FORMATS_Y410, // AVYU 10 bit with 2 bit alpha, total of 32 bit
-	FORMATS_Y216, // 4:2:2 YUYV 16 bit
-	FORMATS_Y210, // 4:2:2 YUYV 16 bit, lower 5 bits are zero
-	FORMATS_P216, // 4:2:2 y,u+v 16 bit
-	FORMATS_P210, // 4:2:2 y,u+v 16 bit, lower 5 bits are zero
-	FORMATS_P016, // 4:2:0 y,u+v 16 bit
-	FORMATS_P010, // 4:2:0 y,u+v 16 bit, lower 5 bits are zero
-	FORMATS_Y16,  // 16 bit gray
-	FORMATS_b16g, // 16 bit gray swap
-	FORMATS_RGB48, // (RGB0) 16 bit RGB, total of 48 bit
-	FORMATS_BGR48, // (BGR0) 16 bit RGB, total of 48 bit
-	FORMATS_RGB48_SWAP, // (0RGB) 16 bit RGB, total of 48 bit, swap
-	FORMATS_BGR48_SWAP, // (0BGR) 16 bit RGB, total of 48 bit, swap
-	FORMATS_RGBA64, // (RBA@) 16 bit RGBA, total of 64 bit
-	FORMATS_BGRA64, // (BRA@) 16 bit RGBA, total of 64 bit
-	FORMATS_RGBA64_SWAP, // (@RBA) 16 bit RGBA, total of 64 bit, swap
-	FORMATS_BGRA64_SWAP, // (@BRA) 16 bit RGBA, total of 64 bit, swap
-
-	// ffmpeg formats
-	FORMATS_RGB16_565f,
-	FORMATS_RGB16_555f,
-	FORMATS_RGB16_444f,
-	FORMATS_Y30016, // 4:4:4 Y,U,V 16 bit
-	FORMATS_Y31016, // 4:2:2 Y,U,V 16 bit
-	FORMATS_Y31116, // 4:0:0 Y,U,V 16 bit
-	FORMATS_Y16_F,  // 16 bit gray, same as Y16
-	FORMATS_GBRP,  // 8 bit G,B,R 3 planes
-	FORMATS_GBRP16,  // 8 bit G,B,R 3 planes
-	FORMATS_BGGR8,  // bayer
-	FORMATS_RGGB8,  // bayer
-	FORMATS_GBRG8,  // bayer
-	FORMATS_GRBG8,  // bayer
-	FORMATS_BGGR16,  // bayer
-	FORMATS_RGGB16,  // bayer
-	FORMATS_GBRG16,  // bayer
-	FORMATS_GRBG16,  // bayer
-
-	FORMATS_Y411, // 4:1:1 packed UYYVYY
-	FORMATS_Y41P, // 4:1:1 packed UYVYUYVYYYYY
-	FORMATS_CLJR, // 4:1:1 packed big engian DWORD(33333222221111100000UuuuuuVvvvvv)
-	FORMATS_IYUV, // same as I420
-	FORMATS_IMC1, // IMC? is various formats that use YUV 4:2:0 with 16 line padding
-	FORMATS_IMC2,
-	FORMATS_IMC3,
-	FORMATS_IMC4,
-
-	FORMATS_IUYV,  // interlaced UYVY
-	FORMATS_IY41,  // interlaced Y41P
-	FORMATS_M420,  // 4:2:0, Y,U+V vertically packed: YYYY,YYYY,UVUV
-
-	FORMATS_COUNT,
-};
 
 // IYUV same as I420
 // IMC1 IMC2
 
-OUR_FORMATS Guid_to_our_format(const GUID *SubType)
+// DirectShow subtype of each format
+struct FormatSubtype
 {
-	if(*((int*)&(SubType->Data2)) == 0x00100000 && *((long long*)&(SubType->Data4)) == 0x719B3800AA000080)
-	{
-		switch(SubType->Data1)
-		{
-		case '012r': return FORMATS_r210;
-		case '012v': return FORMATS_v210;
-		case '014v': return FORMATS_v410;
-		case 'k01R': return FORMATS_R10k;
-		case 'VUYA': return FORMATS_AYUV;
-		case '804v': return FORMATS_v408;
-		case '803v': return FORMATS_v308;
-		case '2YUY': return FORMATS_YUY2;
-		case 'UYVY': return FORMATS_YVYU;
-		case 'YVYU': return FORMATS_UYVY;
-		case '024I': return FORMATS_I420;
-		case '224I': return FORMATS_I422;
-		case '444I': return FORMATS_I444;
-		case '21VY': return FORMATS_YV12;
-		case '61VY': return FORMATS_YV16;
-		case '42VY': return FORMATS_YV24;
-		case '21VN': return FORMATS_NV12;
-		case '12VN': return FORMATS_NV21;
-		case '61VN': return FORMATS_NV16;
-		case '11VN': return FORMATS_NV11;
-		case 'CYDH': return FORMATS_HDYC;
-		case 'P444': return FORMATS_444P;
-		case 'P044': return FORMATS_440P;
-		case 'P224': return FORMATS_422P;
-		case 'P114': return FORMATS_411P;
-		case '9UVY': return FORMATS_YVU9;
-		case '9VUY': return FORMATS_YUV9;
-		case '008Y': return FORMATS_Y800;
-		case '614Y': return FORMATS_Y416;
-		case '014Y': return FORMATS_Y410;
-		case '612Y': return FORMATS_Y216;
-		case '012Y': return FORMATS_Y210;
-		case '612P': return FORMATS_P216;
-		case '012P': return FORMATS_P210;
-		case '610P': return FORMATS_P016;
-		case '010P': return FORMATS_P010;
-		case ' 61Y': return FORMATS_Y16;
-		case 'g61b': return FORMATS_b16g;
-		case '0BGR': return FORMATS_RGB48;
-		case '0RGB': return FORMATS_BGR48;
-		case 'BGR0': return FORMATS_RGB48_SWAP;
-		case 'RGB0': return FORMATS_BGR48_SWAP;
-		case '@ABR': return FORMATS_RGBA64;
-		case '@ARB': return FORMATS_BGRA64;
-		case 'ABR@': return FORMATS_RGBA64_SWAP;
-		case 'ARB@': return FORMATS_BGRA64_SWAP;
-		case '114Y': return FORMATS_Y411;
-		case 'P14Y': return FORMATS_Y41P;
-		case 'VUYI': return FORMATS_IYUV;
-		case 'RJLC': return FORMATS_CLJR;
-		case '1CMI': return FORMATS_IMC1;
-		case '2CMI': return FORMATS_IMC2;
-		case '3CMI': return FORMATS_IMC3;
-		case '4CMI': return FORMATS_IMC4;
-		case 'VYUI': return FORMATS_IUYV;
-		case '14YI': return FORMATS_IY41;
-		case '024M': return FORMATS_M420;
-		case MK4CC('R','G','B',16): return FORMATS_RGB16_565f;
-		case MK4CC('R','G','B',15): return FORMATS_RGB16_555f;
-		case MK4CC('R','G','B',12): return FORMATS_RGB16_444f;
-		case MK4CC('Y','3',0,16): return FORMATS_Y30016;
-		case MK4CC('Y','3',10,16): return FORMATS_Y31016;
-		case MK4CC('Y','3',11,16): return FORMATS_Y31116;
-		case MK4CC('Y','1',0,16): return FORMATS_Y16_F;
-		case MK4CC('G','3',0,8): return FORMATS_GBRP;
-		case MK4CC('G','3',0,16): return FORMATS_GBRP16;
-		case MK4CC(0xBA,'B','G',8): return FORMATS_BGGR8;
-		case MK4CC(0xBA,'R','G',8): return FORMATS_RGGB8;
-		case MK4CC(0xBA,'G','B',8): return FORMATS_GBRG8;
-		case MK4CC(0xBA,'G','R',8): return FORMATS_GRBG8;
-		case MK4CC(0xBA,'B','G',16): return FORMATS_BGGR16;
-		case MK4CC(0xBA,'R','G',16): return FORMATS_RGGB16;
-		case MK4CC(0xBA,'G','B',16): return FORMATS_GBRG16;
-		case MK4CC(0xBA,'G','R',16): return FORMATS_GRBG16;
-		}
-	}
-	else if(*SubType == MEDIASUBTYPE_ARGB32) return FORMATS_ARGB32;
-	else if(*SubType == MEDIASUBTYPE_RGB32) return FORMATS_RGB32;
-	else if(*SubType == MEDIASUBTYPE_A2R10G10B10) return FORMATS_A2RGB32;
-	else if(*SubType == MEDIASUBTYPE_A2B10G10R10) return FORMATS_A2BGR32;
-	else if(*SubType == MEDIASUBTYPE_RGB24) return FORMATS_RGB24;
-	else if(*SubType == MEDIASUBTYPE_RGB565) return FORMATS_RGB16_565;
-	else if(*SubType == MEDIASUBTYPE_RGB555) return FORMATS_RGB16_555;
-	else if(*SubType == MEDIASUBTYPE_ARGB1555) return FORMATS_ARGB16_1555;
-	else if(*SubType == MEDIASUBTYPE_ARGB4444) return FORMATS_ARGB16_4444;
-	else if(*SubType == MEDIASUBTYPE_RGB8) return FORMATS_RGB8;
-	return FORMATS_COUNT;
-}
+	const GUID *subtype; // for subtypes that are not a FourCC
+	DWORD fourcc;
+	WORD bitCount; // biBitCount, 0 for FourCC subtypes
+};
 
-void Set_guid_using_format(OUR_FORMATS format, GUID &g)
+// in OUR_FORMATS order: subtype, FourCC, biBitCount
+static const FormatSubtype formatSubtype[FORMATS_COUNT] =
 {
-	switch(format)
-	{
-	case FORMATS_RGB32: g = MEDIASUBTYPE_ARGB32; return;
-	case FORMATS_ARGB32: g = MEDIASUBTYPE_RGB32; return;
-	case FORMATS_A2RGB32: g = MEDIASUBTYPE_A2R10G10B10; return;
-	case FORMATS_A2BGR32: g = MEDIASUBTYPE_A2B10G10R10; return;
-	case FORMATS_RGB24: g = MEDIASUBTYPE_RGB24; return;
-	case FORMATS_RGB16_565: g = MEDIASUBTYPE_RGB565; return;
-	case FORMATS_RGB16_555: g = MEDIASUBTYPE_RGB555; return;
-	case FORMATS_ARGB16_1555: g = MEDIASUBTYPE_ARGB1555; return;
-	case FORMATS_ARGB16_4444: g = MEDIASUBTYPE_ARGB4444; return;
-	case FORMATS_RGB8: g = MEDIASUBTYPE_RGB8; return;
-	case FORMATS_r210: g.Data1 = '012r'; break;
-	case FORMATS_v210: g.Data1 = '012v'; break;
-	case FORMATS_v410: g.Data1 = '014v'; break;
-	case FORMATS_R10k: g.Data1 = 'k01R'; break;
-	case FORMATS_AYUV: g.Data1 = 'VUYA'; break;
-	case FORMATS_v408: g.Data1 = '804v'; break;
-	case FORMATS_v308: g.Data1 = '803v'; break;
-	case FORMATS_YUY2: g.Data1 = '2YUY'; break;
-	case FORMATS_YVYU: g.Data1 = 'UYVY'; break;
-	case FORMATS_UYVY: g.Data1 = 'YVYU'; break;
-	case FORMATS_HDYC: g.Data1 = 'CYDH'; break;
-	case FORMATS_I420: g.Data1 = '024I'; break;
-	case FORMATS_YV12: g.Data1 = '21VY'; break;
-	case FORMATS_I422: g.Data1 = '224I'; break;
-	case FORMATS_YV16: g.Data1 = '61VY'; break;
-	case FORMATS_I444: g.Data1 = '444I'; break;
-	case FORMATS_YV24: g.Data1 = '42VY'; break;
-	case FORMATS_NV12: g.Data1 = '21VN'; break;
-	case FORMATS_NV21: g.Data1 = '12VN'; break;
-	case FORMATS_NV16: g.Data1 = '61VN'; break;
-	case FORMATS_NV11: g.Data1 = '11VN'; break;
-	case FORMATS_444P: g.Data1 = 'P444'; break;
-	case FORMATS_440P: g.Data1 = 'P044'; break;
-	case FORMATS_422P: g.Data1 = 'P224'; break;
-	case FORMATS_411P: g.Data1 = 'P114'; break;
-	case FORMATS_YUV9: g.Data1 = '9VUY'; break;
-	case FORMATS_YVU9: g.Data1 = '9UVY'; break;
-	case FORMATS_Y800: g.Data1 = '008Y'; break;
-	case FORMATS_Y416: g.Data1 = '614Y'; break;
-	case FORMATS_Y410: g.Data1 = '014Y'; break;
-	case FORMATS_Y216: g.Data1 = '612Y'; break;
-	case FORMATS_Y210: g.Data1 = '012Y'; break;
-	case FORMATS_P216: g.Data1 = '612P'; break;
-	case FORMATS_P210: g.Data1 = '012P'; break;
-	case FORMATS_P016: g.Data1 = '610P'; break;
-	case FORMATS_P010: g.Data1 = '010P'; break;
-	case FORMATS_Y16: g.Data1 = ' 61Y'; break;
-	case FORMATS_b16g: g.Data1 = 'g61b'; break;
-	case FORMATS_RGB48: g.Data1 = '0BGR'; break;
-	case FORMATS_BGR48: g.Data1 = '0RGB'; break;
-	case FORMATS_RGB48_SWAP: g.Data1 = 'BGR0'; break;
-	case FORMATS_BGR48_SWAP: g.Data1 = 'RGB0'; break;
-	case FORMATS_RGBA64: g.Data1 = '@ABR'; break;
-	case FORMATS_BGRA64: g.Data1 = '@ARB'; break;
-	case FORMATS_RGBA64_SWAP: g.Data1 = 'ABR@'; break;
-	case FORMATS_BGRA64_SWAP: g.Data1 = 'ARB@'; break;
-	case FORMATS_Y411: g.Data1 = '114Y'; break;
-	case FORMATS_Y41P: g.Data1 = 'P14Y'; break;
-	case FORMATS_IYUV: g.Data1 = 'VUYI'; break;
-	case FORMATS_CLJR: g.Data1 = 'RJLC'; break;
-	case FORMATS_IMC1: g.Data1 = '1CMI'; break;
-	case FORMATS_IMC2: g.Data1 = '2CMI'; break;
-	case FORMATS_IMC3: g.Data1 = '3CMI'; break;
-	case FORMATS_IMC4: g.Data1 = '4CMI'; break;
-	case FORMATS_IUYV: g.Data1 = 'VYUI'; break;
-	case FORMATS_IY41: g.Data1 = '14YI'; break;
-	case FORMATS_M420: g.Data1 = '024M'; break;
-	case FORMATS_RGB16_565f: g.Data1 = MK4CC('R','G','B',16); break;
-	case FORMATS_RGB16_555f: g.Data1 = MK4CC('R','G','B',15); break;
-	case FORMATS_RGB16_444f: g.Data1 = MK4CC('R','G','B',12); break;
-	case FORMATS_Y30016: g.Data1 = MK4CC('Y','3',0,16); break;
-	case FORMATS_Y31016: g.Data1 = MK4CC('Y','3',10,16); break;
-	case FORMATS_Y31116: g.Data1 = MK4CC('Y','3',11,16); break;
-	case FORMATS_Y16_F: g.Data1 = MK4CC('Y','1',0,16); break;
-	case FORMATS_GBRP: g.Data1 = MK4CC('G','3',0,8); break;
-	case FORMATS_GBRP16: g.Data1 = MK4CC('G','3',0,16); break;
-	case FORMATS_BGGR8: g.Data1 = MK4CC(0xBA,'B','G',8); break;
-	case FORMATS_RGGB8: g.Data1 = MK4CC(0xBA,'R','G',8); break;
-	case FORMATS_GBRG8: g.Data1 = MK4CC(0xBA,'G','B',8); break;
-	case FORMATS_GRBG8: g.Data1 = MK4CC(0xBA,'G','R',8); break;
-	case FORMATS_BGGR16: g.Data1 = MK4CC(0xBA,'B','G',16); break;
-	case FORMATS_RGGB16: g.Data1 = MK4CC(0xBA,'R','G',16); break;
-	case FORMATS_GBRG16: g.Data1 = MK4CC(0xBA,'G','B',16); break;
-	case FORMATS_GRBG16: g.Data1 = MK4CC(0xBA,'G','R',16); break;
-	}
-	*(unsigned int*)&g.Data2 = 0x00100000;
-	*(unsigned long long*)g.Data4 = 0x719B3800AA000080;
-}
-
+	{&MEDIASUBTYPE_RGB32, 0, 32}, // FORMATS_RGB32
+	{&MEDIASUBTYPE_ARGB32, 0, 32}, // FORMATS_ARGB32
+	{&MEDIASUBTYPE_A2R10G10B10, 0, 32}, // FORMATS_A2RGB32
+	{&MEDIASUBTYPE_A2B10G10R10, 0, 32}, // FORMATS_A2BGR32
+	{&MEDIASUBTYPE_RGB24, 0, 24}, // FORMATS_RGB24
+	{&MEDIASUBTYPE_RGB555, 0, 16}, // FORMATS_RGB16_555
+	{&MEDIASUBTYPE_RGB565, 0, 16}, // FORMATS_RGB16_565
+	{&MEDIASUBTYPE_ARGB1555, 0, 16}, // FORMATS_ARGB16_1555
+	{&MEDIASUBTYPE_ARGB4444, 0, 16}, // FORMATS_ARGB16_4444
+	{&MEDIASUBTYPE_RGB8, 0, 8}, // FORMATS_RGB8
+	{0, '012r', 0}, // FORMATS_r210
+	{0, '012v', 0}, // FORMATS_v210
+	{0, '804v', 0}, // FORMATS_v408
+	{0, '014v', 0}, // FORMATS_v410
+	{0, 'k01R', 0}, // FORMATS_R10k
+	{0, 'VUYA', 0}, // FORMATS_AYUV
+	{0, '803v', 0}, // FORMATS_v308
+	{0, '2YUY', 0}, // FORMATS_YUY2
+	{0, 'YVYU', 0}, // FORMATS_UYVY
+	{0, 'UYVY', 0}, // FORMATS_YVYU
+	{0, 'CYDH', 0}, // FORMATS_HDYC
+	{0, '024I', 0}, // FORMATS_I420
+	{0, '21VY', 0}, // FORMATS_YV12
+	{0, '224I', 0}, // FORMATS_I422
+	{0, '61VY', 0}, // FORMATS_YV16
+	{0, '444I', 0}, // FORMATS_I444
+	{0, '42VY', 0}, // FORMATS_YV24
+	{0, '21VN', 0}, // FORMATS_NV12
+	{0, '12VN', 0}, // FORMATS_NV21
+	{0, '61VN', 0}, // FORMATS_NV16
+	{0, '11VN', 0}, // FORMATS_NV11
+	{0, 'P444', 0}, // FORMATS_444P
+	{0, 'P044', 0}, // FORMATS_440P
+	{0, 'P224', 0}, // FORMATS_422P
+	{0, 'P114', 0}, // FORMATS_411P
+	{0, '9VUY', 0}, // FORMATS_YUV9
+	{0, '9UVY', 0}, // FORMATS_YVU9
+	{0, '008Y', 0}, // FORMATS_Y800
+	{0, '614Y', 0}, // FORMATS_Y416
+	{0, '014Y', 0}, // FORMATS_Y410
+	{0, '612Y', 0}, // FORMATS_Y216
+	{0, '012Y', 0}, // FORMATS_Y210
+	{0, '612P', 0}, // FORMATS_P216
+	{0, '012P', 0}, // FORMATS_P210
+	{0, '610P', 0}, // FORMATS_P016
+	{0, '010P', 0}, // FORMATS_P010
+	{0, ' 61Y', 0}, // FORMATS_Y16
+	{0, 'g61b', 0}, // FORMATS_b16g
+	{0, '0BGR', 0}, // FORMATS_RGB48
+	{0, '0RGB', 0}, // FORMATS_BGR48
+	{0, 'BGR0', 0}, // FORMATS_RGB48_SWAP
+	{0, 'RGB0', 0}, // FORMATS_BGR48_SWAP
+	{0, '@ABR', 0}, // FORMATS_RGBA64
+	{0, '@ARB', 0}, // FORMATS_BGRA64
+	{0, 'ABR@', 0}, // FORMATS_RGBA64_SWAP
+	{0, 'ARB@', 0}, // FORMATS_BGRA64_SWAP
+	{0, MK4CC('R','G','B',16), 0}, // FORMATS_RGB16_565f
+	{0, MK4CC('R','G','B',15), 0}, // FORMATS_RGB16_555f
+	{0, MK4CC('R','G','B',12), 0}, // FORMATS_RGB16_444f
+	{0, MK4CC('Y','3',0,16), 0}, // FORMATS_Y30016
+	{0, MK4CC('Y','3',10,16), 0}, // FORMATS_Y31016
+	{0, MK4CC('Y','3',11,16), 0}, // FORMATS_Y31116
+	{0, MK4CC('Y','1',0,16), 0}, // FORMATS_Y16_F
+	{0, MK4CC('G','3',0,8), 0}, // FORMATS_GBRP
+	{0, MK4CC('G','3',0,16), 0}, // FORMATS_GBRP16
+	{0, MK4CC(0xBA,'B','G',8), 0}, // FORMATS_BGGR8
+	{0, MK4CC(0xBA,'R','G',8), 0}, // FORMATS_RGGB8
+	{0, MK4CC(0xBA,'G','B',8), 0}, // FORMATS_GBRG8
+	{0, MK4CC(0xBA,'G','R',8), 0}, // FORMATS_GRBG8
+	{0, MK4CC(0xBA,'B','G',16), 0}, // FORMATS_BGGR16
+	{0, MK4CC(0xBA,'R','G',16), 0}, // FORMATS_RGGB16
+	{0, MK4CC(0xBA,'G','B',16), 0}, // FORMATS_GBRG16
+	{0, MK4CC(0xBA,'G','R',16), 0}, // FORMATS_GRBG16
+	{0, '114Y', 0}, // FORMATS_Y411
+	{0, 'P14Y', 0}, // FORMATS_Y41P
+	{0, 'RJLC', 0}, // FORMATS_CLJR
+	{0, 'VUYI', 0}, // FORMATS_IYUV
+	{0, '1CMI', 0}, // FORMATS_IMC1
+	{0, '2CMI', 0}, // FORMATS_IMC2
+	{0, '3CMI', 0}, // FORMATS_IMC3
+	{0, '4CMI', 0}, // FORMATS_IMC4
+	{0, 'VYUI', 0}, // FORMATS_IUYV
+	{0, '14YI', 0}, // FORMATS_IY41
+	{0, '024M', 0}, // FORMATS_M420
+};
 
-const char *our_format_to_text(OUR_FORMATS type)
+// Data1 of the subtype to format, the multiplier has no collisions for the
+// formats above, a format added later that collides takes the next slot
+static unsigned char formatIndex[512];
+static unsigned int formatHash(DWORD data1)
+{
+	return (data1 * 0xE760EB97) >> 23;
+}
+static bool buildFormatIndex()
 {
-	switch(type)
+	memset(formatIndex, FORMATS_COUNT, sizeof(formatIndex));
+	for(int i = 0; i < FORMATS_COUNT; i++)
 	{
-	case FORMATS_RGB32: return "RGB32";
-	case FORMATS_ARGB32: return "ARGB32";
-	case FORMATS_A2RGB32: return "A2RGB32";
-	case FORMATS_A2BGR32: return "A2BGR32";
-	case FORMATS_RGB24: return "RGB24";
-	case FORMATS_RGB16_565: return "RGB565";
-	case FORMATS_RGB16_555: return "RGB555";
-	case FORMATS_ARGB16_1555: return "ARGB1555";
-	case FORMATS_ARGB16_4444: return "ARGB4444";
-	case FORMATS_RGB8: return "RGB8";
-	case FORMATS_r210: return "r210";
-	case FORMATS_v210: return "v210";
-	case FORMATS_v410: return "v410";
-	case FORMATS_R10k: return "r10k";
-	case FORMATS_AYUV: return "AYUV";
-	case FORMATS_v408: return "v408";
-	case FORMATS_v308: return "v308";
-	case FORMATS_YUY2: return "YUY2";
-	case FORMATS_UYVY: return "UYVY";
-	case FORMATS_YVYU: return "YVYU";
-	case FORMATS_HDYC: return "HDYC";
-	case FORMATS_I420: return "I420";
-	case FORMATS_YV12: return "YV12";
-	case FORMATS_I422: return "I422";
-	case FORMATS_YV16: return "YV16";
-	case FORMATS_I444: return "I444";
-	case FORMATS_YV24: return "YV24";
-	case FORMATS_NV12: return "NV12";
-	case FORMATS_NV21: return "NV21";
-	case FORMATS_NV16: return "NV16";
-	case FORMATS_444P: return "444P";
-	case FORMATS_440P: return "440P";
-	case FORMATS_422P: return "422P";
-	case FORMATS_411P: return "411P";
-	case FORMATS_YUV9: return "YUV9";
-	case FORMATS_YVU9: return "YVU9";
-	case FORMATS_Y800: return "Y800";
-	case FORMATS_Y416: return "Y416";
-	case FORMATS_Y410: return "Y410";
-	case FORMATS_Y216: return "Y216";
-	case FORMATS_Y210: return "Y210";
-	case FORMATS_P216: return "P216";
-	case FORMATS_P210: return "P210";
-	case FORMATS_P016: return "P016";
-	case FORMATS_P010: return "P010";
-	case FORMATS_Y16: return "Y16";
-	case FORMATS_b16g: return "g61b";
-	case FORMATS_RGB48: return "RGB48";
-	case FORMATS_BGR48: return "BGR48";
-	case FORMATS_RGB48_SWAP: return "RGB48B";
-	case FORMATS_BGR48_SWAP: return "BGR48B";
-	case FORMATS_RGBA64: return "RGBA64";
-	case FORMATS_BGRA64: return "BGRA64";
-	case FORMATS_RGBA64_SWAP: return "RGBA64B";
-	case FORMATS_BGRA64_SWAP: return "BGRA64B";
-	case FORMATS_RGB16_565f: return "RGB565f";
-	case FORMATS_RGB16_555f: return "RGB555f";
-	case FORMATS_RGB16_444f: return "RGB444f";
-	case FORMATS_Y30016: return "Y30016";
-	case FORMATS_Y31016: return "Y31016";
-	case FORMATS_Y31116: return "Y31116";
-	case FORMATS_Y16_F: return "Y16_F";
-	case FORMATS_GBRP: return "GBRP";
-	case FORMATS_GBRP16: return "GBRP16";
-	case FORMATS_BGGR8: return "BGGR8";
-	case FORMATS_RGGB8: return "RGGB8";
-	case FORMATS_GBRG8: return "GBRG8";
-	case FORMATS_GRBG8: return "GRBG8";
-	case FORMATS_BGGR16: return "BGGR16";
-	case FORMATS_RGGB16: return "RGGB16";
-	case FORMATS_GBRG16: return "GBRG16";
-	case FORMATS_GRBG16: return "GRBG16";
-	case FORMATS_Y411: return "Y411";
-	case FORMATS_Y41P: return "Y41P";
-	case FORMATS_CLJR: return "CLJR";
-	case FORMATS_IYUV: return "IYUV";
-	case FORMATS_IMC1: return "IMC1";
-	case FORMATS_IMC2: return "IMC2";
-	case FORMATS_IMC3: return "IMC3";
-	case FORMATS_IMC4: return "IMC4";
-	case FORMATS_IUYV: return "IUYV";
-	case FORMATS_IY41: return "IY41";
-	case FORMATS_M420: return "M420";
-	default: return "?????";
+		const FormatSubtype &info = formatSubtype[i];
+		unsigned int slot = formatHash(info.subtype ? info.subtype->Data1 : info.fourcc);
+		while(formatIndex[slot] != FORMATS_COUNT)
+			slot = (slot + 1) & 511;
+		formatIndex[slot] = i;
 	}
-
+	return true;
 }
+static bool formatIndexBuilt = buildFormatIndex();
 
-
-DWORD getPitch(OUR_FORMATS format, DWORD width)
+OUR_FORMATS Guid_to_our_format(const GUID *SubType)
 {
-	switch(format)
+	bool fourcc = *((int*)&(SubType->Data2)) == 0x00100000 && *((long long*)&(SubType->Data4)) == 0x719B3800AA000080;
+	for(unsigned int slot = formatHash(SubType->Data1); formatIndex[slot] != FORMATS_COUNT; slot = (slot + 1) & 511)
 	{
-	case FORMATS_r210: // multiple of 256 bytes
-		return ((width + 63) / 64) * 256;
-	case FORMATS_v210: // multiple of 128 bytes
-		return ((width + 47) / 48) * 128;
-	case FORMATS_Y416:
-	case FORMATS_RGBA64:
-	case FORMATS_BGRA64:
-	case FORMATS_RGBA64_SWAP:
-	case FORMATS_BGRA64_SWAP:
-		return width*8;
-	case FORMATS_RGB48:
-	case FORMATS_BGR48:
-	case FORMATS_RGB48_SWAP:
-	case FORMATS_BGR48_SWAP:
-		return width*6;
-	case FORMATS_Y411:
-		return ((width + 3) >> 2)*6;
-	case FORMATS_Y41P:
-	case FORMATS_IY41:
-		return ((width + 7) >> 3)*12;
-	case FORMATS_RGB32:
-	case FORMATS_ARGB32:
-	case FORMATS_A2RGB32:
-	case FORMATS_A2BGR32:
-	case FORMATS_R10k:
-	case FORMATS_AYUV:
-	case FORMATS_v408:
-	case FORMATS_v410:
-	case FORMATS_Y410:
-		return width*4;
-	case FORMATS_RGB24:
-		return (width*3 + 3) & ~3;
-	case FORMATS_RGB16_565:
-	case FORMATS_RGB16_555:
-	case FORMATS_ARGB16_1555:
-	case FORMATS_ARGB16_4444:
-		return (width*2 + 3) & ~3;
-	case FORMATS_Y216:
-	case FORMATS_Y210:
-		return ((width + 1) & ~1)*4;
-	case FORMATS_v308:
-		return width*3;
-	case FORMATS_YUY2:
-	case FORMATS_UYVY:
-	case FORMATS_YVYU:
-	case FORMATS_HDYC:
-	case FORMATS_IUYV:
-		return ((width + 1) & ~1)*2;
-	case FORMATS_P216:
-	case FORMATS_P210:
-	case FORMATS_P016:
-	case FORMATS_P010:
-	case FORMATS_RGB16_565f:
-	case FORMATS_RGB16_555f:
-	case FORMATS_RGB16_444f:
-	case FORMATS_Y16:
-	case FORMATS_b16g:
-	case FORMATS_Y16_F:
-	case FORMATS_Y30016:
-	case FORMATS_Y31016:
-	case FORMATS_Y31116:
-	case FORMATS_GBRP16:
-	case FORMATS_BGGR16:
-	case FORMATS_RGGB16:
-	case FORMATS_GBRG16:
-	case FORMATS_GRBG16:
-		return width*2;
-	case FORMATS_IMC1:
-	case FORMATS_IMC2:
-	case FORMATS_IMC3:
-	case FORMATS_IMC4:
-		return ((width + 1) & ~1);
-	//case FORMATS_440P:
-	//case FORMATS_411P:
-	//case FORMATS_YUV9:
-	//case FORMATS_YVU9:
-	case FORMATS_CLJR:
-	case FORMATS_RGB8:
-		return (width + 3) & ~3;
-	case FORMATS_M420:
-		return ((width + 1) & ~1) * 3;
-	default: return width;
+		const FormatSubtype &info = formatSubtype[formatIndex[slot]];
+		if(info.subtype ? *SubType == *info.subtype : fourcc && SubType->Data1 == info.fourcc)
+			return (OUR_FORMATS)formatIndex[slot];
 	}
+	return FORMATS_COUNT;
 }
-DWORD getImageHeightSize(OUR_FORMATS format, DWORD pitch, DWORD height)
+
+void Set_guid_using_format(OUR_FORMATS format, GUID &g)
 {
-	switch(format)
+	if(formatSubtype[format].subtype)
 	{
-	case FORMATS_M420:
-		return pitch * ((height + 1) >> 1);  //   1/2, align by 2
-	case FORMATS_IMC1:
-	case FORMATS_IMC3:
-		return (((((height * 3) / 2) + 15) & ~15) + ((height/2 + 15) & ~15)) * pitch;
-	case FORMATS_IMC2:
-	case FORMATS_IMC4:
-		return (((((height * 3) / 2) + 15) & ~15)) * pitch;
-	case FORMATS_440P:
-		return pitch * (((height + 1) & ~1) + height);
-	case FORMATS_I444:
-	case FORMATS_YV24:
-	case FORMATS_444P:
-	case FORMATS_Y30016:
-	case FORMATS_GBRP:
-	case FORMATS_GBRP16:
-		return pitch * height * 3;
-	case FORMATS_YUV9:
-	case FORMATS_YVU9:
-		return pitch * height + ((pitch + 3) >> 2) * ((height + 3) >> 2) * 2;
-	case FORMATS_P216:
-	case FORMATS_P210:
-	case FORMATS_Y31016:
-		return (pitch + ((pitch + 3) & ~3)) * height;
-	case FORMATS_P016:
-	case FORMATS_P010:
-	case FORMATS_Y31116:
-		return pitch * height + ((pitch + 3) & ~3) * ((height + 1) >> 1);
-	case FORMATS_I422:
-	case FORMATS_YV16:
-	case FORMATS_NV16:
-	case FORMATS_422P:
-		return (pitch + ((pitch + 1) & ~1)) * height;
-	case FORMATS_I420:
-	case FORMATS_YV12:
-	case FORMATS_NV12:
-	case FORMATS_NV21:
-	case FORMATS_IYUV:
-		return pitch * height + ((pitch + 1) & ~1) * ((height + 1) >> 1);
- 	case FORMATS_411P:
- 	case FORMATS_NV11:
-		return (pitch + ((pitch + 3) >> 2)*2) * height;
+		g = *formatSubtype[format].subtype;
+		return;
 	}
-	return pitch * height;
+	g.Data1 = formatSubtype[format].fourcc;
+	*(unsigned int*)&g.Data2 = 0x00100000;
+	*(unsigned long long*)g.Data4 = 0x719B3800AA000080;
 }
+
+
 static DWORD getImageSize(OUR_FORMATS format, DWORD width, DWORD height)
 {
 	return getImageHeightSize(format, getPitch(format, width), height);
@@ -567,6 +210,21 @@ static BITMAPINFOHEADER* GetVideoBMIHeader(const AM_MEDIA_TYPE *pMT)
 		&reinterpret_cast<VIDEOINFOHEADER*>(pMT->pbFormat)->bmiHeader : 
 		&reinterpret_cast<VIDEOINFOHEADER2*>(pMT->pbFormat)->bmiHeader;
 }
+// Where downstream wants the picture in its surface, false when it cannot be
+// drawn there.  VIDEOINFOHEADER2 starts with the same rectangles.
+static bool GetVideoTarget(const AM_MEDIA_TYPE *pMT, OUR_FORMATS format, RECT &target, DWORD &offset)
+{
+	const BITMAPINFOHEADER *bmi = GetVideoBMIHeader(pMT);
+	LONG height = abs(bmi->biHeight);
+	target = reinterpret_cast<VIDEOINFOHEADER*>(pMT->pbFormat)->rcTarget;
+	if(IsRectEmpty(&target))
+		SetRect(&target, 0, 0, bmi->biWidth, height);
+	if(target.left < 0 || target.top < 0 || target.right > bmi->biWidth || target.bottom > height)
+		return false;
+	bool bottomUp = bmi->biHeight > 0 && bmi->biCompression <= BI_BITFIELDS;
+	return getTargetOffset(format, getPitch(format, bmi->biWidth), height, target.left, target.top,
+		target.right - target.left, target.bottom - target.top, bottomUp, offset);
+}
 static void WINAPI FreeMediaType(AM_MEDIA_TYPE & mt)
 {
 	if(mt.cbFormat != 0)
@@ -576,6 +234,7 @@ static void WINAPI FreeMediaType(AM_MEDIA_TYPE & mt)
 		mt.pbFormat = NULL;
 	}
 	if(mt.pUnk) mt.pUnk->Release();
+	mt.pUnk = NULL;
 }
 HRESULT CopyMediaType(AM_MEDIA_TYPE *pmtTarget, const AM_MEDIA_TYPE *pmtSource)
 {
@@ -601,17 +260,6 @@ HRESULT CopyMediaType(AM_MEDIA_TYPE *pmtTarget, const AM_MEDIA_TYPE *pmtSource)
 	return S_OK;
 }
 
-static VIDEOINFO *AllocFormatBuffer(AM_MEDIA_TYPE *m, ULONG length)
-{
-	if(length == m->cbFormat)
-		return (VIDEOINFO*) m->pbFormat;
-	m->cbFormat = length;
-	void *b = CoTaskMemAlloc(length);
-	m->pbFormat = (BYTE*)b;
-	return (VIDEOINFO*) b;
-}
-
-
 
 
 
@@ -682,18 +330,96 @@ static DWORD WINAPI start_thread_COutputPin1(LPVOID lpParam)
 	return s->threadCreated1();
 }
 
+static DWORD WINAPI start_deliver_thread_COutputPin1(LPVOID lpParam)
+{
+	COutputPin1 *s = (COutputPin1*)lpParam;
+	return s->deliverThread();
+}
+
+
 
 
+GraphClock::GraphClock()
+{
+	m_clock = NULL;
+	m_event = CreateEvent(NULL, false, false, NULL);
+}
+
+GraphClock::~GraphClock()
+{
+	setClock(NULL);
+	CloseHandle(m_event);
+}
+
+void GraphClock::setClock(IReferenceClock *clock)
+{
+	if(clock)
+		clock->AddRef();
+	if(m_clock)
+		m_clock->Release();
+	m_clock = clock;
+}
+
+long long GraphClock::now()
+{
+	REFERENCE_TIME t = 0;
+	m_clock->GetTime(&t);
+	return t;
+}
+
+void GraphClock::sleepUntil(long long t, HANDLE wake)
+{
+	REFERENCE_TIME wait = t - now();
+	if(wait <= 0)
+		return;
+	// the clock can fire the last advise after it timed out or was woken
+	ResetEvent(m_event);
+	DWORD_PTR cookie;
+	if(m_clock->AdviseTime(t, 0, (HEVENT)m_event, &cookie) != S_OK)
+	{
+		if(wake)
+			WaitForSingleObject(wake, (DWORD)(wait / 10000));
+		else
+			Sleep((DWORD)(wait / 10000));
+		return;
+	}
+	// give up a little after the time in case the clock stops
+	HANDLE events[2] = {m_event, wake};
+	if(WaitForMultipleObjects(wake ? 2 : 1, events, FALSE, (DWORD)(wait / 10000) + 100) != WAIT_OBJECT_0)
+		m_clock->Unadvise(cookie);
+}
 
 // Constructor
 COutputPin1::COutputPin1(CFilter1 *pParent) :
 	m_iImageWidth(512),
 	m_iImageHeight(512),
-	m_iDefaultRepeatTime(20)
+	m_rtRepeatTime(200000),
+	m_rtDefaultRepeatTime(200000),
+	m_streamingThreshold(4*1024*1024),
+	m_renderThreads(0),
+	m_stripeHeight(64),
+	m_buffers(4),
+	m_renderAhead(3),
+	m_spinTime(2000),
+	m_latePolicy(LATE_DROP),
+	m_unthrottled(0),
+	m_traceEvents(65536),
+	m_largePages(0),
+	m_sharedRing(0),
+	m_stress(false),
+	m_discontinuity(false),
+	m_pacedRequest(0),
+	m_delivered(0)
 {
 	refCount = 0; // Only base filter can delete this pin.
-	m_frametime = (((LONGLONG)m_iDefaultRepeatTime) * 10000);
+	m_frametime = m_rtDefaultRepeatTime;
 	m_preferredFormat = 0;//FORMATS_RGB32;
+	m_types = NULL;
+	memset(m_configs, 0, sizeof(m_configs));
+	m_configCount = 0;
+	m_configReuse = 0;
+	m_nextConfig = NULL;
+	m_config = NULL;
 
 	filter = pParent;
 	connectedPin = NULL;
@@ -701,17 +427,31 @@ COutputPin1::COutputPin1(CFilter1 *pParent) :
 	connectedMemInputPin = NULL;
 	memset(&m_mt, 0, sizeof(m_mt));
 
-	readTextFile(text8x8);
-
 	framecount = 0;
-	render = false;
-	exitnow = false;
+	m_state = STREAM_STOPPED;
+	m_request = 0;
+	m_acted = 0;
+	m_requestTime = 0;
+	m_transitions = 0;
+	m_transitionSum = 0;
+	m_transitionMax = 0;
+	memset(&m_throughput, 0, sizeof(m_throughput));
 	m_rtSampleTime = 0;
+	m_rtSampleStep = 0;
+	m_sampleFrame = 0;
+	m_mediaFrame = 0;
+	m_tStart = 0;
 
 	mutex = CreateMutex(NULL, false, NULL);
+	lateMutex = CreateMutex(NULL, false, NULL);
+	typesMutex = CreateMutex(NULL, false, NULL);
+	configMutex = CreateMutex(NULL, false, NULL);
 	thread1 = NULL;
 	threadEvent = CreateEvent(NULL, false, false, NULL);
-	threadWaitingEvent = CreateEvent(NULL, true, false, NULL);
+	threadActedEvent = CreateEvent(NULL, false, false, NULL);
+	thread2 = NULL;
+	deliverEvent = CreateEvent(NULL, false, false, NULL);
+	deliverActedEvent = CreateEvent(NULL, false, false, NULL);
 }
 
 // Destructor
@@ -720,18 +460,34 @@ COutputPin1::~COutputPin1()
 	if(refCount != 0)
 		DebugBreak();
 	WaitForSingleObject(mutex, INFINITE);
+	stop_nolock();
 	if(thread1)
-		stop_nolock();
+	{
+		LONG request;
+		requestState(STREAM_EXIT, &request);
+		WaitForSingleObject(thread1, INFINITE);
+		CloseHandle(thread1);
+		// frames the worker queued last are let go of before it ends
+		SetEvent(deliverEvent);
+		WaitForSingleObject(thread2, INFINITE);
+		CloseHandle(thread2);
+	}
 	if(connectedPin) connectedPin->Release();
 	if(connectedMemInputPin) connectedMemInputPin->Release();
 	if(memAlloc) memAlloc->Release();
 	FreeMediaType(m_mt);
+	delete m_types;
 	CloseHandle(mutex);
+	CloseHandle(lateMutex);
+	CloseHandle(typesMutex);
+	CloseHandle(configMutex);
 	CloseHandle(threadEvent);
-	CloseHandle(threadWaitingEvent);
+	CloseHandle(threadActedEvent);
+	CloseHandle(deliverEvent);
+	CloseHandle(deliverActedEvent);
 }
 
-HRESULT COutputPin1::FillBuffer(IMediaSample *pms)
+HRESULT COutputPin1::FillBuffer(IMediaSample *pms, bool repeat)
 {
 	// draw stuff
 	//CheckPointer(pms,E_POINTER);
@@ -742,599 +498,60 @@ HRESULT COutputPin1::FillBuffer(IMediaSample *pms)
 	pms->GetPointer(&pData);
 	//lDataLen = pms->GetSize();
 
+	// downstream attaches a type only when it changes it
 	AM_MEDIA_TYPE *pmt = NULL;
-	pms->GetMediaType(&pmt);
-	if(pmt)
-	{
-		VIDEOINFO *pvi = (VIDEOINFO *) pmt->pbFormat;
-		//int width3 = pvi->bmiHeader.biWidth;
-		//pvi->bmiHeader.biWidth = ((VIDEOINFO *)m_mt.pbFormat)->bmiHeader.biWidth;
-		SetMediaType((AM_MEDIA_TYPE*)pmt);
-		//pvi->bmiHeader.biWidth = width3;
-		//m_iImagePitch = getPitch(Guid_to_our_format(&(((AM_MEDIA_TYPE*)pmt)->subtype)), width3);
-		if(pmt->pbFormat)
-			CoTaskMemFree((PVOID)pmt->pbFormat);
-		if(pmt->pUnk)
-			CoTaskMemFree((PVOID)pmt->pUnk);
-		CoTaskMemFree((PVOID)pmt);
-	}
-
-	{
-
-	VIDEOINFO *pvi = (VIDEOINFO *) m_mt.pbFormat;
-	OUR_FORMATS format = Guid_to_our_format(&(m_mt.subtype));
-	if(format >= FORMATS_COUNT)
-		return E_INVALIDARG;
-
-	//int pitch = m_iImagePitch;//pvi->bmiHeader.biWidth * (pvi->bmiHeader.biBitCount >> 3);
-	//int pitch = lDataLen / abs(pvi->bmiHeader.biHeight);
-	int pitch = getPitch(format, m_iImageWidth);
-	int height = abs(m_iImageHeight);
-	//if(lDataLen != 0 && getImageHeightSize(format, pitch, height) > (unsigned int) lDataLen)
-	//	return 0;
-	if(pms->SetActualDataLength(getImageHeightSize(format, pitch, height)) != S_OK)
-		return 0;
-
-	BYTE *pDataOrig = pData;
-	int pitchOrig = pitch;
-
-
-	if(m_iImageHeight > 0 && pvi->bmiHeader.biCompression  <= BI_BITFIELDS)
-	{
-		pData = &pData[(abs(m_iImageHeight)-1)*pitch];
-		pitch = -pitch;
-	}
-
-
-	static const BYTE zeromem1[4] = {0,0,0,0};
-
-	//ZeroMemory(pData, lDataLen);
-	int width = abs(m_iImageWidth);
-	int width1 = width / 4;
-	int width2 = width / 2;
-	int width3 = width * 3 / 4;
-
-	//pms->SetActualDataLength(abs(m_iImagePitch) * height);
-	getImageHeightSize(format, abs(m_iImagePitch), height);
-
-	DrawCharInfo info;
-	info.text = text8x8;
-	info.drawCharFunc = drawChar8;
-	info.ptr_offset = 0;
-	info.add = 0;
-	info.mask = -1;
-	info.pitch = pitch;
-	info.bytes = 1;
-
-	framecount++;
-
-	unsigned int tmp1 = 0;
-	//DrawBitFunc32 tmp1func32 = 0;
-	switch(format)
-	{
-	case FORMATS_RGB32:
-	case FORMATS_ARGB32:
-		info.drawCharFunc = drawChar32; info.bytes = 4;
-		draw_32bit(&pData[0], pitch, width1, height, 0xFF000000, 0x00000001, 256);
-		draw_32bit(&pData[width1*4], pitch, width2-width1, height, 0xFF000000, 0x00000100, 256);
-		draw_32bit(&pData[width2*4], pitch, width3-width2, height, 0xFF000000, 0x00010000, 256);
-		draw_32bit(&pData[width3*4], pitch, width-width3, height, 0x00000000, 0x01010101, 256);
-		break;
-	case FORMATS_A2RGB32:
-	case FORMATS_A2BGR32:
-	case FORMATS_r210:
-	case FORMATS_R10k:
-	{
-		info.drawCharFunc = drawChar32; info.bytes = 4;
-		DrawBitFunc32 draw_func;
-		unsigned int rev=0;
-		unsigned int rot=0;
-		switch(format)
-		{
-		case FORMATS_R10k: rot=2;
-		case FORMATS_r210: draw_func = draw_32bit_swap; break;
-		case FORMATS_A2BGR32: rev = 20;
-		default: draw_func = draw_32bit;
-		}
-		unsigned int color1 = _lrotl(0xC0000000, rot);
-		draw_func(&pData[0], pitch, width1, height, color1, _lrotl(0x00000001 << rev, rot), 1024);
-		draw_func(&pData[width1*4], pitch, width2-width1, height, color1, _lrotl(0x00000400, rot), 1024);
-		draw_func(&pData[width2*4], pitch, width3-width2, height, color1, _lrotl(0x00100000 >> rev, rot), 1024);
-		draw_func(&pData[width3*4], pitch, width-width3, height, color1, 0x40100401 << rot, 1024);
-		break;
-	}
-	case FORMATS_v210:
-		info.drawCharFunc = drawChar_v210; info.bytes = 0;
-		draw_v210(pData, pitch,      0, width1, height, 0x20080000, 0x00000001, 1024);
-		draw_v210(pData, pitch, width1, width2, height, 0x00080000, 0x00100001, 1024);
-		draw_v210(pData, pitch, width2, width3, height, 0x00080200, 0x00100000, 1024);
-		draw_v210(pData, pitch, width3, width , height, 0x20000200, 0x00000400, 1024);
-		break;
-	case FORMATS_RGB24:
-		info.drawCharFunc = drawChar24; info.bytes = 3;
-		draw_24bit(&pData[0], pitch, width1, height, 0xFF000000, 0x00000001, 256);
-		draw_24bit(&pData[width1*3], pitch, width2-width1, height, 0xFF000000, 0x00000100, 256);
-		draw_24bit(&pData[width2*3], pitch, width3-width2, height, 0xFF000000, 0x00010000, 256);
-		draw_24bit(&pData[width3*3], pitch, width-width3, height, 0x00000000, 0x01010101, 256);
-		break;
-	case FORMATS_RGB16_555:
-	case FORMATS_ARGB16_1555:
-	case FORMATS_RGB16_555f:
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		draw_16bit(&pData[0], pitch, width1, height, 0x8000, 0x0001, 32);
-		draw_16bit(&pData[width1*2], pitch, width2-width1, height, 0x8000, 0x0020, 32);
-		draw_16bit(&pData[width2*2], pitch, width3-width2, height, 0x8000, 0x0400, 32);
-		draw_16bit(&pData[width3*2], pitch, width-width3, height, 0x8000, 0x8421, 32);
-		break;
-	case FORMATS_ARGB16_4444:
-	case FORMATS_RGB16_444f:
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		draw_16bit(&pData[0], pitch, width1, height, 0xF000, 0x0001, 16);
-		draw_16bit(&pData[width1*2], pitch, width2-width1, height, 0xF000, 0x0010, 16);
-		draw_16bit(&pData[width2*2], pitch, width3-width2, height, 0xF000, 0x0100, 16);
-		draw_16bit(&pData[width3*2], pitch, width-width3, height, 0x0000, 0x1111, 16);
-		break;
-	case FORMATS_RGB16_565:
-	case FORMATS_RGB16_565f:
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		draw_16bit(&pData[0], pitch, width1, height, 0x0000, 0x0001, 32);
-		draw_16bit(&pData[width1*2], pitch, width2-width1, height, 0x0000, 0x0020, 64);
-		draw_16bit(&pData[width2*2], pitch, width3-width2, height, 0x0000, 0x0800, 32);
-		draw_16bit(&pData[width3*2], pitch, width-width3, height, 0x0200, 0x0821, 32);
-		break;
-	case FORMATS_RGB48:
-	case FORMATS_BGR48:
-	case FORMATS_RGB48_SWAP:
-	case FORMATS_BGR48_SWAP:
-	case FORMATS_RGBA64:
-	case FORMATS_BGRA64:
-	case FORMATS_RGBA64_SWAP:
-	case FORMATS_BGRA64_SWAP:
+	if(pms->GetMediaType(&pmt) == S_OK && pmt)
 	{
-		DrawBitFunc64 tmp1func64;
-		unsigned int rev=0;
-		switch(format)
-		{
-		case FORMATS_RGB48: rev=32;
-		case FORMATS_BGR48: tmp1func64 = draw_48bit; info.drawCharFunc = drawChar48; info.bytes = 6; break;
-		case FORMATS_RGB48_SWAP: rev=32;
-		case FORMATS_BGR48_SWAP: tmp1func64 = draw_48bit_swap16; info.drawCharFunc = drawChar48; info.bytes = 6; break;
-		case FORMATS_RGBA64: rev=32;
-		case FORMATS_BGRA64: tmp1func64 = draw_64bit; info.drawCharFunc = drawChar64; info.bytes = 8; break;
-		case FORMATS_RGBA64_SWAP: rev=32;
-		case FORMATS_BGRA64_SWAP: tmp1func64 = draw_64bit_swap16; info.drawCharFunc = drawChar64; info.bytes = 8; break;
-		}
-		tmp1func64(&pData[0], pitch, width1, height, 0xFFFF000000000000, 0x0000000000000001ull << rev, 65536);
-		tmp1func64(&pData[width1*info.bytes], pitch, width2-width1, height, 0xFFFF000000000000, 0x0000000000010000, 65536);
-		tmp1func64(&pData[width2*info.bytes], pitch, width3-width2, height, 0xFFFF000000000000, 0x0000000100000000 >> rev, 65536);
-		tmp1func64(&pData[width3*info.bytes], pitch, width-width3, height, 0x0000000000000000, 0x0001000100010001, 65536);
-		break;
+		SetMediaType(pmt);
+		FreeMediaType(*pmt);
+		CoTaskMemFree(pmt);
 	}
-	case FORMATS_GBRP:
-	{
-		info.drawCharFunc = drawChar8; info.bytes = 1;
-		draw_8bit(&pData[0], pitch, width1, height, 0x00, 0x00, 256);
-		draw_8bit(&pData[width1], pitch, width2-width1, height, 0x00, 0x01, 256);
-		draw_8bit(&pData[width2], pitch, width3-width2, height, 0x00, 0x00, 256);
-		draw_8bit(&pData[width3], pitch, width-width3, height, 0x00, 0x01, 256);
-		BYTE *pData2 = &pData[pitch * height];
-		draw_8bit(&pData2[0], pitch, width1, height, 0x00, 0x01, 256);
-		draw_8bit(&pData2[width1], pitch, width3-width1, height, 0x00, 0x00, 256);
-		draw_8bit(&pData2[width3], pitch, width-width3, height, 0x00, 0x01, 256);
-		pData2 = &pData2[pitch * height];
-		draw_8bit(&pData2[0], pitch, width2, height, 0x00, 0x00, 256);
-		draw_8bit(&pData2[width2], pitch, width-width2, height, 0x00, 0x01, 256);
-		break;
-	}
-	case FORMATS_GBRP16:
-	{
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		draw_16bit(&pData[0], pitch, width1, height, 0x00, 0x00, 65536);
-		draw_16bit(&pData[width1*2], pitch, width2-width1, height, 0x00, 0x01, 65536);
-		draw_16bit(&pData[width2*2], pitch, width3-width2, height, 0x00, 0x00, 65536);
-		draw_16bit(&pData[width3*2], pitch, width-width3, height, 0x00, 0x01, 65536);
-		BYTE *pData2 = &pData[pitch * height];
-		draw_16bit(&pData2[0], pitch, width1, height, 0x00, 0x01, 65536);
-		draw_16bit(&pData2[width1*2], pitch, width3-width1, height, 0x00, 0x00, 65536);
-		draw_16bit(&pData2[width3*2], pitch, width-width3, height, 0x00, 0x01, 65536);
-		pData2 = &pData2[pitch * height];
-		draw_16bit(&pData2[0], pitch, width2, height, 0x00, 0x00, 65536);
-		draw_16bit(&pData2[width2*2], pitch, width-width2, height, 0x00, 0x01, 65536);
-		break;
-	}
-	case FORMATS_BGGR8:
-	case FORMATS_RGGB8:
-	case FORMATS_GBRG8:
-	case FORMATS_GRBG8:
-	{
-		info.drawCharFunc = drawChar8; info.bytes = 1;
-		U32 green = (format == FORMATS_BGGR8 || format == FORMATS_RGGB8) ? 0x00010100 : 0x01000001;
-		U32 blue = ((format == FORMATS_RGGB8 || format == FORMATS_GRBG8) ? 0x01010000 : 0x00000101) & ~green;
-		draw_8bit_bayer(pData, pitch, 0, 0, width1, height, 0x00000000, blue, 256);
-		draw_8bit_bayer(pData, pitch, width1, 0, width2-width1, height, 0x00000000, green, 256);
-		U32 red = (blue ^ 0x01010101) & ~green;
-		draw_8bit_bayer(pData, pitch, width2, 0, width3-width2, height, 0x00000000, red, 256);
-		draw_8bit_bayer(pData, pitch, width3, 0, width -width3, height, 0x00000000, 0x01010101, 256);
-		break;
-	}
-	case FORMATS_BGGR16:
-	case FORMATS_RGGB16:
-	case FORMATS_GBRG16:
-	case FORMATS_GRBG16:
-	{
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		U64 green = (format == FORMATS_BGGR16 || format == FORMATS_RGGB16) ? 0x0000000100010000ull : 0x0001000000000001ull;
-		U64 blue = ((format == FORMATS_RGGB16 || format == FORMATS_GRBG16) ? 0x0001000100000000ull : 0x0000000000010001ull) & ~green;
-		draw_16bit_bayer(pData, pitch, 0, 0, width1, height, 0x0000000000000000, blue, 65536);
-		draw_16bit_bayer(pData, pitch, width1, 0, width2-width1, height, 0x0000000000000000, green, 65536);
-		U64 red = (blue ^ 0x0001000100010001) & ~green;
-		draw_16bit_bayer(pData, pitch, width2, 0, width3-width2, height, 0x0000000000000000, red, 65536);
-		draw_16bit_bayer(pData, pitch, width3, 0, width -width3, height, 0x0000000000000000, 0x0001000100010001, 65536);
-		break;
-	}
-	case FORMATS_AYUV:
-	case FORMATS_v408:
-	{
-		info.drawCharFunc = drawChar32; info.bytes = 4;
-		unsigned int f = 0;
-		switch(format)
-		{
-		case FORMATS_v408: f=1; break;
-		}
-		static unsigned int colu[] = {0x000100, 0x000001};
-		static unsigned int colv[] = {0x000001, 0x010000};
-		static unsigned int coly[] = {0x010000, 0x000100};
-		info.add = (colu[f] + colv[f]) * 128; info.mask = coly[f] * 255;
-		draw_32bit(&pData[0], pitch, width1, height, (colv[f] + coly[f]) * 128 + 0xFF000000, colu[f], 256);
-		draw_32bit(&pData[width1*4], pitch, width2 - width1, height, (coly[f]) * 128 + 0xFF000000, colu[f] + colv[f], 256);
-		draw_32bit(&pData[width2*4], pitch, width3 - width2, height, (colu[f] + coly[f]) * 128 + 0xFF000000, colv[f], 256);
-		draw_32bit(&pData[width3*4], pitch, width  - width3, height, (colu[f] + colv[f]) * 128, coly[f] + 0x01000000, 256);
-		break;
-	}
-	case FORMATS_v308:
-		info.drawCharFunc = drawChar24; info.bytes = 3;
-		info.add = 0x800080; info.mask = 0x00FF00;
-		draw_24bit(&pData[0], pitch, width1, height, 0x008080, 0x010000, 256);
-		draw_24bit(&pData[width1*3], pitch, width2-width1, height, 0x008000, 0x010001, 256);
-		draw_24bit(&pData[width2*3], pitch, width3-width2, height, 0x808000, 0x000001, 256);
-		draw_24bit(&pData[width3*3], pitch, width-width3, height, 0x800080, 0x000100, 256);
-		break;
-	case FORMATS_YUY2:
-	case FORMATS_YVYU:
-	case FORMATS_UYVY:
-	case FORMATS_HDYC:
-	{
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		unsigned int f = 0;
-		switch(format)
-		{
-		case FORMATS_YUY2: f=1; break;
-		case FORMATS_YVYU: f=2; break;
-		}
-		static unsigned int colu[] = {0x00000001, 0x00000100, 0x01000000};
-		static unsigned int colv[] = {0x00010000, 0x01000000, 0x00000100};
-		static unsigned int coly[] = {0x01000100, 0x00010001, 0x00010001};
-		info.add = (colu[f] + colv[f])*128; info.mask = coly[f]*255;
-		draw_32bit(&pData[0], pitch, width1 >> 1, height, (colv[f] + coly[f]) * 128, colu[f], 256);
-		draw_32bit(&pData[(width1 & ~1)*2], pitch, (width2 >> 1) - (width1 >> 1), height, (coly[f]) * 128, colu[f] + colv[f], 256);
-		draw_32bit(&pData[(width2 & ~1)*2], pitch, (width3 >> 1) - (width2 >> 1), height, (colu[f] + coly[f]) * 128, colv[f], 256);
-		draw_32bit(&pData[(width3 & ~1)*2], pitch, (width  >> 1) - (width3 >> 1), height, (colu[f] + colv[f]) * 128, coly[f], 256);
-		break;
-	}
-	case FORMATS_IUYV:
-	{
-		BYTE *pData2 = &pData[((height+1) >> 1)*pitch];
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		info.add = (0x00010001)*128; info.mask = 0x01000100*255;
-		info.ptr_offset = (intptr_t)pData2 - (intptr_t)pData;
-		draw_32bit(&pData[0], pitch, width1 >> 1, height, 0x01010100 * 128, 0x00000001, 256, &pData2[0]);
-		draw_32bit(&pData[(width1 & ~1)*2], pitch, (width2 >> 1) - (width1 >> 1), height, (0x01000100) * 128, 0x00010001, 256, &pData2[(width1 & ~1)*2]);
-		draw_32bit(&pData[(width2 & ~1)*2], pitch, (width3 >> 1) - (width2 >> 1), height, 0x01000101 * 128, 0x00010000, 256, &pData2[(width2 & ~1)*2]);
-		draw_32bit(&pData[(width3 & ~1)*2], pitch, (width  >> 1) - (width3 >> 1), height, 0x00010001 * 128, 0x01000100, 256, &pData2[(width3 & ~1)*2]);
-		break;
-	}
-	case FORMATS_I420:
-	case FORMATS_YV12:
-	case FORMATS_IYUV:
-	case FORMATS_IMC1:
-	case FORMATS_IMC2:
-	case FORMATS_IMC3:
-	case FORMATS_IMC4:
-	{
-		int pitch2 = (pitch+1) >> 1;
-		int height2 = (height+1) >> 1;
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch2*height2];
-		switch(format)
-		{
-		case FORMATS_IMC1:
-		case FORMATS_IMC3:
-			pDatau = &pDataOrig[((height + 15) & ~15)*pitch];
-			pDatav = &pDataOrig[((((height * 3) >> 1) + 15) & ~15)*pitch];
-			pitch2 = pitch;
-			break;
-		case FORMATS_IMC2:
-		case FORMATS_IMC4:
-			pDatau = &pDataOrig[((height + 15) & ~15)*pitch];
-			pDatav = pDatau + (pitch >> 1);
-			pitch2 = pitch;
-			break;
-		}
-		if(format == FORMATS_YV12 || format == FORMATS_IMC1 || format == FORMATS_IMC2)
-		{
-			BYTE *tmp = pDatau; pDatau = pDatav; pDatav = tmp;
-		}
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8(pDatau, pDatav, pitch2, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1);
-		break;
-	}
-	case FORMATS_I422:
-	case FORMATS_YV16:
-	case FORMATS_422P:
-	{
-		int pitch2 = (pitch+1) >> 1;
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch2*height];
-		if(format == FORMATS_YV16)
-		{
-			BYTE *tmp = pDatau; pDatau = pDatav; pDatav = tmp;
-		}
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8(pDatau, pDatav, pitch2, height, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1);
-		break;
-	}
-	case FORMATS_I444:
-	case FORMATS_YV24:
-	case FORMATS_444P:
-	{
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch*height];
-		if(format == FORMATS_YV24)
-		{
-			BYTE *tmp = pDatau; pDatau = pDatav; pDatav = tmp;
-		}
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8(pDatau, pDatav, pitch, height, width1, width2, width3, width);
-		break;
-	}
-	case FORMATS_440P:
-	{
-		int height2 = (height+1) >> 1;
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch*height2];
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8(pDatau, pDatav, pitch, height2, width1, width2, width3, width);
-		break;
-	}
-	case FORMATS_411P:
-	{
-		int pitch2 = (pitch+3) >> 2;
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch2*height];
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8(pDatau, pDatav, pitch2, height, width1 >> 2, width2 >> 2, width3 >> 2, (width+3) >> 2);
-		break;
-	}
-	case FORMATS_NV11:
-	{
-		BYTE *pDatac = &pDataOrig[pitch*height];
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8_interleaved(pDatac, ((pitch+3) >> 2) * 1, height, width1 >> 2, width2 >> 2, width3 >> 2, (width+3) >> 2, false);
-		break;
-	}
-	case FORMATS_YUV9:
-	case FORMATS_YVU9:
-	{
-		int pitch2 = (pitch+3) >> 2;
-		int height2 = (height+3) >> 2;
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch2*height2];
-		if(format == FORMATS_YVU9)
-		{
-			BYTE *tmp = pDatau; pDatau = pDatav; pDatav = tmp;
-		}
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8(pDatau, pDatav, pitch2, height2, width1 >> 2, width2 >> 2, width3 >> 2, (width+3) >> 2);
-		break;
-	}
-	case FORMATS_NV12:
-	case FORMATS_NV21:
-	{
-		int height2 = (height+1) >> 1;
-		BYTE *pDatac = &pDataOrig[pitch*height];
 
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8_interleaved(pDatac, (pitch+1) & ~1, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, format == FORMATS_NV21);
-		break;
-	}
-	case FORMATS_M420:
-	{
-		int height2 = (height+1) >> 1;
-		int pitch13 = pitch / 3;
-		BYTE *pDatac = &pData[pitch13*2];
-		info.ptr_offset = (intptr_t)pitch13;
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width, &pData[pitch13]);
-		drawColorLayer8_interleaved(pDatac, pitch, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, false);
-		break;
-	}
-	case FORMATS_NV16:
-	{
-		BYTE *pDatac = &pDataOrig[pitch*height];
-
-		drawIntinsityLayer8(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer8_interleaved(pDatac, (pitch+1) & ~1, height, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, false);
-		break;
-	}
-	case FORMATS_Y30016:
+	// a type set since the last frame is taken up here, otherwise this is one compare
+	if(m_nextConfig != m_config)
 	{
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch*height];
-
-		drawIntinsityLayer16(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer16(pDatau, pDatav, pitch, height, width1, width2, width3, width);
-		break;
+		WaitForSingleObject(configMutex, INFINITE);
+		m_config = m_nextConfig;
+		ReleaseMutex(configMutex);
+		const RECT &target = m_config->target;
+		m_renderer.setFormat(m_config->format, target.right - target.left, target.bottom - target.top, m_config->bottomUp,
+			m_config->pitch, m_config->offset, m_config->frameBytes);
 	}
-	case FORMATS_P216:
-	case FORMATS_P210:
-	{
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		BYTE *pDatac = &pDataOrig[pitch*height];
 
-		drawIntinsityLayer16(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer16_interleaved(pDatac, (pitch+3) & ~3, height, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, false);
-		break;
-	}
-	case FORMATS_Y31016:
 	{
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		int pitch2 = ((pitch+3) >> 2)*2;
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch2*height];
-
-		drawIntinsityLayer16(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer16(pDatau, pDatav, pitch2, height, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1);
-		break;
-	}
-	case FORMATS_P016:
-	case FORMATS_P010:
-	{
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		int height2 = (height+1) >> 1;
-		BYTE *pDatac = &pDataOrig[pitch*height];
 
-		drawIntinsityLayer16(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer16_interleaved(pDatac, (pitch+3) & ~3, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, false);
-		break;
-	}
-	case FORMATS_Y31116:
-	{
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		int height2 = (height+1) >> 1;
-		int pitch2 = ((pitch+3) >> 2)*2;
-		BYTE *pDatau = &pDataOrig[pitch*height];
-		BYTE *pDatav = &pDatau[pitch2*height2];
-
-		drawIntinsityLayer16(pData, pitch, height, width1, width2, width3, width);
-		drawColorLayer16(pDatau, pDatav, pitch2, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1);
-		break;
-	}
-	case FORMATS_Y16:
-	case FORMATS_Y16_F:
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		draw_16bit(&pData[0], pitch, width, height, 0x00, 0x01, 65536);
-		break;
-	case FORMATS_b16g:
-		info.drawCharFunc = drawChar16; info.bytes = 2;
-		draw_16bit_swap(&pData[0], pitch, width, height, 0x00, 0x01, 65536);
-		break;
-	case FORMATS_Y416:
-		// ayuv to avyu
-		info.drawCharFunc = drawChar64; info.bytes = 8;
-		info.add = 0xFFFF800000008000; info.mask = 0x00000000FFFF0000;
-		draw_64bit(&pData[0], pitch, width1, height, 0xFFFF800080000000, 0x0000000000000001, 65536);
-		draw_64bit(&pData[width1*8], pitch, width2-width1, height, 0xFFFF000080000000, 0x0000000100000001, 65536);
-		draw_64bit(&pData[width2*8], pitch, width3-width2, height, 0xFFFF000080008000, 0x0000000100000000, 65536);
-		draw_64bit(&pData[width3*8], pitch, width-width3, height, 0x0000800000008000, 0x0001000000010000, 65536);
-		break;
-	case FORMATS_Y410:
-	case FORMATS_v410:
-	{
-		info.drawCharFunc = drawChar32; info.bytes = 4;
-		unsigned int rot=0;
-		switch(format)
-		{
-		case FORMATS_v410: rot=2;
-		}
-		info.add = _lrotl(0x20000200, rot); info.mask = _lrotl(0xC00FFC00, rot);
-		draw_32bit(&pData[0], pitch, width1, height, _lrotl(0xE0080000, rot), _lrotl(0x00000001, rot), 1024);
-		draw_32bit(&pData[width1*4], pitch, width2-width1, height, _lrotl(0xC0080000, rot), _lrotl(0x00100001, rot), 1024);
-		draw_32bit(&pData[width2*4], pitch, width3-width2, height, _lrotl(0xC0080200, rot), _lrotl(0x00100000, rot), 1024);
-		draw_32bit(&pData[width3*4], pitch, width-width3, height, _lrotl(0xA0000200, rot), 0x40000400 << rot, 1024);
-		break;
-	}
-	case FORMATS_Y216:
-	case FORMATS_Y210:
-		info.drawCharFunc = drawChar32; info.bytes = 4;
-		info.add = 0x8000000080000000; info.mask = 0x0000FFFF0000FFFF;
-		draw_64bit(&pData[0], pitch, width1 >> 1, height, 0x8000800000008000, 0x0000000000010000, 65536);
-		draw_64bit(&pData[(width1 & ~1)*4], pitch, (width2 >> 1) - (width1 >> 1), height, 0x0000800000008000, 0x0001000000010000, 65536);
-		draw_64bit(&pData[(width2 & ~1)*4], pitch, (width3 >> 1) - (width2 >> 1), height, 0x0000800080008000, 0x0001000000000000, 65536);
-		draw_64bit(&pData[(width3 & ~1)*4], pitch, (width  >> 1) - (width3 >> 1), height, 0x8000000080000000, 0x0000000100000001, 65536);
-		break;
-	case FORMATS_Y411:
-		info.drawCharFunc = drawChar_Y411; info.bytes = 0;
-		info.add = 0; info.mask = 255;
-		draw_48bit(&pData[0], pitch, width1 >> 2, height, (0x000001000000 + 0x010100010100) * 128, 0x000000000001, 256);
-		draw_48bit(&pData[(width1 >> 2)*6], pitch, (width2 >> 2) - (width1 >> 2), height, (0x010100010100) * 128, 0x000000000001 + 0x000001000000, 256);
-		draw_48bit(&pData[(width2 >> 2)*6], pitch, (width3 >> 2) - (width2 >> 2), height, (0x000000000001 + 0x010100010100) * 128, 0x000001000000, 256);
-		draw_48bit(&pData[(width3 >> 2)*6], pitch, (width  >> 2) - (width3 >> 2), height, (0x000000000001 + 0x000001000000LL) * 128, 0x010100010100, 256);
-		break;
-	case FORMATS_Y41P:
-		info.drawCharFunc = drawChar_Y41P; info.bytes = 0;
-		info.add = 0; info.mask = 255;
-		draw_Y41P(pData, pitch, 0,      width1, height, (0x00010000 + 0x01000100) * 128, 0x00000001, 256);
-		draw_Y41P(pData, pitch, width1, width2, height, (0x01000100) * 128, 0x00000001 + 0x00010000, 256);
-		draw_Y41P(pData, pitch, width2, width3, height, (0x00000001 + 0x01000100) * 128, 0x00010000, 256);
-		draw_Y41P(pData, pitch, width3, width,  height, (0x00000001 + 0x00010000) * 128, 0x01000100, 256);
-		break;
-	case FORMATS_IY41:
-		{
-		info.drawCharFunc = drawChar_Y41P; info.bytes = 0;
-		info.add = 0; info.mask = 255;
-		BYTE *pData2 = &pData[((height+1) >> 1)*pitch];
-		info.ptr_offset = (intptr_t)pData2 - (intptr_t)pData;
-		draw_Y41P(pData, pitch, 0,      width1, height, (0x00010000 + 0x01000100) * 128, 0x00000001, 256, pData2);
-		draw_Y41P(pData, pitch, width1, width2, height, (0x01000100) * 128, 0x00000001 + 0x00010000, 256, pData2);
-		draw_Y41P(pData, pitch, width2, width3, height, (0x00000001 + 0x01000100) * 128, 0x00010000, 256, pData2);
-		draw_Y41P(pData, pitch, width3, width,  height, (0x00000001 + 0x00010000) * 128, 0x01000100, 256, pData2);
-		}
-		break;
-	case FORMATS_CLJR:
-		info.drawCharFunc = drawChar_CLJR; info.bytes = 0;
-		info.add = 0; info.mask = -1;
-		draw_32bit_swap(&pData[0], pitch, width1 >> 2, height, 0x00000001 * 32 + 0x08421000 * 16, 0x00000040, 64);
-		draw_32bit_swap(&pData[(width1 & ~3)], pitch, (width2 >> 2) - (width1 >> 2), height, 0x08421000 * 16, 0x00000040 + 0x00000001, 64);
-		draw_32bit_swap(&pData[(width2 & ~3)], pitch, (width3 >> 2) - (width2 >> 2), height, 0x00000040 * 32 + 0x08421000 * 16, 0x00000001, 64);
-		draw_32bit_swap(&pData[(width3 & ~3)], pitch, (width  >> 2) - (width3 >> 2), height, (0x00000040 + 0x00000001) * 32, 0x08421000, 32);
-		break;
-	default:
-		draw_8bit(&pData[0], pitch, width, height, 0x00, 0x01, 256);
-	}
+	if(!m_config)
+		return E_INVALIDARG;
 
+	if(pms->SetActualDataLength(m_config->frameBytes) != S_OK)
+		return 0;
 
-	if(width > 56 && height > 8)
+	framecount++;
+	if(repeat && m_renderer.canRepeat(pData))
 	{
-		DWORD text_x = framecount % (((DWORD)width - 56) * 2);
-		if(text_x > (DWORD)width - 56) text_x = (width - 56)*2 - text_x;
-		info.x = text_x;
-		DWORD text_y = framecount % (((DWORD)height - 8) * 2);
-		if(text_y > (DWORD)height - 8) text_y = (height - 8)*2 - text_y;
-
-		if(info.ptr_offset)
-		{
-			if(text_y & 1)
-			{	pData += info.ptr_offset;
-				info.ptr_offset = -info.ptr_offset;
-			}
-			text_y >>= 1;
-		}
-		char *textOut = (char*)&pData[(int)text_y * (int)pitch + (int)text_x*info.bytes];
-		drawText(info, textOut, our_format_to_text(format));
+		WaitForSingleObject(lateMutex, INFINITE);
+		m_late.repeated();
+		ReleaseMutex(lateMutex);
 	}
+	else
+		m_renderer.render(pData, framecount);
 
+	REFERENCE_TIME rtStart, rtStop;
+	nextSampleTimes(rtStart, rtStop);
+	pms->SetTime(&rtStart, &rtStop);
 
+	// media times are frame numbers
+	LONGLONG mediaStart = m_mediaFrame;
+	m_mediaFrame++;
+	pms->SetMediaTime(&mediaStart, &m_mediaFrame);
 
-	// The current time is the sample's start
-	REFERENCE_TIME rtStart = m_rtSampleTime;
-
-	// Increment to find the finish time
-	m_rtSampleTime += (LONG)m_iRepeatTime;
-
-	pms->SetTime(&rtStart, &m_rtSampleTime);
+	if(m_ring.isOpen())
+		writeRing(rtStart, rtStop, mediaStart);
 	}
 
 	pms->SetSyncPoint(TRUE);
+	pms->SetDiscontinuity(m_discontinuity);
+	m_discontinuity = false;
 	return NOERROR;
 
 }
@@ -1370,28 +587,13 @@ STDMETHODIMP_(ULONG) COutputPin1::Release() {ULONG ref = InterlockedDecrement(&r
 STDMETHODIMP COutputPin1::Notify(IBaseFilter * pSender, Quality q)
 {
 	debuglog("outputpin1 Notify");
-	// Adjust the repeat rate.
-	if(q.Proportion<=0)
-	{
-		m_iRepeatTime = 1000;		// We don't go slower than 1 per second
-	}
-	else
-	{
-		m_iRepeatTime = m_iRepeatTime*1000 / q.Proportion;
-		if(m_iRepeatTime>1000)
-		{
-			m_iRepeatTime = 1000;	// We don't go slower than 1 per second
-		}
-		else if(m_iRepeatTime<0)
-		{
-			m_iRepeatTime = 0;
-		}
-	}
-
-	// skip forwards
-	if(q.Late > 0)
-		m_rtSampleTime += q.Late;
-
+	LONGLONG late = q.Late / 10;
+	m_trace.record(TRACE_NOTIFY, TRACE_DOWNSTREAM, q.Proportion,
+		late > MAXLONG ? MAXLONG : late < -MAXLONG ? -MAXLONG : (LONG)late);
+	// the streaming thread acts on it with the next frame it draws
+	WaitForSingleObject(lateMutex, INFINITE);
+	m_late.notify(q.Late, q.Proportion, q.TimeStamp);
+	ReleaseMutex(lateMutex);
 	return NOERROR;
 }
 STDMETHODIMP COutputPin1::SetSink(IQualityControl * piqc)
@@ -1425,8 +627,9 @@ STDMETHODIMP COutputPin1::getAllocatorFromPin(IPin *pPin)
 		prop.cbAlign = 1;
 	if(pinMemIn->GetAllocator(&memAlloc) != S_OK)
 	{
-		memAlloc = new DShowMemAllocator();
-		//return VFW_E_NO_TRANSPORT;
+		DShowMemAllocator *ownAlloc = new DShowMemAllocator();
+		ownAlloc->useLargePages(m_largePages != 0);
+		memAlloc = ownAlloc;
 	}
 	if(DecideBufferSize(memAlloc, &prop) == S_OK)
 		if(pinMemIn->NotifyAllocator(memAlloc, FALSE) == S_OK)
@@ -1464,6 +667,7 @@ STDMETHODIMP COutputPin1::Connect(IPin *pReceivePin, const AM_MEDIA_TYPE *pmt)
 		while(h != S_OK && i < FORMATS_COUNT)
 		{
 			pmtIndex = 0;
+			FreeMediaType(m_mt);
 			if(GetMediaType(i, &m_mt) != S_OK)
 				break;
 			h = Connect_part2(pReceivePin, &m_mt);
@@ -1476,6 +680,7 @@ STDMETHODIMP COutputPin1::Connect(IPin *pReceivePin, const AM_MEDIA_TYPE *pmt)
 	{
 		connectedPin = pReceivePin;
 		pReceivePin->AddRef();
+		SetMediaType(&m_mt);
 	}
 	ReleaseMutex(mutex);
 	return h;
@@ -1595,10 +800,7 @@ STDMETHODIMP COutputPin1::QueryAccept(const AM_MEDIA_TYPE *pmt)
 		return S_FALSE;
 
 	if(connectedPin)
-	{
-		FreeMediaType(m_mt);
-		CopyMediaType(&m_mt, pmt);
-	}
+		SetMediaType(pmt);
 
 	return S_OK;
 }
@@ -1632,40 +834,16 @@ STDMETHODIMP COutputPin1::NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop
 
 
 
-// GetMediaType ... list all the colorspaces this output pin support
-
-HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
+// Fills in the media type for one format, pvi is its format block
+static void buildMediaType(OUR_FORMATS format, int width, int height, LONGLONG frametime, AM_MEDIA_TYPE *pmt, VIDEOINFO *pvi)
 {
-	debuglog("outputpin1 GetMediaType");
-	//CheckPointer(pmt,E_POINTER);
-
 	ZeroMemory(pmt, sizeof(AM_MEDIA_TYPE));
-
-	if(iPosition < 0)
-	{
-		return E_INVALIDARG;
-	}
-
-	// Have we run off the end of types?
-
-	if(iPosition >= FORMATS_COUNT)
-	{
-		return VFW_S_NO_MORE_ITEMS;
-	}
-
-	if(iPosition == 0)
-		iPosition = m_preferredFormat;
-	else if(iPosition <= m_preferredFormat)
-		iPosition--;
-
-
-	VIDEOINFO *pvi = (VIDEOINFO *) AllocFormatBuffer(pmt, sizeof(VIDEOINFO));
-	if(NULL == pvi)
-		return(E_OUTOFMEMORY);
-
 	ZeroMemory(pvi, sizeof(VIDEOINFO));
+	pmt->cbFormat = sizeof(VIDEOINFO);
+	pmt->pbFormat = (BYTE*)pvi;
+	pvi->bmiHeader.biBitCount = formatSubtype[format].bitCount;
 
-	switch(iPosition)
+	switch(format)
 	{
 		case FORMATS_ARGB32:
 			// Return our highest quality 32bit format
@@ -1675,7 +853,6 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 			// masks. Also, not everything supports BI_BITFIELDS
 
 			pvi->bmiHeader.biCompression = BI_RGB;
-			pvi->bmiHeader.biBitCount	= 32;
 			pmt->subtype = MEDIASUBTYPE_ARGB32;
 			break;
 		//case FORMATS_r210:
@@ -1685,12 +862,10 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 			// byte 3: b7b6b5b4b3b2b1b0
  		case FORMATS_RGB32:
 			pvi->bmiHeader.biCompression = BI_RGB;
-			pvi->bmiHeader.biBitCount	= 32;
 			pmt->subtype = MEDIASUBTYPE_RGB32;
 			break;
 		case FORMATS_RGB24:
 			pvi->bmiHeader.biCompression = BI_RGB;
-			pvi->bmiHeader.biBitCount	= 24;
 			pmt->subtype = MEDIASUBTYPE_RGB24;
 			break;
 		case FORMATS_RGB16_565:
@@ -1700,7 +875,6 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 			pvi->TrueColorInfo.dwBitMasks[3] = 0;
 
 			pvi->bmiHeader.biCompression = BI_BITFIELDS;
-			pvi->bmiHeader.biBitCount	= 16;
 			pmt->subtype = MEDIASUBTYPE_RGB565;
 			break;
 		case FORMATS_RGB16_555:
@@ -1710,7 +884,6 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 			pvi->TrueColorInfo.dwBitMasks[1] = 0x03E0; // green
 			pvi->TrueColorInfo.dwBitMasks[2] = 0x001F; // blue
 			pvi->TrueColorInfo.dwBitMasks[3] = 0;
-			pvi->bmiHeader.biBitCount	= 16;
 			pmt->subtype = MEDIASUBTYPE_RGB555;
 			break;
 		case FORMATS_ARGB16_1555:
@@ -1719,7 +892,6 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 			pvi->TrueColorInfo.dwBitMasks[2] = 0x001F; // blue
 			pvi->TrueColorInfo.dwBitMasks[3] = 0x8000; // alpha
 			pvi->bmiHeader.biCompression = BI_BITFIELDS;
-			pvi->bmiHeader.biBitCount	= 16;
 			pmt->subtype = MEDIASUBTYPE_ARGB1555;
 			break;
 		case FORMATS_ARGB16_4444:
@@ -1728,13 +900,11 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 			pvi->TrueColorInfo.dwBitMasks[2] = 0x000F; // blue
 			pvi->TrueColorInfo.dwBitMasks[3] = 0xF000; // alpha
 			pvi->bmiHeader.biCompression = BI_BITFIELDS;
-			pvi->bmiHeader.biBitCount	= 16;
 			pmt->subtype = MEDIASUBTYPE_ARGB4444;
 			break;
 		case FORMATS_RGB8:
 		{
 			pvi->bmiHeader.biCompression = BI_RGB;
-			pvi->bmiHeader.biBitCount	= 8;
 			pvi->bmiHeader.biClrUsed		= iPALETTE_COLORS;
 			pmt->subtype = MEDIASUBTYPE_RGB8;
 			for(unsigned int i = 0; i < 64; i++)
@@ -1752,7 +922,6 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 			pvi->TrueColorInfo.dwBitMasks[2] = 0x000003FF; // blue
 			pvi->TrueColorInfo.dwBitMasks[3] = 0xC0000000; // alpha
 			pvi->bmiHeader.biCompression = BI_BITFIELDS;
-			pvi->bmiHeader.biBitCount	= 32;
 			pmt->subtype = MEDIASUBTYPE_A2R10G10B10;
 			break;
 		case FORMATS_A2BGR32:
@@ -1761,25 +930,23 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 			pvi->TrueColorInfo.dwBitMasks[2] = 0x3FF00000; // blue
 			pvi->TrueColorInfo.dwBitMasks[3] = 0xC0000000; // alpha
 			pvi->bmiHeader.biCompression = BI_BITFIELDS;
-			pvi->bmiHeader.biBitCount	= 32;
 			pmt->subtype = MEDIASUBTYPE_A2B10G10R10;
 			break;
 		default:
 		{
-			pvi->bmiHeader.biBitCount = 0;
-			Set_guid_using_format((OUR_FORMATS)iPosition, pmt->subtype);
+			Set_guid_using_format(format, pmt->subtype);
 			pvi->bmiHeader.biCompression = pmt->subtype.Data1;
 		}
 	}
 
 
 	pvi->bmiHeader.biSize	= sizeof(BITMAPINFOHEADER);
-	pvi->bmiHeader.biWidth	= m_iImageWidth;
-	pvi->bmiHeader.biHeight	= abs(m_iImageHeight);
+	pvi->bmiHeader.biWidth	= width;
+	pvi->bmiHeader.biHeight	= height;
 	pvi->bmiHeader.biPlanes	= 1;
-	pvi->bmiHeader.biSizeImage  = getImageSize((OUR_FORMATS)iPosition, m_iImageWidth, abs(m_iImageHeight));
+	pvi->bmiHeader.biSizeImage  = getImageSize(format, width, height);
 	pvi->bmiHeader.biClrImportant = 0;
-	pvi->AvgTimePerFrame = m_frametime; //pvi->AvgTimePerFrame = 10000000 / 20;
+	pvi->AvgTimePerFrame = frametime;
 
 	SetRectEmpty(&(pvi->rcSource)); // we want the whole image area rendered.
 	SetRectEmpty(&(pvi->rcTarget)); // no particular destination rectangle
@@ -1787,17 +954,70 @@ HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
 	pmt->majortype = MEDIATYPE_Video;
 	pmt->formattype = FORMAT_VideoInfo;
 	pmt->bTemporalCompression = FALSE;
-
-	//const GUID SubTypeGUID = GetBitmapSubtype(&pvi->bmiHeader);
-	//pmt->subtype = (&SubTypeGUID);
 	pmt->bFixedSizeSamples = true;
 	pmt->lSampleSize = pvi->bmiHeader.biSizeImage;
+}
 
-	if(CheckMediaType(pmt) != S_OK)
-		DebugBreak(); // shouldn't happen
+// Builds the list again when the frame size or rate has changed since.
+// Called holding typesMutex.
+void COutputPin1::updateMediaTypes()
+{
+	int width = m_iImageWidth;
+	int height = abs(m_iImageHeight);
+	if(m_types && m_types->width == width && m_types->height == height && m_types->frametime == m_frametime)
+		return;
 
-	return NOERROR;
+	MediaTypeList *types = new MediaTypeList;
+	types->width = width;
+	types->height = height;
+	types->frametime = m_frametime;
+	for(int i=0; i<FORMATS_COUNT; i++)
+	{
+		buildMediaType((OUR_FORMATS)i, width, height, m_frametime, &types->types[i], &types->formats[i]);
+		if(CheckMediaType(&types->types[i]) != S_OK)
+			DebugBreak(); // shouldn't happen
+	}
+	delete m_types;
+	m_types = types;
+}
 
+// A copy of the media type for format, with its own format block
+HRESULT COutputPin1::copyMediaType(OUR_FORMATS format, AM_MEDIA_TYPE *pmt)
+{
+	WaitForSingleObject(typesMutex, INFINITE);
+	updateMediaTypes();
+	HRESULT hr = CopyMediaType(pmt, &m_types->types[format]);
+	ReleaseMutex(typesMutex);
+	return hr;
+}
+
+// GetMediaType ... list all the colorspaces this output pin support
+
+HRESULT COutputPin1::GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt)
+{
+	debuglog("outputpin1 GetMediaType");
+	//CheckPointer(pmt,E_POINTER);
+
+	ZeroMemory(pmt, sizeof(AM_MEDIA_TYPE));
+
+	if(iPosition < 0)
+	{
+		return E_INVALIDARG;
+	}
+
+	// Have we run off the end of types?
+
+	if(iPosition >= FORMATS_COUNT)
+	{
+		return VFW_S_NO_MORE_ITEMS;
+	}
+
+	if(iPosition == 0)
+		iPosition = m_preferredFormat;
+	else if(iPosition <= m_preferredFormat)
+		iPosition--;
+
+	return copyMediaType((OUR_FORMATS)iPosition, pmt);
 }
 
 
@@ -1838,6 +1058,13 @@ HRESULT COutputPin1::CheckMediaType(const AM_MEDIA_TYPE *pMediaType)
 		return E_INVALIDARG;
 	}
 
+	// a renderer or encoder can have the picture drawn straight into a
+	// wider surface of its own, or a rectangle of one
+	RECT target;
+	DWORD offset;
+	if(!GetVideoTarget(pMediaType, format, target, offset))
+		return E_INVALIDARG;
+
 	//if(pvi->bmiHeader.biWidth < m_Ball->GetImageWidth() || 
 	//abs(pvi->bmiHeader.biHeight) != m_Ball->GetImageHeight())
 	//	return E_INVALIDARG;
@@ -1859,8 +1086,17 @@ HRESULT COutputPin1::DecideBufferSize(IMemAllocator *pAlloc,
 	HRESULT hr = NOERROR;
 
 	VIDEOINFO *pvi = (VIDEOINFO *) m_mt.pbFormat;
-	pProperties->cBuffers = 1;
+	// room for the frames drawn ahead and the one downstream is showing
+	if(pProperties->cBuffers < (long)m_buffers)
+		pProperties->cBuffers = m_buffers;
+	if(pProperties->cBuffers < 1)
+		pProperties->cBuffers = 1;
 	pProperties->cbBuffer = pvi->bmiHeader.biSizeImage;
+	// biSizeImage can be 0 for RGB, and short of a padded surface
+	WaitForSingleObject(configMutex, INFINITE);
+	if(m_nextConfig && (long)m_nextConfig->frameBytes > pProperties->cbBuffer)
+		pProperties->cbBuffer = m_nextConfig->frameBytes;
+	ReleaseMutex(configMutex);
 
 	assert(pProperties->cbBuffer);
 
@@ -1892,9 +1128,13 @@ HRESULT COutputPin1::SetMediaType(const AM_MEDIA_TYPE *pMediaType)
 	if(CheckMediaType(pMediaType) != S_OK)
 		return VFW_E_TYPE_NOT_ACCEPTED;
 
-	// Pass the call up to my base class
-
-	HRESULT hr = CopyMediaType(&m_mt, pMediaType);
+	// Connect sets m_mt itself and passes it here
+	HRESULT hr = S_OK;
+	if(pMediaType != &m_mt)
+	{
+		FreeMediaType(m_mt);
+		hr = CopyMediaType(&m_mt, pMediaType);
+	}
 
 	if(SUCCEEDED(hr))
 	{
@@ -1905,14 +1145,16 @@ HRESULT COutputPin1::SetMediaType(const AM_MEDIA_TYPE *pMediaType)
 		//if(m_frametime != 0)
 			//pvi->AvgTimePerFrame = m_frametime;
 
-		OUR_FORMATS format = Guid_to_our_format(&(pMediaType->subtype));
-		int pitchbytes = pvi->bmiHeader.biBitCount >> 3;
-
-			//hr = E_OUTOFMEMORY;
-		m_iImageWidth = pvi->bmiHeader.biWidth;
-		m_iImageHeight = pvi->bmiHeader.biHeight;
-		m_iImagePitch = getPitch(format, m_iImageWidth);
+		// the picture is the target, biWidth can be downstream's padding
+		OUR_FORMATS format = Guid_to_our_format(&m_mt.subtype);
+		RECT target;
+		DWORD offset;
+		GetVideoTarget(&m_mt, format, target, offset);
+		m_iImageWidth = target.right - target.left;
+		m_iImageHeight = pvi->bmiHeader.biHeight < 0 ? target.top - target.bottom : target.bottom - target.top;
+		m_iImagePitch = getPitch(format, pvi->bmiHeader.biWidth);
 		m_frametime = pvi->AvgTimePerFrame;
+		selectConfig(&m_mt);
 
 		return NOERROR;
 	} 
@@ -1921,55 +1163,497 @@ HRESULT COutputPin1::SetMediaType(const AM_MEDIA_TYPE *pMediaType)
 
 }
 
+// Finds the type among the ones set lately, or works it out over the
+// oldest the worker is not using, and leaves it for FillBuffer
+void COutputPin1::selectConfig(const AM_MEDIA_TYPE *pmt)
+{
+	const BITMAPINFOHEADER *bmi = GetVideoBMIHeader(pmt);
+	OUR_FORMATS format = Guid_to_our_format(&pmt->subtype);
+	RECT target;
+	DWORD offset = 0;
+	GetVideoTarget(pmt, format, target, offset);
+	WaitForSingleObject(configMutex, INFINITE);
+	RenderConfig *config = NULL;
+	for(unsigned int i=0; i<m_configCount && !config; i++)
+	{
+		RenderConfig &c = m_configs[i];
+		if(c.subtype == pmt->subtype && c.width == bmi->biWidth && c.height == bmi->biHeight &&
+			c.compression == bmi->biCompression && EqualRect(&c.target, &target))
+			config = &c;
+	}
+	if(!config)
+	{
+		if(m_configCount < RENDER_CONFIGS)
+			config = &m_configs[m_configCount++];
+		else
+		{
+			do
+			{
+				config = &m_configs[m_configReuse];
+				m_configReuse = (m_configReuse + 1) % RENDER_CONFIGS;
+			} while(config == m_config || config == m_nextConfig);
+		}
+		config->subtype = pmt->subtype;
+		config->width = bmi->biWidth;
+		config->height = bmi->biHeight;
+		config->compression = bmi->biCompression;
+		config->bitCount = bmi->biBitCount;
+		config->format = format;
+		config->target = target;
+		config->pitch = getPitch(format, abs(config->width));
+		config->offset = offset;
+		config->frameBytes = getImageHeightSize(format, config->pitch, abs(config->height));
+		config->bottomUp = config->height > 0 && config->compression <= BI_BITFIELDS;
+	}
+	m_nextConfig = config;
+	ReleaseMutex(configMutex);
+}
+
+static void readSetting(IPropertyBag *pPropBag, IErrorLog *pErrorLog, LPCOLESTR name, DWORD &value)
+{
+	VARIANT var;
+	VariantInit(&var);
+	var.vt = VT_I4;
+	if(pPropBag->Read(name, &var, pErrorLog) == S_OK && var.vt == VT_I4)
+		value = var.lVal;
+	VariantClear(&var);
+}
+
+void COutputPin1::loadSettings(IPropertyBag *pPropBag, IErrorLog *pErrorLog)
+{
+	readSetting(pPropBag, pErrorLog, L"StreamingThreshold", m_streamingThreshold);
+	readSetting(pPropBag, pErrorLog, L"RenderThreads", m_renderThreads);
+	readSetting(pPropBag, pErrorLog, L"StripeHeight", m_stripeHeight);
+	readSetting(pPropBag, pErrorLog, L"Buffers", m_buffers);
+	readSetting(pPropBag, pErrorLog, L"RenderAhead", m_renderAhead);
+	readSetting(pPropBag, pErrorLog, L"SpinTime", m_spinTime);
+	readSetting(pPropBag, pErrorLog, L"LatePolicy", m_latePolicy);
+	readSetting(pPropBag, pErrorLog, L"Unthrottled", m_unthrottled);
+	readSetting(pPropBag, pErrorLog, L"TraceEvents", m_traceEvents);
+	readSetting(pPropBag, pErrorLog, L"LargePages", m_largePages);
+	readSetting(pPropBag, pErrorLog, L"SharedRing", m_sharedRing);
+	if(m_sharedRing > FRAME_RING_MAX_SLOTS)
+		m_sharedRing = FRAME_RING_MAX_SLOTS;
+}
+
+// Sample times count whole frames since the frame time last changed,
+// so they never pick up rounding however long the stream runs
+void COutputPin1::nextSampleTimes(REFERENCE_TIME &rtStart, REFERENCE_TIME &rtStop)
+{
+	if(m_rtSampleStep != m_rtRepeatTime)
+	{
+		m_rtSampleTime += framesToTime(m_sampleFrame, m_rtSampleStep);
+		m_rtSampleStep = m_rtRepeatTime;
+		m_sampleFrame = 0;
+	}
+	rtStart = m_rtSampleTime + framesToTime(m_sampleFrame, m_rtSampleStep);
+	m_sampleFrame++;
+	rtStop = m_rtSampleTime + framesToTime(m_sampleFrame, m_rtSampleStep);
+}
+
+// Draws the next frame into a free buffer and queues it for the delivery
+// thread, waiting for a buffer and for room in the queue.  Returns S_FALSE
+// when the graph changes state while waiting for room.
 HRESULT COutputPin1::renderOneFrame()
 {
 	IMediaSample *sample = NULL;
+	long long start = m_counter.now();
+	m_trace.record(TRACE_BUFFER_WAIT, TRACE_WORKER, (LONG)m_mediaFrame, 0);
 	HRESULT h = memAlloc->GetBuffer(&sample, NULL, NULL, 0);
-	if(sample && h >= 0)
+	long long got = m_counter.now();
+	m_trace.record(TRACE_BUFFER_ACQUIRE, TRACE_WORKER, (LONG)m_mediaFrame, h);
+	m_throughput.bufferWait += got - start;
+	if(FAILED(h))
+		return h;
+	if(!sample)
+		return E_FAIL;
+	m_stages[STATS_PROPERTY_GETBUFFER - STATS_PROPERTY_GETBUFFER].record(got - start);
+
+	// frames too late to be worth sending are counted off here, the
+	// sample and media times and the frame count still move past them
+	LATE_ACTION action;
+	WaitForSingleObject(lateMutex, INFINITE);
+	if(m_late.mode() == LATE_SLOW)
+		m_rtRepeatTime = m_late.frameTime();
+	for(;;)
+	{
+		// the same before and after nextSampleTimes takes up a new frame time
+		REFERENCE_TIME rtStart = m_rtSampleTime + framesToTime(m_sampleFrame, m_rtSampleStep);
+		action = m_late.decide(rtStart, m_scheduler.streamTime());
+		if(action != FRAME_SKIP)
+			break;
+		m_trace.record(TRACE_FRAME_DROP, TRACE_WORKER, (LONG)m_mediaFrame, 0);
+		REFERENCE_TIME rtStop;
+		nextSampleTimes(rtStart, rtStop);
+		m_mediaFrame++;
+		framecount++;
+		m_discontinuity = true;
+	}
+	ReleaseMutex(lateMutex);
+
+	m_trace.record(TRACE_FRAME_START, TRACE_WORKER, (LONG)m_mediaFrame, 0);
+	h = FillBuffer(sample, action == FRAME_REPEAT);
+	long long drawn = m_counter.now();
+	m_trace.record(TRACE_FRAME_END, TRACE_WORKER, (LONG)m_mediaFrame - 1, action == FRAME_REPEAT ? 0 : m_renderer.frameBytes());
+	m_throughput.drawn++;
+	m_throughput.renderSum += drawn - got;
+	if(drawn - got > m_throughput.renderMax)
+		m_throughput.renderMax = drawn - got;
+	if(FAILED(h))
+	{
+		sample->Release();
+		return h;
+	}
+	m_stages[STATS_PROPERTY_FILLBUFFER - STATS_PROPERTY_GETBUFFER].record(drawn - got);
+	m_bytesDrawn.add(m_renderer.frameBytes());
+	// the delivery thread takes over the reference
+	while(!m_queue.push(sample, m_pacedRequest, threadEvent))
+	{
+		if(m_request != m_pacedRequest)
+		{
+			sample->Release();
+			return S_FALSE;
+		}
+	}
+	m_throughput.queueWait += m_counter.now() - drawn;
+	m_trace.record(TRACE_QUEUED, TRACE_WORKER, (LONG)m_mediaFrame - 1, m_queue.count());
+	return S_OK;
+}
+
+// Sends queued frames when they are due.  A Receive that blocks only holds
+// up this thread, the worker carries on drawing until the queue is full.
+DWORD COutputPin1::deliverThread()
+{
+	long long lastStart = 0;
+	LONG lastTag = m_request - 1;
+	for(;;)
 	{
-		FillBuffer(sample);
-		connectedMemInputPin->Receive(sample);
-		memAlloc->ReleaseBuffer(sample);
-		//sample->Release();  // program crash when using both ReleaseBuffer and Release
+		LONG request = m_request;
+		if(request != m_delivered)
+		{
+			// nothing drawn before the change is sent from here on
+			m_delivered = request;
+			SetEvent(deliverActedEvent);
+		}
+		if(m_state == STREAM_EXIT && !m_queue.count())
+			break;
+
+		void *item;
+		LONG tag;
+		if(!m_queue.pop(&item, &tag, deliverEvent))
+			continue;
+		IMediaSample *sample = (IMediaSample *)item;
+		LONGLONG mediaStart = 0, mediaStop;
+		sample->GetMediaTime(&mediaStart, &mediaStop);
+		LONG frame = (LONG)mediaStart;
+		// drawn for a state the graph has left
+		if(tag != m_request)
+		{
+			sample->Release();
+			m_trace.record(TRACE_BUFFER_RELEASE, TRACE_DELIVERY, frame, 1);
+			continue;
+		}
+		// out when the clock reaches the sample's start time, or straight
+		// away when unthrottled
+		REFERENCE_TIME rtStart, rtStop;
+		if(!m_stress && SUCCEEDED(sample->GetTime(&rtStart, &rtStop)))
+		{
+			long long late = m_scheduler.wait(rtStart);
+			// the graph changed state, the frame is restamped or dropped
+			if(late < 0)
+			{
+				sample->Release();
+				m_trace.record(TRACE_BUFFER_RELEASE, TRACE_DELIVERY, frame, 1);
+				continue;
+			}
+			WaitForSingleObject(lateMutex, INFINITE);
+			m_late.sent(late);
+			ReleaseMutex(lateMutex);
+			m_stages[STATS_PROPERTY_SCHEDULE_ERROR - STATS_PROPERTY_GETBUFFER].record(late);
+		}
+		long long start = m_counter.now();
+		m_trace.record(TRACE_DELIVER_START, TRACE_DELIVERY, frame, 0);
+		HRESULT h = connectedMemInputPin->Receive(sample);
+		long long end = m_counter.now();
+		m_trace.record(TRACE_DELIVER_END, TRACE_DELIVERY, frame, h);
+		m_stages[STATS_PROPERTY_RECEIVE - STATS_PROPERTY_GETBUFFER].record(end - start);
+		// intervals across a change of state are the pause, not the pacing
+		if(tag == lastTag)
+			m_stages[STATS_PROPERTY_INTERVAL - STATS_PROPERTY_GETBUFFER].record(start - lastStart);
+		lastStart = start;
+		lastTag = tag;
+		// downstream holds its own reference if it keeps the sample
+		sample->Release();
+		m_trace.record(TRACE_BUFFER_RELEASE, TRACE_DELIVERY, frame, 0);
+
+		if(!m_throughput.frames)
+			m_throughput.first = start;
+		m_throughput.last = end;
+		m_throughput.frames++;
+		m_throughput.receiveSum += end - start;
 	}
-	return h;
+	return NOERROR;
 }
 
-DWORD COutputPin1::threadCreated1()
+void COutputPin1::waitDelivered(LONG request)
+{
+	while((LONG)(m_delivered - request) < 0)
+		WaitForSingleObject(deliverActedEvent, INFINITE);
+}
+
+// How closely frames went out on time, for the debugger output
+void COutputPin1::reportPacing()
+{
+	const SchedulerStats &s = m_scheduler.stats();
+	unsigned long long waited = s.frames - s.missed;
+	char text[320];
+	sprintf_s(text, sizeof(text), "outputpin1 pacing: %I64u frames, %I64u missed, %I64u resyncs, wake error mean %I64d us max %I64d us\n",
+		s.frames, s.missed, s.resyncs, waited ? s.errorSum / (long long)waited / 10 : 0, s.errorMax / 10);
+	OutputDebugStringA(text);
+
+	WaitForSingleObject(lateMutex, INFINITE);
+	LateStats l = m_late.stats();
+	REFERENCE_TIME frameTime = m_late.frameTime();
+	ReleaseMutex(lateMutex);
+	sprintf_s(text, sizeof(text), "outputpin1 late frames: %I64u late, %I64u dropped, %I64u repeated, %I64u notified, %I64u slowed, %I64u recovered, frame time %I64d us\n",
+		l.late, l.dropped, l.repeated, l.notified, l.slowed, l.recovered, frameTime / 10);
+	OutputDebugStringA(text);
+
+	const ThroughputStats &t = m_throughput;
+	long long seconds = t.last - t.first;
+	sprintf_s(text, sizeof(text), "outputpin1 throughput%s: %I64u frames at %.1f fps, drawing mean %I64d us max %I64d us, waited %I64d ms for buffers, %I64d ms for queue room, %I64d ms in Receive\n",
+		m_stress ? " unthrottled" : "", t.frames, seconds > 0 ? t.frames * 10000000.0 / seconds : 0.0,
+		t.drawn ? t.renderSum / (long long)t.drawn / 10 : 0, t.renderMax / 10,
+		t.bufferWait / 10000, t.queueWait / 10000, t.receiveSum / 10000);
+	OutputDebugStringA(text);
+
+	const FrameQueueStats &q = m_queue.stats();
+	sprintf_s(text, sizeof(text), "outputpin1 delivery queue: depth %u, high water %u, %I64u frames, %I64u waits for room, %I64u waits for frames\n",
+		m_queue.depth(), q.highWater, q.pushed, q.fullWaits, q.emptyWaits);
+	OutputDebugStringA(text);
+}
+
+// Lines the stream up with the clock.  While running with a graph clock the
+// next sample is stamped with the stream time now, as a capture card would,
+// otherwise the performance counter carries on from the last sample.
+void COutputPin1::startPacing(bool running)
+{
+	REFERENCE_TIME next = m_rtSampleTime + framesToTime(m_sampleFrame, m_rtSampleStep);
+	bool clocked = running && m_graphClock.clock();
+	m_scheduler.start(clocked ? &m_graphClock : NULL, (long long)m_spinTime * 10);
+	if(clocked)
+	{
+		next = m_scheduler.now() - m_tStart;
+		if(next < 0)
+			next = 0;
+		m_scheduler.setBase(m_tStart);
+	}
+	else
+		m_scheduler.setBase(m_scheduler.now() - next);
+	m_rtSampleTime = next;
+	m_sampleFrame = 0;
+	m_discontinuity = false;
+
+	WaitForSingleObject(lateMutex, INFINITE);
+	// unthrottled frames are all early, and are all to be sent
+	m_late.start(m_stress ? LATE_SEND : (LATE_MODE)m_latePolicy, m_rtDefaultRepeatTime);
+	ReleaseMutex(lateMutex);
+	m_rtRepeatTime = m_rtDefaultRepeatTime;
+}
+
+// From a stopped graph to a paused or running one
+void COutputPin1::startStreaming()
 {
-	//renderOneFrame();
+	m_renderer.setTuning(m_streamingThreshold, m_renderThreads, m_stripeHeight);
+	m_queue.setDepth(m_renderAhead);
+	m_stress = m_unthrottled != 0;
+	if(m_sharedRing)
+		openRing();
 	memAlloc->Commit();
-	while(!exitnow)
+	// the renderer follows the label in every buffer and slot, so each
+	// one coming round only has its label repainted
+	ALLOCATOR_PROPERTIES props;
+	unsigned int buffers = m_buffers;
+	if(memAlloc->GetProperties(&props) == S_OK && props.cBuffers > 0)
+		buffers = props.cBuffers;
+	if(m_ring.isOpen())
+		buffers += m_ring.header()->slotCount;
+	m_renderer.setBufferCount(buffers);
+	// a reconnect can keep the config while a new allocator hands out
+	// buffers at addresses the old one used, none of them hold the
+	// background yet
+	m_renderer.forgetBuffers();
+	// a live stream from stream time 0 at normal rate, with no end
+	connectedPin->NewSegment(0, MAX_TIME, 1.0);
+}
+
+// Keeps the ring from the last run when the frames still fit, so readers
+// carry on across a stop
+void COutputPin1::openRing()
+{
+	WaitForSingleObject(configMutex, INFINITE);
+	DWORD bytes = m_nextConfig ? m_nextConfig->frameBytes : 0;
+	ReleaseMutex(configMutex);
+	if(!bytes)
+		return;
+	const FrameRingHeader *header = m_ring.header();
+	if(header && header->slotCount == m_sharedRing && header->slotSize >= bytes)
+		return;
+	if(!m_ring.create(FRAME_RING_NAME, m_sharedRing, bytes))
+		debuglog("outputpin1 cannot make the shared ring");
+}
+
+// The renderer draws the frame again straight into the ring's next slot,
+// laid out as the sample with downstream's pitch and target, which the slot
+// header carries.  It has drawn the slot before, so only the label is
+// repainted.
+void COutputPin1::writeRing(REFERENCE_TIME rtStart, REFERENCE_TIME rtStop, LONGLONG frame)
+{
+	BYTE *data = m_ring.beginFrame(m_config->frameBytes);
+	if(!data)
+		return;
+	m_renderer.render(data, framecount);
+
+	FrameSlotHeader info;
+	info.format = m_config->format;
+	info.compression = m_config->compression;
+	info.bitCount = m_config->bitCount;
+	info.width = m_config->width;
+	info.height = m_config->height;
+	info.pitch = m_config->pitch;
+	info.size = m_config->frameBytes;
+	const RECT &target = m_config->target;
+	info.targetLeft = target.left;
+	info.targetTop = target.top;
+	info.targetWidth = target.right - target.left;
+	info.targetHeight = target.bottom - target.top;
+	info.offset = m_config->offset;
+	info.reserved = 0;
+	info.start = rtStart;
+	info.stop = rtStop;
+	info.frame = frame;
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	info.counter = now.QuadPart;
+	m_ring.publishFrame(info);
+}
+
+void COutputPin1::stopStreaming()
+{
+	reportPacing();
+	m_scheduler.stop();
+	memAlloc->Decommit();
+}
+
+// The worker lives as long as the pin, so a change of state costs the
+// worker noticing m_request at its next frame or wait, not a thread.
+DWORD COutputPin1::threadCreated1()
+{
+	LONG streaming = STREAM_STOPPED;
+	for(;;)
 	{
-		//Sleep(25);
-		if(render)
+		// m_request first, so m_state is at least as new as it
+		LONG request = m_request;
+		LONG state = m_state;
+		if(request != m_acted)
 		{
-			renderOneFrame();
-			int sleeptime = m_iRepeatTime;
-			if(sleeptime > 0 && sleeptime < 1000)
-				Sleep(sleeptime);
+			// frames queued for the old state are dropped, not sent, and
+			// the scheduler is free to start again
+			waitDelivered(request);
+			if(state == STREAM_PAUSED || state == STREAM_RUNNING)
+			{
+				if(streaming == STREAM_STOPPED)
+					startStreaming();
+				else
+					reportPacing();
+				// each frame goes out at its own time on the clock, frames
+				// after it are drawn ahead while waiting for it
+				startPacing(state == STREAM_RUNNING);
+				m_scheduler.watch(&m_request, request, deliverEvent);
+				m_queue.resetStats();
+				memset(&m_throughput, 0, sizeof(m_throughput));
+				m_pacedRequest = request;
+				streaming = state;
+			}
+			else if(streaming != STREAM_STOPPED)
+			{
+				stopStreaming();
+				streaming = STREAM_STOPPED;
+			}
+
+			long long took = m_counter.now() - m_requestTime;
+			m_transitions++;
+			m_transitionSum += took;
+			if(took > m_transitionMax)
+				m_transitionMax = took;
+			m_trace.record(TRACE_STATE_ACTED, TRACE_WORKER, request, state);
+			m_acted = request;
+			SetEvent(threadActedEvent);
 		}
-		else
-		{
-			SetEvent(threadWaitingEvent);
+
+		if(state == STREAM_EXIT)
+			break;
+		if(streaming == STREAM_STOPPED)
 			WaitForSingleObject(threadEvent, INFINITE);
-			ResetEvent(threadWaitingEvent);
+		else if(FAILED(renderOneFrame()) && m_request == request)
+		{
+			// no buffers, as while stop decommits, so wait for the change
+			// instead of spinning
+			WaitForSingleObject(threadEvent, 10);
 		}
 	}
-	memAlloc->Decommit();
 	return NOERROR;
 }
-HRESULT COutputPin1::run()
+
+// Sets the state the worker is to stream in, and returns the one before.
+// request is the change to wait on with waitActed.
+LONG COutputPin1::requestState(LONG state, LONG *request)
+{
+	m_requestTime = m_counter.now();
+	LONG previous = InterlockedExchange(&m_state, state);
+	*request = InterlockedIncrement(&m_request);
+	m_trace.record(TRACE_STATE, TRACE_CONTROL, *request, state);
+	SetEvent(threadEvent);
+	SetEvent(deliverEvent);
+	return previous;
+}
+
+void COutputPin1::waitActed(LONG request)
+{
+	while((LONG)(m_acted - request) < 0)
+		WaitForSingleObject(threadActedEvent, INFINITE);
+}
+
+void COutputPin1::startWorker()
+{
+	if(!thread1)
+	{
+		m_trace.allocate(m_traceEvents);
+		thread1 = CreateThread(0, 512 * 1024, start_thread_COutputPin1, this, 0, 0);
+		thread2 = CreateThread(0, 64 * 1024, start_deliver_thread_COutputPin1, this, 0, 0);
+	}
+}
+
+// How quickly the worker follows the graph, for the debugger output
+void COutputPin1::reportTransitions(long long stopTime)
+{
+	char text[200];
+	sprintf_s(text, sizeof(text), "outputpin1 state changes: %lu, worker caught up mean %I64d us max %I64d us, stop took %I64d us\n",
+		m_transitions, m_transitions ? m_transitionSum / (long long)m_transitions / 10 : 0, m_transitionMax / 10, stopTime / 10);
+	OutputDebugStringA(text);
+}
+
+HRESULT COutputPin1::run(REFERENCE_TIME tStart)
 {
 	WaitForSingleObject(mutex, INFINITE);
-	exitnow = false;
-	render = true;
 	if(connectedPin)
-	{	//connectedPin->NewSegment(0, 0, 0);
-		if(!thread1)
-			thread1 = CreateThread(0, 512 * 1024, start_thread_COutputPin1, this, 0, 0);
-		else
-			SetEvent(threadEvent);
+	{
+		// read by the worker once it sees the change
+		m_tStart = tStart;
+		m_graphClock.setClock(filter->clock);
+		startWorker();
+		LONG request;
+		requestState(STREAM_RUNNING, &request);
 	}
 	ReleaseMutex(mutex);
 	return NOERROR;
@@ -1977,40 +1661,41 @@ HRESULT COutputPin1::run()
 HRESULT COutputPin1::pause()
 {
 	WaitForSingleObject(mutex, INFINITE);
-	exitnow = false;
-	render = true;
-	//if(thread1)
-	//	WaitForSingleObject(threadWaitingEvent, INFINITE);
- 	//m_rtSampleTime = 0;
 	if(connectedPin)
-	{	
-		//connectedPin->NewSegment(0, 0, 0);
-		if(!thread1)
-			thread1 = CreateThread(0, 512 * 1024, start_thread_COutputPin1, this, 0, 0);
-		else
-			SetEvent(threadEvent);
+	{
+		startWorker();
+		LONG request;
+		requestState(STREAM_PAUSED, &request);
 	}
-	//renderOneFrame();
 	ReleaseMutex(mutex);
 	return NOERROR;
 }
 
 HRESULT COutputPin1::stop_nolock()
 {
-	exitnow = true;
-	if(thread1)
+	LONG request;
+	long long start = m_counter.now();
+	LONG previous = requestState(STREAM_STOPPED, &request);
+	if(previous != STREAM_STOPPED && thread1)
 	{
-		SetEvent(threadEvent);
-		WaitForSingleObject(thread1, INFINITE);
-		CloseHandle(thread1);
-		thread1 = NULL;
-		connectedPin->EndOfStream();
+		// lets a GetBuffer waiting for a sample return, the worker
+		// decommits again when it has stopped
+		if(memAlloc)
+			memAlloc->Decommit();
+		waitActed(request);
+		if(connectedPin)
+			connectedPin->EndOfStream();
+		reportTransitions(m_counter.now() - start);
 	}
+	m_graphClock.setClock(NULL);
 	m_rtSampleTime = 0;
+	m_rtSampleStep = 0;
+	m_sampleFrame = 0;
+	m_mediaFrame = 0;
 
 	// we need to also reset the repeat time in case the system
-	// clock is turned off after m_iRepeatTime gets very big
-	m_iRepeatTime = m_iDefaultRepeatTime;
+	// clock is turned off after m_rtRepeatTime gets very big
+	m_rtRepeatTime = m_rtDefaultRepeatTime;
 
 	return NOERROR;
 
@@ -2038,7 +1723,55 @@ STDMETHODIMP COutputPin1::Set(
 			__in_bcount(cbPropData)  LPVOID pPropData,
 			/* [in] */ DWORD cbPropData)
 {
-	return E_NOTIMPL;
+	if(guidPropSet != PROPSETID_TestCaptureStats)
+		return E_NOTIMPL;
+	if(dwPropID == STATS_PROPERTY_TRACE_DUMP)
+	{
+		// a terminated name within the data
+		const WCHAR *path = (const WCHAR *)pPropData;
+		DWORD chars = cbPropData / sizeof(WCHAR);
+		if(!path || !chars || path[chars - 1] != 0)
+			return E_INVALIDARG;
+		return m_trace.dump(path) ? S_OK : E_FAIL;
+	}
+	if(dwPropID != STATS_PROPERTY_RESET)
+		return E_PROP_ID_UNSUPPORTED;
+	// each stage clears on its own thread, streaming carries on
+	for(int i=0; i<STATS_STAGES; i++)
+		m_stages[i].reset();
+	m_bytesDrawn.reset();
+	return S_OK;
+}
+
+// PROPSETID_TestCaptureStats
+HRESULT COutputPin1::getStats(DWORD id, LPVOID data, DWORD size, DWORD *returned)
+{
+	DWORD need;
+	if(id == STATS_PROPERTY_COUNTERS)
+		need = sizeof(StatsCounters);
+	else if(id >= STATS_PROPERTY_GETBUFFER && id < STATS_PROPERTY_RESET)
+		need = sizeof(StatsHistogram);
+	else
+		return E_PROP_ID_UNSUPPORTED;
+	if(data == NULL && returned == NULL)
+		return E_POINTER;
+	if(returned)
+		*returned = need;
+	if(data == NULL)  // Caller just wants to know the size.
+		return S_OK;
+	if(size < need) // The buffer is too small.
+		return E_UNEXPECTED;
+
+	if(id == STATS_PROPERTY_COUNTERS)
+	{
+		StatsCounters *c = (StatsCounters *)data;
+		c->framesDrawn = m_stages[STATS_PROPERTY_FILLBUFFER - STATS_PROPERTY_GETBUFFER].count();
+		c->bytesDrawn = m_bytesDrawn.total();
+		c->framesSent = m_stages[STATS_PROPERTY_RECEIVE - STATS_PROPERTY_GETBUFFER].count();
+	}
+	else
+		m_stages[id - STATS_PROPERTY_GETBUFFER].read((StatsHistogram *)data);
+	return S_OK;
 }
 		
 STDMETHODIMP COutputPin1::Get( 
@@ -2053,6 +1786,8 @@ STDMETHODIMP COutputPin1::Get(
 			/* [out] */ 
 			__out  DWORD *pcbReturned)
 {
+	if (guidPropSet == PROPSETID_TestCaptureStats)
+		return getStats(dwPropID, pPropData, cbPropData, pcbReturned);
 	if (guidPropSet != AMPROPSETID_Pin) 
 		return E_PROP_SET_UNSUPPORTED;
 	if (dwPropID != AMPROPERTY_PIN_CATEGORY)
@@ -2075,6 +1810,14 @@ STDMETHODIMP COutputPin1::QuerySupported(
 			/* [out] */ 
 			__out  DWORD *pTypeSupport)
 {
+	if (guidPropSet == PROPSETID_TestCaptureStats)
+	{
+		if(dwPropID >= STATS_PROPERTY_COUNT)
+			return E_PROP_ID_UNSUPPORTED;
+		if(pTypeSupport)
+			*pTypeSupport = dwPropID >= STATS_PROPERTY_RESET ? KSPROPERTY_SUPPORT_SET : KSPROPERTY_SUPPORT_GET;
+		return S_OK;
+	}
 	*pTypeSupport = KSPROPERTY_SUPPORT_GET | KSPROPERTY_SUPPORT_SET;
 	return 0;
 }
@@ -2100,11 +1843,10 @@ STDMETHODIMP COutputPin1::SetFormat(
 	m_frametime = ((VIDEOINFO *)(((AM_MEDIA_TYPE*)pmt)->pbFormat))->AvgTimePerFrame;
 	if(m_frametime != 0)
 	{
-		//m_iRepeatTime = int(10000000 / m_frametime);
-		m_iRepeatTime = int(m_frametime / 10000);
-		if(m_iRepeatTime > 1000)
-			m_iRepeatTime = 1000;
-		m_iDefaultRepeatTime = m_iRepeatTime;
+		m_rtRepeatTime = m_frametime;
+		if(m_rtRepeatTime > 10000000)
+			m_rtRepeatTime = 10000000;
+		m_rtDefaultRepeatTime = m_rtRepeatTime;
 	}
 
 	HRESULT hr = SetMediaType((AM_MEDIA_TYPE*)pmt);
@@ -2145,10 +1887,11 @@ STDMETHODIMP COutputPin1::GetStreamCaps(
 	//if(hr)
 	//	return hr;
 
+	// capabilities list the formats in their own order, whatever SetFormat chose
+	if(iIndex < 0 || iIndex >= FORMATS_COUNT)
+		return S_FALSE;
 	*ppmt = (AM_MEDIA_TYPE *)CoTaskMemAlloc(sizeof(AM_MEDIA_TYPE));
-	int prev = m_preferredFormat = 0;
-	HRESULT hr = GetMediaType(iIndex, (AM_MEDIA_TYPE*)*ppmt);
-	m_preferredFormat = prev;
+	HRESULT hr = *ppmt ? copyMediaType((OUR_FORMATS)iIndex, *ppmt) : E_OUTOFMEMORY;
 	if(hr)
 	{	
 		CoTaskMemFree((PVOID)*ppmt);
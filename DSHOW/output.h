@@ -47,6 +47,64 @@ public:
 };
 
 
+// The graph's reference clock, waited on with AdviseTime
+class GraphClock : public SchedulerClock
+{
+	IReferenceClock *m_clock;
+	HANDLE m_event;
+public:
+	GraphClock();
+	~GraphClock();
+	// AddRefs the clock, NULL lets go of it
+	void setClock(IReferenceClock *clock);
+	IReferenceClock *clock() {return m_clock;}
+	long long now();
+	void sleepUntil(long long t, HANDLE wake);
+};
+
+// Where streaming time went, in m_counter 100 ns.  The worker keeps the
+// drawing side, the delivery thread the rest.
+struct ThroughputStats
+{
+	long long bufferWait;		// In GetBuffer, all buffers queued or downstream
+	unsigned long long drawn;	// Frames drawn
+	long long renderSum;		// Drawing and stamping them
+	long long renderMax;
+	long long queueWait;		// Waiting for room in the delivery queue
+	unsigned long long frames;	// Frames Receive took
+	long long receiveSum;		// In Receive
+	long long first;			// Receive of the first frame started
+	long long last;				// Receive of the last frame returned
+};
+
+// Every media type GetMediaType offers for one frame size and rate, built
+// once so enumerating and connecting only copy them
+struct MediaTypeList
+{
+	int width;
+	int height;
+	LONGLONG frametime;
+	AM_MEDIA_TYPE types[FORMATS_COUNT];	// By OUR_FORMATS, pbFormat points into formats
+	VIDEOINFO formats[FORMATS_COUNT];
+};
+
+// What drawing one media type takes, worked out when the type is set so
+// FillBuffer looks nothing up for each frame
+struct RenderConfig
+{
+	GUID subtype;
+	LONG width;					// biWidth
+	LONG height;				// biHeight, positive for bottom-up RGB
+	DWORD compression;			// biCompression
+	WORD bitCount;
+	OUR_FORMATS format;
+	RECT target;				// rcTarget, or all of biWidth by biHeight when it is empty
+	DWORD pitch;				// Of biWidth, downstream pads its surfaces with a wider one
+	DWORD offset;				// To the first row of the target in memory
+	DWORD frameBytes;
+	bool bottomUp;
+};
+
 class COutputPin1 : public IKsPropertySet,
 	public IAMStreamConfig,
 	public ISpecifyPropertyPages,
@@ -59,30 +117,103 @@ class COutputPin1 : public IKsPropertySet,
 	IMemInputPin *connectedMemInputPin;
 	IMemAllocator *memAlloc;
 	HANDLE mutex;
-	HANDLE threadEvent;
-	HANDLE threadWaitingEvent;
-	HANDLE thread1;
+	HANDLE lateMutex;	// m_late, shared with Notify
+	HANDLE threadEvent;			// Set with each change to m_state, wakes the worker
+	HANDLE threadActedEvent;	// Set each time the worker catches up with m_request
+	HANDLE thread1;				// The streaming worker, from the first run or pause until the pin goes
+	HANDLE deliverEvent;		// As threadEvent, for the delivery thread
+	HANDLE deliverActedEvent;	// Set each time the delivery thread catches up with m_request
+	HANDLE thread2;				// The delivery thread, which lives as long as thread1
 
 	long refCount;
 	int m_iImageHeight;
 	int m_iImageWidth;
 	int m_iImagePitch;
-	int m_iRepeatTime;				// Time in msec between frames
-	int m_iDefaultRepeatTime;	// Initial m_iRepeatTime
+	REFERENCE_TIME m_rtRepeatTime;			// Time between frames, 100 ns
+	REFERENCE_TIME m_rtDefaultRepeatTime;	// Initial m_rtRepeatTime
 
 	int m_preferredFormat;
+	MediaTypeList *m_types;		// For the size and rate it holds, rebuilt when they change
+	HANDLE typesMutex;			// m_types
+	void updateMediaTypes();
+	HRESULT copyMediaType(OUR_FORMATS format, AM_MEDIA_TYPE *pmt);
+
+	// Types set lately.  The ones m_config and m_nextConfig point to are
+	// never reused, so the worker can draw with one unlocked.
+	enum { RENDER_CONFIGS = 4 };
+	RenderConfig m_configs[RENDER_CONFIGS];
+	unsigned int m_configCount;
+	unsigned int m_configReuse;				// Next of m_configs to overwrite when full
+	HANDLE configMutex;						// m_configs, m_nextConfig and changes to m_config
+	RenderConfig * volatile m_nextConfig;	// The type set last, for FillBuffer to take up
+	RenderConfig *m_config;					// The type the worker draws, NULL until one is set
+	void selectConfig(const AM_MEDIA_TYPE *pmt);
 	unsigned int framecount;
-	bool render;
-	bool exitnow;
-	bool threadWaiting;
+	DWORD m_streamingThreshold;	// Frames this size or larger use streaming stores, 0 for never
+	DWORD m_renderThreads;		// Threads drawing each frame, 0 for one per processor
+	DWORD m_stripeHeight;		// Rows in each part of the frame handed to a thread, 0 for whole frames
+	DWORD m_buffers;			// Sample buffers asked of the allocator
+	DWORD m_renderAhead;		// Frames drawn and queued for delivery before they are due
+	DWORD m_spinTime;			// Microseconds before each frame is due spent spinning instead of sleeping
+	DWORD m_latePolicy;			// LATE_MODE for frames that cannot make their time
+	DWORD m_unthrottled;		// Sends frames as fast as downstream takes them, stamped at the nominal rate
+	DWORD m_traceEvents;		// Events the trace ring holds, 0 for no tracing
+	DWORD m_largePages;			// Our own allocator's buffers come from large pages when the account allows
+	DWORD m_sharedRing;			// Slots in the shared memory ring each frame is also drawn into, 0 for none
+	FrameRing m_ring;
+	void openRing();
+	void writeRing(REFERENCE_TIME rtStart, REFERENCE_TIME rtStop, LONGLONG frame);
+	TraceRing m_trace;
+	bool m_stress;				// m_unthrottled as streaming started
+	ThroughputStats m_throughput;
+	// For PROPSETID_TestCaptureStats, by STATS_PROPERTY - STATS_PROPERTY_GETBUFFER
+	StageHistogram m_stages[STATS_STAGES];
+	StageCounter m_bytesDrawn;
+	HRESULT getStats(DWORD id, LPVOID data, DWORD size, DWORD *returned);
+	FrameScheduler m_scheduler;
+	GraphClock m_graphClock;
+	FrameRenderer m_renderer;
+	LatePolicy m_late;
+	bool m_discontinuity;		// Frames were dropped before the next sample
 
-	AM_MEDIA_TYPE m_mt;
+	// Filled samples from the worker to the delivery thread, tagged with
+	// the m_request they were drawn for
+	FrameQueue m_queue;
+	LONG m_pacedRequest;			// The m_request the worker is drawing frames for
+	volatile LONG m_delivered;		// The m_request the delivery thread has caught up with
+	void waitDelivered(LONG request);
+	void reportPacing();
+	void startPacing(bool running);
+	void nextSampleTimes(REFERENCE_TIME &rtStart, REFERENCE_TIME &rtStop);
+
+	// The graph's state for the worker.  run, pause and stop set m_state
+	// and count the change in m_request, the worker reads m_request then
+	// m_state each frame and sets m_acted to the m_request it has acted on.
+	enum STREAM_STATE {STREAM_STOPPED, STREAM_PAUSED, STREAM_RUNNING, STREAM_EXIT};
+	volatile LONG m_state;
+	volatile LONG m_request;
+	volatile LONG m_acted;
+	CounterClock m_counter;			// Times state changes and the throughput
+	long long m_requestTime;		// m_counter time of the last change
+	unsigned long m_transitions;	// Changes the worker acted on
+	long long m_transitionSum;		// From each change to the worker acting on it, 100 ns
+	long long m_transitionMax;
+	LONG requestState(LONG state, LONG *request);
+	void waitActed(LONG request);
+	void startWorker();
+	void startStreaming();
+	void stopStreaming();
+	void reportTransitions(long long stopTime);
 
-	char text8x8[2048];
+	AM_MEDIA_TYPE m_mt;
 
 	// rewrite?
 	//CCritSec m_cSharedState;
-	REFERENCE_TIME m_rtSampleTime;
+	REFERENCE_TIME m_rtSampleTime;	// Stream time of frame 0 at m_rtSampleStep
+	REFERENCE_TIME m_rtSampleStep;	// Frame time the sample times count in
+	LONGLONG m_sampleFrame;			// Frames stamped since m_rtSampleStep changed
+	LONGLONG m_mediaFrame;			// Frames stamped since the stream started, the media time
+	REFERENCE_TIME m_tStart;		// Reference time of stream time 0, from Run
 
 
 public:
@@ -90,8 +221,8 @@ public:
 	COutputPin1(CFilter1 *pParent);
 	~COutputPin1();
 
-	// Draws test patterns
-	HRESULT FillBuffer(IMediaSample *pms);
+	// Draws test patterns, a late frame may keep the picture the buffer has
+	HRESULT FillBuffer(IMediaSample *pms, bool repeat);
 
 	// Ask for buffers of the size appropriate to the agreed media type
 	HRESULT DecideBufferSize(IMemAllocator *pIMemAlloc,
@@ -102,9 +233,13 @@ public:
 	HRESULT CheckMediaType(const AM_MEDIA_TYPE *pMediaType);
 	HRESULT GetMediaType(int iPosition, AM_MEDIA_TYPE *pmt);
 
+	// Tuning values from the filter's property bag
+	void loadSettings(IPropertyBag *pPropBag, IErrorLog *pErrorLog);
+
 	HRESULT renderOneFrame();
 	DWORD threadCreated1(void);
-	HRESULT run(void);
+	DWORD deliverThread(void);
+	HRESULT run(REFERENCE_TIME tStart);
 	HRESULT pause(void);
 	HRESULT stop_nolock(void);
 	HRESULT stop(void);
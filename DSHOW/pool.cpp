@@ -0,0 +1,136 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include <windows.h>
+#include "pool.h"
+
+StripePool::StripePool()
+{
+	threads = NULL;
+	threadCount = 0;
+	startSemaphore = CreateSemaphore(NULL, 0, MAXLONG, NULL);
+	doneEvent = CreateEvent(NULL, false, false, NULL);
+	func = NULL;
+	param = NULL;
+	stripes = 0;
+	nextStripe = 0;
+	working = 0;
+	exitnow = false;
+}
+
+StripePool::~StripePool()
+{
+	setThreads(1);
+	CloseHandle(startSemaphore);
+	CloseHandle(doneEvent);
+}
+
+DWORD WINAPI StripePool::start_thread(LPVOID lpParam)
+{
+	StripePool *s = (StripePool*)lpParam;
+	while(true)
+	{
+		WaitForSingleObject(s->startSemaphore, INFINITE);
+		if(s->exitnow)
+			break;
+		s->work();
+		// each wake up counts once, the last one out lets run() return
+		if(InterlockedDecrement(&s->working) == 0)
+			SetEvent(s->doneEvent);
+	}
+	return 0;
+}
+
+void StripePool::work()
+{
+	while(true)
+	{
+		unsigned int stripe = (unsigned int)InterlockedIncrement(&nextStripe) - 1;
+		if(stripe >= stripes)
+			break;
+		func(param, stripe, stripes);
+	}
+}
+
+void StripePool::setThreads(unsigned int count)
+{
+	if(count == 0)
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		count = info.dwNumberOfProcessors;
+	}
+	if(count > 64)
+		count = 64;
+	// the calling thread is one of them
+	count = count > 1 ? count - 1 : 0;
+	if(count == threadCount)
+		return;
+
+	if(threads)
+	{
+		exitnow = true;
+		ReleaseSemaphore(startSemaphore, threadCount, NULL);
+		WaitForMultipleObjects(threadCount, threads, true, INFINITE);
+		for(unsigned int i=0; i<threadCount; i++)
+			CloseHandle(threads[i]);
+		delete [] threads;
+		threads = NULL;
+		threadCount = 0;
+		exitnow = false;
+	}
+	if(count)
+	{
+		threads = new HANDLE[count];
+		for(unsigned int i=0; i<count; i++)
+		{
+			threads[i] = CreateThread(0, 64 * 1024, start_thread, this, 0, 0);
+			if(!threads[i])
+				break;
+			threadCount++;
+		}
+	}
+}
+
+void StripePool::run(StripeFunc funcIn, void *paramIn, unsigned int stripesIn)
+{
+	if(threadCount == 0 || stripesIn <= 1)
+	{
+		for(unsigned int i=0; i<stripesIn; i++)
+			funcIn(paramIn, i, stripesIn);
+		return;
+	}
+	func = funcIn;
+	param = paramIn;
+	stripes = stripesIn;
+	nextStripe = 0;
+	unsigned int wake = stripesIn - 1 < threadCount ? stripesIn - 1 : threadCount;
+	working = wake;
+	ReleaseSemaphore(startSemaphore, wake, NULL);
+	work();
+	WaitForSingleObject(doneEvent, INFINITE);
+}
@@ -0,0 +1,55 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Worker threads that split a job into stripes.  run() hands out stripe
+// numbers until they are all done, the calling thread works on them too.
+typedef void (*(StripeFunc))(void *param, unsigned int stripe, unsigned int stripes);
+
+class StripePool
+{
+	HANDLE *threads;
+	unsigned int threadCount;
+	HANDLE startSemaphore;
+	HANDLE doneEvent;
+
+	StripeFunc func;
+	void *param;
+	unsigned int stripes;
+	volatile long nextStripe;
+	volatile long working;
+	volatile bool exitnow;
+
+	void work();
+	static DWORD WINAPI start_thread(LPVOID lpParam);
+public:
+	StripePool();
+	~StripePool();
+
+	// 0 for one thread per processor, 1 renders on the calling thread only
+	void setThreads(unsigned int count);
+	unsigned int getThreads() {return threadCount + 1;}
+	void run(StripeFunc funcIn, void *paramIn, unsigned int stripesIn);
+};
@@ -0,0 +1,141 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <windows.h>
+#include <string.h>
+#include "queue.h"
+
+FrameQueue::FrameQueue()
+{
+	memset(m_entries, 0, sizeof(m_entries));
+	m_head = 0;
+	m_tail = 0;
+	m_depth = CAPACITY;
+	m_producerWaiting = 0;
+	m_consumerWaiting = 0;
+	m_pushedEvent = CreateEvent(NULL, false, false, NULL);
+	m_poppedEvent = CreateEvent(NULL, false, false, NULL);
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+FrameQueue::~FrameQueue()
+{
+	CloseHandle(m_pushedEvent);
+	CloseHandle(m_poppedEvent);
+}
+
+void FrameQueue::setDepth(unsigned int depth)
+{
+	if(depth < 1)
+		depth = 1;
+	if(depth > CAPACITY)
+		depth = CAPACITY;
+	m_depth = depth;
+	// a producer waiting for room may have some now
+	SetEvent(m_poppedEvent);
+}
+
+void FrameQueue::resetStats()
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+// Waits for ready, or wake when there is one
+static bool waitFor(HANDLE ready, HANDLE wake)
+{
+	if(!wake)
+		return WaitForSingleObject(ready, INFINITE) == WAIT_OBJECT_0;
+	HANDLE events[2] = {ready, wake};
+	return WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0;
+}
+
+// The waiting side raises its flag and then looks at the other index, the
+// other side moves its index and then looks at the flag.  Both are full
+// barriers, so either the waiter sees the move or the mover sees the flag.
+
+bool FrameQueue::push(void *item, LONG tag, HANDLE wake)
+{
+	LONG tail = m_tail;
+	if((LONG)(tail - m_head) >= m_depth)
+	{
+		m_stats.fullWaits++;
+		bool woken = true;
+		for(;;)
+		{
+			InterlockedExchange(&m_producerWaiting, 1);
+			if((LONG)(tail - m_head) < m_depth)
+				break;
+			if(!(woken = waitFor(m_poppedEvent, wake)))
+				break;
+		}
+		InterlockedExchange(&m_producerWaiting, 0);
+		if(!woken)
+			return false;
+	}
+	Entry &e = m_entries[tail & (CAPACITY - 1)];
+	e.item = item;
+	e.tag = tag;
+	// the entry is written before the consumer can see it
+	InterlockedIncrement(&m_tail);
+	if(m_consumerWaiting)
+		SetEvent(m_pushedEvent);
+
+	m_stats.pushed++;
+	unsigned int queued = (unsigned int)(tail + 1 - m_head);
+	if(queued > m_stats.highWater)
+		m_stats.highWater = queued;
+	return true;
+}
+
+bool FrameQueue::pop(void **item, LONG *tag, HANDLE wake)
+{
+	LONG head = m_head;
+	if(head == m_tail)
+	{
+		m_stats.emptyWaits++;
+		bool woken = true;
+		for(;;)
+		{
+			InterlockedExchange(&m_consumerWaiting, 1);
+			if(head != m_tail)
+				break;
+			if(!(woken = waitFor(m_pushedEvent, wake)))
+				break;
+		}
+		InterlockedExchange(&m_consumerWaiting, 0);
+		if(!woken)
+			return false;
+	}
+	Entry &e = m_entries[head & (CAPACITY - 1)];
+	*item = e.item;
+	*tag = e.tag;
+	// the entry is read before the producer can reuse it
+	InterlockedIncrement(&m_head);
+	if(m_producerWaiting)
+		SetEvent(m_poppedEvent);
+	m_stats.popped++;
+	return true;
+}
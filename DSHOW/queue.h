@@ -0,0 +1,78 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// A single producer, single consumer queue of filled samples between the
+// thread drawing frames and the thread delivering them.  Each side only
+// moves its own index, so pushing and popping take no lock, the events are
+// only waited on when the queue is full or empty and only set when the
+// other side says it is waiting on them.  Entries carry a tag, the
+// pin's state change the frame was drawn for.
+
+struct FrameQueueStats
+{
+	unsigned long long pushed;
+	unsigned long long popped;
+	unsigned int highWater;			// Most frames queued at once
+	unsigned long long fullWaits;	// Times the drawing side waited for room, delivery was behind
+	unsigned long long emptyWaits;	// Times the delivery side waited for a frame, drawing was behind
+};
+
+class FrameQueue
+{
+public:
+	enum { CAPACITY = 16 };
+
+private:
+	struct Entry
+	{
+		void *item;
+		LONG tag;
+	};
+	Entry m_entries[CAPACITY];
+	volatile LONG m_head;		// Next entry to pop, moved by the consumer only
+	volatile LONG m_tail;		// Next entry to push, moved by the producer only
+	volatile LONG m_depth;		// Entries allowed at once
+	volatile LONG m_producerWaiting;	// 1 while push waits for room
+	volatile LONG m_consumerWaiting;	// 1 while pop waits for an entry
+	HANDLE m_pushedEvent;		// Set after a push the consumer waits for
+	HANDLE m_poppedEvent;		// Set after a pop the producer waits for
+	FrameQueueStats m_stats;
+
+public:
+	FrameQueue();
+	~FrameQueue();
+
+	// 1 to CAPACITY frames
+	void setDepth(unsigned int depth);
+	unsigned int depth() {return m_depth;}
+	unsigned int count() {return (unsigned int)(m_tail - m_head);}
+	// Producer side.  Waits for room, returns false if wake was set first.
+	bool push(void *item, LONG tag, HANDLE wake);
+	// Consumer side.  Waits for an entry, returns false if wake was set first.
+	bool pop(void **item, LONG *tag, HANDLE wake);
+	const FrameQueueStats &stats() {return m_stats;}
+	void resetStats();
+};
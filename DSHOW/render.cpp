@@ -0,0 +1,1028 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <windows.h>
+#include "draw.h"
+#include "render.h"
+#include "pool.h"
+
+// pitch is bytes for every pixels pixels, rounded up to align
+struct FormatPitch
+{
+	WORD pixels;
+	WORD bytes;
+	WORD align;
+};
+// the first plane has height >> shift rows rounded up to rowAlign, then
+// there are chroma planes of pitch >> shiftX bytes rounded up to align, by
+// height >> shiftY rows rounded up to rowAlign.  Shifts round up.
+struct FormatPlanes
+{
+	BYTE shift;
+	BYTE rowAlign;
+	BYTE chroma;
+	BYTE shiftX;
+	BYTE shiftY;
+	BYTE align;
+};
+struct FormatLayout
+{
+	const char *name;
+	FormatPitch pitch;
+	FormatPlanes planes;
+};
+
+// in OUR_FORMATS order: label, pitch, planes
+static const FormatLayout formatLayout[FORMATS_COUNT] =
+{
+	{"RGB32", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB32
+	{"ARGB32", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_ARGB32
+	{"A2RGB32", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_A2RGB32
+	{"A2BGR32", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_A2BGR32
+	{"RGB24", {1, 3, 4}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB24
+	{"RGB555", {1, 2, 4}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB16_555
+	{"RGB565", {1, 2, 4}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB16_565
+	{"ARGB1555", {1, 2, 4}, {0, 1, 0, 0, 0, 1}}, // FORMATS_ARGB16_1555
+	{"ARGB4444", {1, 2, 4}, {0, 1, 0, 0, 0, 1}}, // FORMATS_ARGB16_4444
+	{"RGB8", {1, 1, 4}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB8
+	{"r210", {64, 256, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_r210
+	{"v210", {48, 128, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_v210
+	{"v408", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_v408
+	{"v410", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_v410
+	{"r10k", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_R10k
+	{"AYUV", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_AYUV
+	{"v308", {1, 3, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_v308
+	{"YUY2", {2, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_YUY2
+	{"UYVY", {2, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_UYVY
+	{"YVYU", {2, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_YVYU
+	{"HDYC", {2, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_HDYC
+	{"I420", {1, 1, 1}, {0, 1, 2, 1, 1, 1}}, // FORMATS_I420
+	{"YV12", {1, 1, 1}, {0, 1, 2, 1, 1, 1}}, // FORMATS_YV12
+	{"I422", {1, 1, 1}, {0, 1, 2, 1, 0, 1}}, // FORMATS_I422
+	{"YV16", {1, 1, 1}, {0, 1, 2, 1, 0, 1}}, // FORMATS_YV16
+	{"I444", {1, 1, 1}, {0, 1, 2, 0, 0, 1}}, // FORMATS_I444
+	{"YV24", {1, 1, 1}, {0, 1, 2, 0, 0, 1}}, // FORMATS_YV24
+	{"NV12", {1, 1, 1}, {0, 1, 2, 1, 1, 1}}, // FORMATS_NV12
+	{"NV21", {1, 1, 1}, {0, 1, 2, 1, 1, 1}}, // FORMATS_NV21
+	{"NV16", {1, 1, 1}, {0, 1, 2, 1, 0, 1}}, // FORMATS_NV16
+	{"NV11", {1, 1, 1}, {0, 1, 2, 2, 0, 1}}, // FORMATS_NV11
+	{"444P", {1, 1, 1}, {0, 1, 2, 0, 0, 1}}, // FORMATS_444P
+	{"440P", {1, 1, 1}, {0, 1, 2, 0, 1, 1}}, // FORMATS_440P
+	{"422P", {1, 1, 1}, {0, 1, 2, 1, 0, 1}}, // FORMATS_422P
+	{"411P", {1, 1, 1}, {0, 1, 2, 2, 0, 1}}, // FORMATS_411P
+	{"YUV9", {1, 1, 1}, {0, 1, 2, 2, 2, 1}}, // FORMATS_YUV9
+	{"YVU9", {1, 1, 1}, {0, 1, 2, 2, 2, 1}}, // FORMATS_YVU9
+	{"Y800", {1, 1, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y800
+	{"Y416", {1, 8, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y416
+	{"Y410", {1, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y410
+	{"Y216", {2, 8, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y216
+	{"Y210", {2, 8, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y210
+	{"P216", {1, 2, 1}, {0, 1, 1, 0, 0, 4}}, // FORMATS_P216
+	{"P210", {1, 2, 1}, {0, 1, 1, 0, 0, 4}}, // FORMATS_P210
+	{"P016", {1, 2, 1}, {0, 1, 1, 0, 1, 4}}, // FORMATS_P016
+	{"P010", {1, 2, 1}, {0, 1, 1, 0, 1, 4}}, // FORMATS_P010
+	{"Y16", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y16
+	{"g61b", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_b16g
+	{"RGB48", {1, 6, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB48
+	{"BGR48", {1, 6, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_BGR48
+	{"RGB48B", {1, 6, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB48_SWAP
+	{"BGR48B", {1, 6, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_BGR48_SWAP
+	{"RGBA64", {1, 8, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGBA64
+	{"BGRA64", {1, 8, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_BGRA64
+	{"RGBA64B", {1, 8, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGBA64_SWAP
+	{"BGRA64B", {1, 8, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_BGRA64_SWAP
+	{"RGB565f", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB16_565f
+	{"RGB555f", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB16_555f
+	{"RGB444f", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGB16_444f
+	{"Y30016", {1, 2, 1}, {0, 1, 2, 0, 0, 1}}, // FORMATS_Y30016
+	{"Y31016", {1, 2, 1}, {0, 1, 1, 0, 0, 4}}, // FORMATS_Y31016
+	{"Y31116", {1, 2, 1}, {0, 1, 1, 0, 1, 4}}, // FORMATS_Y31116
+	{"Y16_F", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y16_F
+	{"GBRP", {1, 1, 1}, {0, 1, 2, 0, 0, 1}}, // FORMATS_GBRP
+	{"GBRP16", {1, 2, 1}, {0, 1, 2, 0, 0, 1}}, // FORMATS_GBRP16
+	{"BGGR8", {1, 1, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_BGGR8
+	{"RGGB8", {1, 1, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGGB8
+	{"GBRG8", {1, 1, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_GBRG8
+	{"GRBG8", {1, 1, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_GRBG8
+	{"BGGR16", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_BGGR16
+	{"RGGB16", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_RGGB16
+	{"GBRG16", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_GBRG16
+	{"GRBG16", {1, 2, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_GRBG16
+	{"Y411", {4, 6, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y411
+	{"Y41P", {8, 12, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_Y41P
+	{"CLJR", {1, 1, 4}, {0, 1, 0, 0, 0, 1}}, // FORMATS_CLJR
+	{"IYUV", {1, 1, 1}, {0, 1, 2, 1, 1, 1}}, // FORMATS_IYUV
+	{"IMC1", {2, 2, 1}, {0, 16, 2, 0, 1, 1}}, // FORMATS_IMC1
+	{"IMC2", {2, 2, 1}, {0, 16, 1, 0, 1, 1}}, // FORMATS_IMC2
+	{"IMC3", {2, 2, 1}, {0, 16, 2, 0, 1, 1}}, // FORMATS_IMC3
+	{"IMC4", {2, 2, 1}, {0, 16, 1, 0, 1, 1}}, // FORMATS_IMC4
+	{"IUYV", {2, 4, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_IUYV
+	{"IY41", {8, 12, 1}, {0, 1, 0, 0, 0, 1}}, // FORMATS_IY41
+	{"M420", {2, 6, 1}, {1, 1, 0, 0, 0, 1}}, // FORMATS_M420
+};
+
+const char *our_format_to_text(OUR_FORMATS type)
+{
+	if((unsigned int)type >= FORMATS_COUNT)
+		return "?????";
+	return formatLayout[type].name;
+}
+
+
+DWORD getPitch(OUR_FORMATS format, DWORD width)
+{
+	const FormatPitch &p = formatLayout[format].pitch;
+	DWORD pitch = (width + p.pixels - 1) / p.pixels * p.bytes;
+	return (pitch + p.align - 1) & ~(p.align - 1);
+}
+DWORD getImageHeightSize(OUR_FORMATS format, DWORD pitch, DWORD height)
+{
+	const FormatPlanes &p = formatLayout[format].planes;
+	DWORD rowAlign = p.rowAlign - 1;
+	DWORD size = pitch * ((((height + (1 << p.shift) - 1) >> p.shift) + rowAlign) & ~rowAlign);
+	if(p.chroma)
+	{
+		DWORD chromaPitch = (((pitch + (1 << p.shiftX) - 1) >> p.shiftX) + p.align - 1) & ~(p.align - 1);
+		DWORD chromaRows = (((height + (1 << p.shiftY) - 1) >> p.shiftY) + rowAlign) & ~rowAlign;
+		size += chromaPitch * chromaRows * p.chroma;
+	}
+	return size;
+}
+
+// the picture's rows are all there is in the buffer, IUYV and IY41 keep one
+// field after the other
+static bool isSinglePlane(OUR_FORMATS format)
+{
+	const FormatPlanes &p = formatLayout[format].planes;
+	return !p.shift && p.rowAlign == 1 && !p.chroma && format != FORMATS_IUYV && format != FORMATS_IY41;
+}
+// bytes drawn in each row, without getPitch's alignment
+static DWORD getRowBytes(OUR_FORMATS format, DWORD width)
+{
+	const FormatPitch &p = formatLayout[format].pitch;
+	return (width + p.pixels - 1) / p.pixels * p.bytes;
+}
+bool getTargetOffset(OUR_FORMATS format, DWORD pitch, DWORD surfaceHeight, DWORD left, DWORD top, DWORD width, DWORD height, bool bottomUp, DWORD &offset)
+{
+	const FormatPitch &p = formatLayout[format].pitch;
+	if(!width || !height || top + height > surfaceHeight || left % p.pixels)
+		return false;
+	DWORD leftBytes = left / p.pixels * p.bytes;
+	if(leftBytes + getRowBytes(format, width) > pitch)
+		return false;
+	if(!isSinglePlane(format) && (left || top || height != surfaceHeight))
+		return false;
+	DWORD row = bottomUp ? surfaceHeight - top - height : top;
+	offset = row * pitch + leftBytes;
+	return true;
+}
+
+// 10 bit RGB with 2 bit alpha, r210 and R10k are big endian
+template<DRAW_SWAP SWAP>
+static void drawRGB10(const DrawPass &pass, BYTE *pData, int pitch, int width, int height, unsigned int rev, unsigned int rot)
+{
+	int width1 = width / 4;
+	int width2 = width / 2;
+	int width3 = width * 3 / 4;
+	unsigned int color1 = _lrotl(0xC0000000, rot);
+	draw_bits<4, SWAP>(pass, &pData[0], pitch, width1, height, color1, _lrotl(0x00000001 << rev, rot), 1024);
+	draw_bits<4, SWAP>(pass, &pData[width1*4], pitch, width2-width1, height, color1, _lrotl(0x00000400, rot), 1024);
+	draw_bits<4, SWAP>(pass, &pData[width2*4], pitch, width3-width2, height, color1, _lrotl(0x00100000 >> rev, rot), 1024);
+	draw_bits<4, SWAP>(pass, &pData[width3*4], pitch, width-width3, height, color1, 0x40100401 << rot, 1024);
+}
+
+// 16 bits per channel RGB in 48 bits or RGBA in 64 bits
+template<int BYTES, DRAW_SWAP SWAP>
+static void drawRGB16(const DrawPass &pass, BYTE *pData, int pitch, int width, int height, unsigned int rev)
+{
+	int width1 = width / 4;
+	int width2 = width / 2;
+	int width3 = width * 3 / 4;
+	draw_bits<BYTES, SWAP>(pass, &pData[0], pitch, width1, height, 0xFFFF000000000000, 0x0000000000000001ull << rev, 65536);
+	draw_bits<BYTES, SWAP>(pass, &pData[width1*BYTES], pitch, width2-width1, height, 0xFFFF000000000000, 0x0000000000010000, 65536);
+	draw_bits<BYTES, SWAP>(pass, &pData[width2*BYTES], pitch, width3-width2, height, 0xFFFF000000000000, 0x0000000100000000 >> rev, 65536);
+	draw_bits<BYTES, SWAP>(pass, &pData[width3*BYTES], pitch, width-width3, height, 0x0000000000000000, 0x0001000100010001, 65536);
+}
+
+// Draws the test pattern under the text, and sets up info to draw text for the format
+static void drawBackground(const DrawPass &pass, BYTE *pData, int pitch, BYTE *pDataOrig, OUR_FORMATS format, int width, int height, DrawCharInfo &info)
+{
+	int width1 = width / 4;
+	int width2 = width / 2;
+	int width3 = width * 3 / 4;
+
+	switch(format)
+	{
+	case FORMATS_RGB32:
+	case FORMATS_ARGB32:
+		info.drawCharFunc = drawChar32; info.bytes = 4;
+		draw_bits<4, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0xFF000000, 0x00000001, 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width1*4], pitch, width2-width1, height, 0xFF000000, 0x00000100, 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width2*4], pitch, width3-width2, height, 0xFF000000, 0x00010000, 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width3*4], pitch, width-width3, height, 0x00000000, 0x01010101, 256);
+		break;
+	case FORMATS_A2RGB32:
+	case FORMATS_A2BGR32:
+	case FORMATS_r210:
+	case FORMATS_R10k:
+		info.drawCharFunc = drawChar32; info.bytes = 4;
+		switch(format)
+		{
+		case FORMATS_A2RGB32: drawRGB10<SWAP_NONE>(pass, pData, pitch, width, height, 0, 0); break;
+		case FORMATS_A2BGR32: drawRGB10<SWAP_NONE>(pass, pData, pitch, width, height, 20, 0); break;
+		case FORMATS_r210: drawRGB10<SWAP_BYTES>(pass, pData, pitch, width, height, 0, 0); break;
+		case FORMATS_R10k: drawRGB10<SWAP_BYTES>(pass, pData, pitch, width, height, 0, 2); break;
+		}
+		break;
+	case FORMATS_v210:
+		info.drawCharFunc = drawChar_v210; info.bytes = 0;
+		draw_v210(pass, pData, pitch,      0, width1, height, 0x20080000, 0x00000001, 1024);
+		draw_v210(pass, pData, pitch, width1, width2, height, 0x00080000, 0x00100001, 1024);
+		draw_v210(pass, pData, pitch, width2, width3, height, 0x00080200, 0x00100000, 1024);
+		draw_v210(pass, pData, pitch, width3, width , height, 0x20000200, 0x00000400, 1024);
+		break;
+	case FORMATS_RGB24:
+		info.drawCharFunc = drawChar24; info.bytes = 3;
+		draw_bits<3, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0xFF000000, 0x00000001, 256);
+		draw_bits<3, SWAP_NONE>(pass, &pData[width1*3], pitch, width2-width1, height, 0xFF000000, 0x00000100, 256);
+		draw_bits<3, SWAP_NONE>(pass, &pData[width2*3], pitch, width3-width2, height, 0xFF000000, 0x00010000, 256);
+		draw_bits<3, SWAP_NONE>(pass, &pData[width3*3], pitch, width-width3, height, 0x00000000, 0x01010101, 256);
+		break;
+	case FORMATS_RGB16_555:
+	case FORMATS_ARGB16_1555:
+	case FORMATS_RGB16_555f:
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		draw_bits<2, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0x8000, 0x0001, 32);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width1*2], pitch, width2-width1, height, 0x8000, 0x0020, 32);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width2*2], pitch, width3-width2, height, 0x8000, 0x0400, 32);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width3*2], pitch, width-width3, height, 0x8000, 0x8421, 32);
+		break;
+	case FORMATS_ARGB16_4444:
+	case FORMATS_RGB16_444f:
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		draw_bits<2, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0xF000, 0x0001, 16);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width1*2], pitch, width2-width1, height, 0xF000, 0x0010, 16);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width2*2], pitch, width3-width2, height, 0xF000, 0x0100, 16);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width3*2], pitch, width-width3, height, 0x0000, 0x1111, 16);
+		break;
+	case FORMATS_RGB16_565:
+	case FORMATS_RGB16_565f:
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		draw_bits<2, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0x0000, 0x0001, 32);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width1*2], pitch, width2-width1, height, 0x0000, 0x0020, 64);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width2*2], pitch, width3-width2, height, 0x0000, 0x0800, 32);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width3*2], pitch, width-width3, height, 0x0200, 0x0821, 32);
+		break;
+	case FORMATS_RGB48:
+	case FORMATS_BGR48:
+	case FORMATS_RGB48_SWAP:
+	case FORMATS_BGR48_SWAP:
+		info.drawCharFunc = drawChar48; info.bytes = 6;
+		switch(format)
+		{
+		case FORMATS_RGB48: drawRGB16<6, SWAP_NONE>(pass, pData, pitch, width, height, 32); break;
+		case FORMATS_BGR48: drawRGB16<6, SWAP_NONE>(pass, pData, pitch, width, height, 0); break;
+		case FORMATS_RGB48_SWAP: drawRGB16<6, SWAP_16>(pass, pData, pitch, width, height, 32); break;
+		case FORMATS_BGR48_SWAP: drawRGB16<6, SWAP_16>(pass, pData, pitch, width, height, 0); break;
+		}
+		break;
+	case FORMATS_RGBA64:
+	case FORMATS_BGRA64:
+	case FORMATS_RGBA64_SWAP:
+	case FORMATS_BGRA64_SWAP:
+		info.drawCharFunc = drawChar64; info.bytes = 8;
+		switch(format)
+		{
+		case FORMATS_RGBA64: drawRGB16<8, SWAP_NONE>(pass, pData, pitch, width, height, 32); break;
+		case FORMATS_BGRA64: drawRGB16<8, SWAP_NONE>(pass, pData, pitch, width, height, 0); break;
+		case FORMATS_RGBA64_SWAP: drawRGB16<8, SWAP_16>(pass, pData, pitch, width, height, 32); break;
+		case FORMATS_BGRA64_SWAP: drawRGB16<8, SWAP_16>(pass, pData, pitch, width, height, 0); break;
+		}
+		break;
+	case FORMATS_GBRP:
+	{
+		info.drawCharFunc = drawChar8; info.bytes = 1;
+		draw_bits<1, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0x00, 0x00, 256);
+		draw_bits<1, SWAP_NONE>(pass, &pData[width1], pitch, width2-width1, height, 0x00, 0x01, 256);
+		draw_bits<1, SWAP_NONE>(pass, &pData[width2], pitch, width3-width2, height, 0x00, 0x00, 256);
+		draw_bits<1, SWAP_NONE>(pass, &pData[width3], pitch, width-width3, height, 0x00, 0x01, 256);
+		BYTE *pData2 = &pData[pitch * height];
+		draw_bits<1, SWAP_NONE>(pass, &pData2[0], pitch, width1, height, 0x00, 0x01, 256);
+		draw_bits<1, SWAP_NONE>(pass, &pData2[width1], pitch, width3-width1, height, 0x00, 0x00, 256);
+		draw_bits<1, SWAP_NONE>(pass, &pData2[width3], pitch, width-width3, height, 0x00, 0x01, 256);
+		pData2 = &pData2[pitch * height];
+		draw_bits<1, SWAP_NONE>(pass, &pData2[0], pitch, width2, height, 0x00, 0x00, 256);
+		draw_bits<1, SWAP_NONE>(pass, &pData2[width2], pitch, width-width2, height, 0x00, 0x01, 256);
+		break;
+	}
+	case FORMATS_GBRP16:
+	{
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		draw_bits<2, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0x00, 0x00, 65536);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width1*2], pitch, width2-width1, height, 0x00, 0x01, 65536);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width2*2], pitch, width3-width2, height, 0x00, 0x00, 65536);
+		draw_bits<2, SWAP_NONE>(pass, &pData[width3*2], pitch, width-width3, height, 0x00, 0x01, 65536);
+		BYTE *pData2 = &pData[pitch * height];
+		draw_bits<2, SWAP_NONE>(pass, &pData2[0], pitch, width1, height, 0x00, 0x01, 65536);
+		draw_bits<2, SWAP_NONE>(pass, &pData2[width1*2], pitch, width3-width1, height, 0x00, 0x00, 65536);
+		draw_bits<2, SWAP_NONE>(pass, &pData2[width3*2], pitch, width-width3, height, 0x00, 0x01, 65536);
+		pData2 = &pData2[pitch * height];
+		draw_bits<2, SWAP_NONE>(pass, &pData2[0], pitch, width2, height, 0x00, 0x00, 65536);
+		draw_bits<2, SWAP_NONE>(pass, &pData2[width2*2], pitch, width-width2, height, 0x00, 0x01, 65536);
+		break;
+	}
+	case FORMATS_BGGR8:
+	case FORMATS_RGGB8:
+	case FORMATS_GBRG8:
+	case FORMATS_GRBG8:
+	{
+		info.drawCharFunc = drawChar8; info.bytes = 1;
+		U32 green = (format == FORMATS_BGGR8 || format == FORMATS_RGGB8) ? 0x00010100 : 0x01000001;
+		U32 blue = ((format == FORMATS_RGGB8 || format == FORMATS_GRBG8) ? 0x01010000 : 0x00000101) & ~green;
+		draw_8bit_bayer(pass, pData, pitch, 0, 0, width1, height, 0x00000000, blue, 256);
+		draw_8bit_bayer(pass, pData, pitch, width1, 0, width2-width1, height, 0x00000000, green, 256);
+		U32 red = (blue ^ 0x01010101) & ~green;
+		draw_8bit_bayer(pass, pData, pitch, width2, 0, width3-width2, height, 0x00000000, red, 256);
+		draw_8bit_bayer(pass, pData, pitch, width3, 0, width -width3, height, 0x00000000, 0x01010101, 256);
+		break;
+	}
+	case FORMATS_BGGR16:
+	case FORMATS_RGGB16:
+	case FORMATS_GBRG16:
+	case FORMATS_GRBG16:
+	{
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		U64 green = (format == FORMATS_BGGR16 || format == FORMATS_RGGB16) ? 0x0000000100010000ull : 0x0001000000000001ull;
+		U64 blue = ((format == FORMATS_RGGB16 || format == FORMATS_GRBG16) ? 0x0001000100000000ull : 0x0000000000010001ull) & ~green;
+		draw_16bit_bayer(pass, pData, pitch, 0, 0, width1, height, 0x0000000000000000, blue, 65536);
+		draw_16bit_bayer(pass, pData, pitch, width1, 0, width2-width1, height, 0x0000000000000000, green, 65536);
+		U64 red = (blue ^ 0x0001000100010001) & ~green;
+		draw_16bit_bayer(pass, pData, pitch, width2, 0, width3-width2, height, 0x0000000000000000, red, 65536);
+		draw_16bit_bayer(pass, pData, pitch, width3, 0, width -width3, height, 0x0000000000000000, 0x0001000100010001, 65536);
+		break;
+	}
+	case FORMATS_AYUV:
+	case FORMATS_v408:
+	{
+		info.drawCharFunc = drawChar32; info.bytes = 4;
+		unsigned int f = 0;
+		switch(format)
+		{
+		case FORMATS_v408: f=1; break;
+		}
+		static unsigned int colu[] = {0x000100, 0x000001};
+		static unsigned int colv[] = {0x000001, 0x010000};
+		static unsigned int coly[] = {0x010000, 0x000100};
+		info.add = (colu[f] + colv[f]) * 128; info.mask = coly[f] * 255;
+		draw_bits<4, SWAP_NONE>(pass, &pData[0], pitch, width1, height, (colv[f] + coly[f]) * 128 + 0xFF000000, colu[f], 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width1*4], pitch, width2 - width1, height, (coly[f]) * 128 + 0xFF000000, colu[f] + colv[f], 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width2*4], pitch, width3 - width2, height, (colu[f] + coly[f]) * 128 + 0xFF000000, colv[f], 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width3*4], pitch, width  - width3, height, (colu[f] + colv[f]) * 128, coly[f] + 0x01000000, 256);
+		break;
+	}
+	case FORMATS_v308:
+		info.drawCharFunc = drawChar24; info.bytes = 3;
+		info.add = 0x800080; info.mask = 0x00FF00;
+		draw_bits<3, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0x008080, 0x010000, 256);
+		draw_bits<3, SWAP_NONE>(pass, &pData[width1*3], pitch, width2-width1, height, 0x008000, 0x010001, 256);
+		draw_bits<3, SWAP_NONE>(pass, &pData[width2*3], pitch, width3-width2, height, 0x808000, 0x000001, 256);
+		draw_bits<3, SWAP_NONE>(pass, &pData[width3*3], pitch, width-width3, height, 0x800080, 0x000100, 256);
+		break;
+	case FORMATS_YUY2:
+	case FORMATS_YVYU:
+	case FORMATS_UYVY:
+	case FORMATS_HDYC:
+	{
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		unsigned int f = 0;
+		switch(format)
+		{
+		case FORMATS_YUY2: f=1; break;
+		case FORMATS_YVYU: f=2; break;
+		}
+		static unsigned int colu[] = {0x00000001, 0x00000100, 0x01000000};
+		static unsigned int colv[] = {0x00010000, 0x01000000, 0x00000100};
+		static unsigned int coly[] = {0x01000100, 0x00010001, 0x00010001};
+		info.add = (colu[f] + colv[f])*128; info.mask = coly[f]*255;
+		draw_bits<4, SWAP_NONE>(pass, &pData[0], pitch, width1 >> 1, height, (colv[f] + coly[f]) * 128, colu[f], 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[(width1 & ~1)*2], pitch, (width2 >> 1) - (width1 >> 1), height, (coly[f]) * 128, colu[f] + colv[f], 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[(width2 & ~1)*2], pitch, (width3 >> 1) - (width2 >> 1), height, (colu[f] + coly[f]) * 128, colv[f], 256);
+		draw_bits<4, SWAP_NONE>(pass, &pData[(width3 & ~1)*2], pitch, (width  >> 1) - (width3 >> 1), height, (colu[f] + colv[f]) * 128, coly[f], 256);
+		break;
+	}
+	case FORMATS_IUYV:
+	{
+		BYTE *pData2 = &pData[((height+1) >> 1)*pitch];
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		info.add = (0x00010001)*128; info.mask = 0x01000100*255;
+		info.ptr_offset = (intptr_t)pData2 - (intptr_t)pData;
+		draw_bits<4, SWAP_NONE>(pass, &pData[0], pitch, width1 >> 1, height, 0x01010100 * 128, 0x00000001, 256, &pData2[0]);
+		draw_bits<4, SWAP_NONE>(pass, &pData[(width1 & ~1)*2], pitch, (width2 >> 1) - (width1 >> 1), height, (0x01000100) * 128, 0x00010001, 256, &pData2[(width1 & ~1)*2]);
+		draw_bits<4, SWAP_NONE>(pass, &pData[(width2 & ~1)*2], pitch, (width3 >> 1) - (width2 >> 1), height, 0x01000101 * 128, 0x00010000, 256, &pData2[(width2 & ~1)*2]);
+		draw_bits<4, SWAP_NONE>(pass, &pData[(width3 & ~1)*2], pitch, (width  >> 1) - (width3 >> 1), height, 0x00010001 * 128, 0x01000100, 256, &pData2[(width3 & ~1)*2]);
+		break;
+	}
+	case FORMATS_I420:
+	case FORMATS_YV12:
+	case FORMATS_IYUV:
+	case FORMATS_IMC1:
+	case FORMATS_IMC2:
+	case FORMATS_IMC3:
+	case FORMATS_IMC4:
+	{
+		int pitch2 = (pitch+1) >> 1;
+		int height2 = (height+1) >> 1;
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch2*height2];
+		switch(format)
+		{
+		case FORMATS_IMC1:
+		case FORMATS_IMC3:
+			pDatau = &pDataOrig[((height + 15) & ~15)*pitch];
+			pDatav = &pDatau[((height2 + 15) & ~15)*pitch];
+			pitch2 = pitch;
+			break;
+		case FORMATS_IMC2:
+		case FORMATS_IMC4:
+			pDatau = &pDataOrig[((height + 15) & ~15)*pitch];
+			pDatav = pDatau + (pitch >> 1);
+			pitch2 = pitch;
+			break;
+		}
+		if(format == FORMATS_YV12 || format == FORMATS_IMC1 || format == FORMATS_IMC2)
+		{
+			BYTE *tmp = pDatau; pDatau = pDatav; pDatav = tmp;
+		}
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8(pass, pDatau, pDatav, pitch2, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1);
+		break;
+	}
+	case FORMATS_I422:
+	case FORMATS_YV16:
+	case FORMATS_422P:
+	{
+		int pitch2 = (pitch+1) >> 1;
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch2*height];
+		if(format == FORMATS_YV16)
+		{
+			BYTE *tmp = pDatau; pDatau = pDatav; pDatav = tmp;
+		}
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8(pass, pDatau, pDatav, pitch2, height, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1);
+		break;
+	}
+	case FORMATS_I444:
+	case FORMATS_YV24:
+	case FORMATS_444P:
+	{
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch*height];
+		if(format == FORMATS_YV24)
+		{
+			BYTE *tmp = pDatau; pDatau = pDatav; pDatav = tmp;
+		}
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8(pass, pDatau, pDatav, pitch, height, width1, width2, width3, width);
+		break;
+	}
+	case FORMATS_440P:
+	{
+		int height2 = (height+1) >> 1;
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch*height2];
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8(pass, pDatau, pDatav, pitch, height2, width1, width2, width3, width);
+		break;
+	}
+	case FORMATS_411P:
+	{
+		int pitch2 = (pitch+3) >> 2;
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch2*height];
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8(pass, pDatau, pDatav, pitch2, height, width1 >> 2, width2 >> 2, width3 >> 2, (width+3) >> 2);
+		break;
+	}
+	case FORMATS_NV11:
+	{
+		BYTE *pDatac = &pDataOrig[pitch*height];
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8_interleaved(pass, pDatac, ((pitch+3) >> 2) * 2, height, width1 >> 2, width2 >> 2, width3 >> 2, (width+3) >> 2, false);
+		break;
+	}
+	case FORMATS_YUV9:
+	case FORMATS_YVU9:
+	{
+		int pitch2 = (pitch+3) >> 2;
+		int height2 = (height+3) >> 2;
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch2*height2];
+		if(format == FORMATS_YVU9)
+		{
+			BYTE *tmp = pDatau; pDatau = pDatav; pDatav = tmp;
+		}
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8(pass, pDatau, pDatav, pitch2, height2, width1 >> 2, width2 >> 2, width3 >> 2, (width+3) >> 2);
+		break;
+	}
+	case FORMATS_NV12:
+	case FORMATS_NV21:
+	{
+		int height2 = (height+1) >> 1;
+		BYTE *pDatac = &pDataOrig[pitch*height];
+
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8_interleaved(pass, pDatac, (pitch+1) & ~1, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, format == FORMATS_NV21);
+		break;
+	}
+	case FORMATS_M420:
+	{
+		int height2 = (height+1) >> 1;
+		int pitch13 = pitch / 3;
+		BYTE *pDatac = &pData[pitch13*2];
+		info.ptr_offset = (intptr_t)pitch13;
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width, &pData[pitch13]);
+		drawColorLayer8_interleaved(pass, pDatac, pitch, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, false);
+		break;
+	}
+	case FORMATS_NV16:
+	{
+		BYTE *pDatac = &pDataOrig[pitch*height];
+
+		drawIntinsityLayer8(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer8_interleaved(pass, pDatac, (pitch+1) & ~1, height, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, false);
+		break;
+	}
+	case FORMATS_Y30016:
+	{
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch*height];
+
+		drawIntinsityLayer16(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer16(pass, pDatau, pDatav, pitch, height, width1, width2, width3, width);
+		break;
+	}
+	case FORMATS_P216:
+	case FORMATS_P210:
+	{
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		BYTE *pDatac = &pDataOrig[pitch*height];
+
+		drawIntinsityLayer16(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer16_interleaved(pass, pDatac, (pitch+3) & ~3, height, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, false);
+		break;
+	}
+	case FORMATS_Y31016:
+	{
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		int pitch2 = ((pitch+3) >> 2)*2;
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch2*height];
+
+		drawIntinsityLayer16(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer16(pass, pDatau, pDatav, pitch2, height, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1);
+		break;
+	}
+	case FORMATS_P016:
+	case FORMATS_P010:
+	{
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		int height2 = (height+1) >> 1;
+		BYTE *pDatac = &pDataOrig[pitch*height];
+
+		drawIntinsityLayer16(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer16_interleaved(pass, pDatac, (pitch+3) & ~3, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1, false);
+		break;
+	}
+	case FORMATS_Y31116:
+	{
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		int height2 = (height+1) >> 1;
+		int pitch2 = ((pitch+3) >> 2)*2;
+		BYTE *pDatau = &pDataOrig[pitch*height];
+		BYTE *pDatav = &pDatau[pitch2*height2];
+
+		drawIntinsityLayer16(pass, pData, pitch, height, width1, width2, width3, width);
+		drawColorLayer16(pass, pDatau, pDatav, pitch2, height2, width1 >> 1, width2 >> 1, width3 >> 1, (width+1) >> 1);
+		break;
+	}
+	case FORMATS_Y16:
+	case FORMATS_Y16_F:
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		draw_bits<2, SWAP_NONE>(pass, &pData[0], pitch, width, height, 0x00, 0x01, 65536);
+		break;
+	case FORMATS_b16g:
+		info.drawCharFunc = drawChar16; info.bytes = 2;
+		draw_bits<2, SWAP_BYTES>(pass, &pData[0], pitch, width, height, 0x00, 0x01, 65536);
+		break;
+	case FORMATS_Y416:
+		// ayuv to avyu
+		info.drawCharFunc = drawChar64; info.bytes = 8;
+		info.add = 0xFFFF800000008000; info.mask = 0x00000000FFFF0000;
+		draw_bits<8, SWAP_NONE>(pass, &pData[0], pitch, width1, height, 0xFFFF800080000000, 0x0000000000000001, 65536);
+		draw_bits<8, SWAP_NONE>(pass, &pData[width1*8], pitch, width2-width1, height, 0xFFFF000080000000, 0x0000000100000001, 65536);
+		draw_bits<8, SWAP_NONE>(pass, &pData[width2*8], pitch, width3-width2, height, 0xFFFF000080008000, 0x0000000100000000, 65536);
+		draw_bits<8, SWAP_NONE>(pass, &pData[width3*8], pitch, width-width3, height, 0x0000800000008000, 0x0001000000010000, 65536);
+		break;
+	case FORMATS_Y410:
+	case FORMATS_v410:
+	{
+		info.drawCharFunc = drawChar32; info.bytes = 4;
+		unsigned int rot=0;
+		switch(format)
+		{
+		case FORMATS_v410: rot=2;
+		}
+		info.add = _lrotl(0x20000200, rot); info.mask = _lrotl(0xC00FFC00, rot);
+		draw_bits<4, SWAP_NONE>(pass, &pData[0], pitch, width1, height, _lrotl(0xE0080000, rot), _lrotl(0x00000001, rot), 1024);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width1*4], pitch, width2-width1, height, _lrotl(0xC0080000, rot), _lrotl(0x00100001, rot), 1024);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width2*4], pitch, width3-width2, height, _lrotl(0xC0080200, rot), _lrotl(0x00100000, rot), 1024);
+		draw_bits<4, SWAP_NONE>(pass, &pData[width3*4], pitch, width-width3, height, _lrotl(0xA0000200, rot), 0x40000400 << rot, 1024);
+		break;
+	}
+	case FORMATS_Y216:
+	case FORMATS_Y210:
+		info.drawCharFunc = drawChar32; info.bytes = 4;
+		info.add = 0x8000000080000000; info.mask = 0x0000FFFF0000FFFF;
+		draw_bits<8, SWAP_NONE>(pass, &pData[0], pitch, width1 >> 1, height, 0x8000800000008000, 0x0000000000010000, 65536);
+		draw_bits<8, SWAP_NONE>(pass, &pData[(width1 & ~1)*4], pitch, (width2 >> 1) - (width1 >> 1), height, 0x0000800000008000, 0x0001000000010000, 65536);
+		draw_bits<8, SWAP_NONE>(pass, &pData[(width2 & ~1)*4], pitch, (width3 >> 1) - (width2 >> 1), height, 0x0000800080008000, 0x0001000000000000, 65536);
+		draw_bits<8, SWAP_NONE>(pass, &pData[(width3 & ~1)*4], pitch, (width  >> 1) - (width3 >> 1), height, 0x8000000080000000, 0x0000000100000001, 65536);
+		break;
+	case FORMATS_Y411:
+		info.drawCharFunc = drawChar_Y411; info.bytes = 0;
+		info.add = 0; info.mask = 255;
+		draw_bits<6, SWAP_NONE>(pass, &pData[0], pitch, width1 >> 2, height, (0x000001000000 + 0x010100010100) * 128, 0x000000000001, 256);
+		draw_bits<6, SWAP_NONE>(pass, &pData[(width1 >> 2)*6], pitch, (width2 >> 2) - (width1 >> 2), height, (0x010100010100) * 128, 0x000000000001 + 0x000001000000, 256);
+		draw_bits<6, SWAP_NONE>(pass, &pData[(width2 >> 2)*6], pitch, (width3 >> 2) - (width2 >> 2), height, (0x000000000001 + 0x010100010100) * 128, 0x000001000000, 256);
+		draw_bits<6, SWAP_NONE>(pass, &pData[(width3 >> 2)*6], pitch, (width  >> 2) - (width3 >> 2), height, (0x000000000001 + 0x000001000000LL) * 128, 0x010100010100, 256);
+		break;
+	case FORMATS_Y41P:
+		info.drawCharFunc = drawChar_Y41P; info.bytes = 0;
+		info.add = 0; info.mask = 255;
+		draw_Y41P(pass, pData, pitch, 0,      width1, height, (0x00010000 + 0x01000100) * 128, 0x00000001, 256);
+		draw_Y41P(pass, pData, pitch, width1, width2, height, (0x01000100) * 128, 0x00000001 + 0x00010000, 256);
+		draw_Y41P(pass, pData, pitch, width2, width3, height, (0x00000001 + 0x01000100) * 128, 0x00010000, 256);
+		draw_Y41P(pass, pData, pitch, width3, width,  height, (0x00000001 + 0x00010000) * 128, 0x01000100, 256);
+		break;
+	case FORMATS_IY41:
+		{
+		info.drawCharFunc = drawChar_Y41P; info.bytes = 0;
+		info.add = 0; info.mask = 255;
+		BYTE *pData2 = &pData[((height+1) >> 1)*pitch];
+		info.ptr_offset = (intptr_t)pData2 - (intptr_t)pData;
+		draw_Y41P(pass, pData, pitch, 0,      width1, height, (0x00010000 + 0x01000100) * 128, 0x00000001, 256, pData2);
+		draw_Y41P(pass, pData, pitch, width1, width2, height, (0x01000100) * 128, 0x00000001 + 0x00010000, 256, pData2);
+		draw_Y41P(pass, pData, pitch, width2, width3, height, (0x00000001 + 0x01000100) * 128, 0x00010000, 256, pData2);
+		draw_Y41P(pass, pData, pitch, width3, width,  height, (0x00000001 + 0x00010000) * 128, 0x01000100, 256, pData2);
+		}
+		break;
+	case FORMATS_CLJR:
+		info.drawCharFunc = drawChar_CLJR; info.bytes = 0;
+		info.add = 0; info.mask = -1;
+		draw_bits<4, SWAP_BYTES>(pass, &pData[0], pitch, width1 >> 2, height, 0x00000001 * 32 + 0x08421000 * 16, 0x00000040, 64);
+		draw_bits<4, SWAP_BYTES>(pass, &pData[(width1 & ~3)], pitch, (width2 >> 2) - (width1 >> 2), height, 0x08421000 * 16, 0x00000040 + 0x00000001, 64);
+		draw_bits<4, SWAP_BYTES>(pass, &pData[(width2 & ~3)], pitch, (width3 >> 2) - (width2 >> 2), height, 0x00000040 * 32 + 0x08421000 * 16, 0x00000001, 64);
+		draw_bits<4, SWAP_BYTES>(pass, &pData[(width3 & ~3)], pitch, (width  >> 2) - (width3 >> 2), height, (0x00000040 + 0x00000001) * 32, 0x08421000, 32);
+		break;
+	default:
+		draw_bits<1, SWAP_NONE>(pass, &pData[0], pitch, width, height, 0x00, 0x01, 256);
+	}
+}
+
+// Frames are drawn and copied by the pool in bands of rows, each thread
+// does whole stripes so the result does not depend on the thread count.
+struct BackgroundJob
+{
+	BYTE *pData;
+	int pitch;
+	BYTE *pDataOrig;
+	OUR_FORMATS format;
+	int width;
+	int height;
+	bool streaming;
+	DrawCharInfo info;
+	DrawCharInfo result;	// the text setup, from stripe 0
+};
+
+static void backgroundStripe(void *param, unsigned int stripe, unsigned int stripes)
+{
+	BackgroundJob *job = (BackgroundJob *)param;
+	DrawCharInfo info = job->info;
+	DrawPass pass = {stripe, stripes, job->streaming};
+	drawBackground(pass, job->pData, job->pitch, job->pDataOrig, job->format, job->width, job->height, info);
+	if(job->streaming)
+		fillFlush();
+	if(stripe == 0)
+		job->result = info;
+}
+
+static void drawBackgroundStripes(StripePool *pool, unsigned int stripes, BYTE *pData, int pitch, BYTE *pDataOrig, OUR_FORMATS format, int width, int height, DrawCharInfo &info, bool streaming)
+{
+	BackgroundJob job = {pData, pitch, pDataOrig, format, width, height, streaming, info, info};
+	pool->run(backgroundStripe, &job, stripes);
+	info = job.result;
+}
+
+// One run of bytes, or rows of them when the picture is narrower than the
+// surface downstream gave us and the bytes between belong to it
+struct CopyJob
+{
+	BYTE *dst;
+	const BYTE *src;
+	DWORD bytes;
+	DWORD rows;
+	DWORD pitch;
+	bool streaming;
+};
+
+static void copyStripe(void *param, unsigned int stripe, unsigned int stripes)
+{
+	CopyJob *job = (CopyJob *)param;
+	if(job->rows == 1)
+	{
+		DWORD start = (DWORD)((U64)job->bytes * stripe / stripes) & ~63;
+		DWORD end = stripe + 1 == stripes ? job->bytes : (DWORD)((U64)job->bytes * (stripe + 1) / stripes) & ~63;
+		fill_copy(job->dst + start, job->src + start, end - start, job->streaming);
+	}
+	else
+	{
+		DWORD start = job->rows * stripe / stripes;
+		DWORD end = job->rows * (stripe + 1) / stripes;
+		for(DWORD y=start; y<end; y++)
+			fill_copy(job->dst + y * job->pitch, job->src + y * job->pitch, job->bytes, job->streaming);
+	}
+	if(job->streaming)
+		fillFlush();
+}
+
+FrameRenderer::FrameRenderer() :
+	m_format(FORMATS_COUNT),
+	m_width(0),
+	m_height(0),
+	m_bottomUp(false),
+	m_pitch(0),
+	m_offset(0),
+	m_frameBytes(0),
+	m_copyOffset(0),
+	m_copyBytes(0),
+	m_copyRows(1),
+	m_rowBytes(0),
+	m_label(""),
+	m_labelWidth(0),
+	m_streamingThreshold(4*1024*1024),
+	m_stripeHeight(64),
+	m_background(NULL),
+	m_backgroundValid(false),
+	m_samples(NULL),
+	m_sampleCount(0),
+	m_nextSample(0)
+{
+	memset(text8x8, 0, sizeof(text8x8));
+	readTextFile(text8x8);
+	m_pool = new StripePool();
+	setBufferCount(SAMPLE_TEXT_COUNT);
+}
+
+FrameRenderer::~FrameRenderer()
+{
+	_aligned_free(m_background);
+	delete m_pool;
+	delete[] m_samples;
+}
+
+void FrameRenderer::setBufferCount(unsigned int count)
+{
+	if(count < SAMPLE_TEXT_COUNT)
+		count = SAMPLE_TEXT_COUNT;
+	if(count == m_sampleCount)
+		return;
+	delete[] m_samples;
+	m_samples = new SampleText[count];
+	m_sampleCount = count;
+	m_nextSample = 0;
+	forgetBuffers();
+}
+
+void FrameRenderer::setTuning(DWORD streamingThreshold, DWORD renderThreads, DWORD stripeHeight)
+{
+	m_streamingThreshold = streamingThreshold;
+	m_stripeHeight = stripeHeight;
+	m_pool->setThreads(renderThreads);
+}
+
+void FrameRenderer::setFormat(OUR_FORMATS format, int width, int height, bool bottomUp, DWORD pitch, DWORD offset, DWORD frameBytes)
+{
+	m_format = format;
+	m_width = abs(width);
+	m_height = abs(height);
+	m_bottomUp = bottomUp;
+	m_backgroundValid = false;
+	m_pitch = 0;
+	m_offset = 0;
+	m_frameBytes = 0;
+	m_copyOffset = 0;
+	m_copyBytes = 0;
+	m_copyRows = 1;
+	m_rowBytes = 0;
+	m_label = our_format_to_text(format);
+	m_labelWidth = (DWORD)strlen(m_label) * 8;
+	if(hasFormat())
+	{
+		DWORD packed = getPitch(m_format, m_width);
+		m_pitch = pitch ? pitch : packed;
+		m_offset = offset;
+		m_frameBytes = frameBytes ? frameBytes : getImageHeightSize(m_format, m_pitch, m_height);
+		m_rowBytes = getRowBytes(m_format, m_width);
+		m_copyBytes = m_frameBytes;
+		if(isSinglePlane(m_format))
+		{
+			m_copyOffset = m_offset;
+			m_copyBytes = m_height * m_pitch;
+			if((DWORD)m_pitch > packed)
+			{
+				m_copyBytes = m_rowBytes;
+				m_copyRows = m_height;
+			}
+		}
+	}
+}
+
+bool FrameRenderer::canRepeat(BYTE *pData)
+{
+	if(!m_backgroundValid)
+		return false;
+	for(unsigned int i=0; i<m_sampleCount; i++)
+	{
+		if(m_samples[i].buffer == pData)
+			return true;
+	}
+	return false;
+}
+
+void FrameRenderer::render(BYTE *pData, unsigned int framecount)
+{
+	OUR_FORMATS format = m_format;
+	int width = m_width;
+	int height = m_height;
+	int pitch = m_pitch;
+	DWORD frameBytes = m_frameBytes;
+
+	// a frame bigger than the cache is written around it
+	bool streaming = m_streamingThreshold != 0 && frameBytes >= m_streamingThreshold;
+
+	BYTE *pDataOrig = pData;
+	int pitchOrig = pitch;
+
+	pData += m_offset;
+	if(m_bottomUp)
+	{
+		pData = &pData[(height-1)*pitch];
+		pitch = -pitch;
+	}
+
+	DrawCharInfo info;
+	info.text = text8x8;
+	info.drawCharFunc = drawChar8;
+	info.ptr_offset = 0;
+	info.add = 0;
+	info.mask = -1;
+	info.pitch = pitch;
+	info.bytes = 1;
+
+	unsigned int stripes = 1;
+	if(m_stripeHeight)
+		stripes = (height + m_stripeHeight - 1) / m_stripeHeight;
+
+	// Everything but the text only changes with the format, so it is
+	// drawn once into m_background and copied into each sample.
+	if(!m_backgroundValid)
+	{
+		_aligned_free(m_background);
+		// a few formats draw a little past getImageHeightSize
+		m_background = (BYTE *)_aligned_malloc(frameBytes + 16*pitchOrig, 64);
+		forgetBuffers();
+		if(m_background)
+		{
+			memset(m_background, 0, frameBytes);
+			drawBackgroundStripes(m_pool, stripes, m_background + (pData - pDataOrig), pitch, m_background, format, width, height, info, false);
+			m_backgroundInfo = info;
+			m_backgroundValid = true;
+		}
+	}
+
+	// A buffer we filled before only differs from the background under its
+	// old label, anything else gets the whole background.
+	SampleText *sample = NULL;
+	if(m_backgroundValid)
+	{
+		info = m_backgroundInfo;
+		for(unsigned int i=0; i<m_sampleCount; i++)
+		{
+			if(m_samples[i].buffer == pDataOrig)
+				sample = &m_samples[i];
+		}
+		if(sample)
+		{
+			if(sample->hasText)
+				restoreText(pDataOrig, *sample);
+		}
+		else
+		{
+			sample = &m_samples[m_nextSample];
+			m_nextSample = (m_nextSample + 1) % m_sampleCount;
+			sample->buffer = pDataOrig;
+			CopyJob job = {pDataOrig + m_copyOffset, m_background + m_copyOffset, m_copyBytes, m_copyRows, (DWORD)pitchOrig, streaming};
+			m_pool->run(copyStripe, &job, stripes);
+		}
+		sample->hasText = false;
+	}
+	else
+		drawBackgroundStripes(m_pool, stripes, pData, pitch, pDataOrig, format, width, height, info, streaming);
+
+	// the whole label bounces inside the picture, 8 character ones are 64 pixels wide
+	if((DWORD)width > m_labelWidth && height > 8)
+	{
+		DWORD text_x = framecount % (((DWORD)width - m_labelWidth) * 2);
+		if(text_x > (DWORD)width - m_labelWidth) text_x = ((DWORD)width - m_labelWidth)*2 - text_x;
+		info.x = text_x;
+		DWORD text_y = framecount % (((DWORD)height - 8) * 2);
+		if(text_y > (DWORD)height - 8) text_y = (height - 8)*2 - text_y;
+
+		if(info.ptr_offset)
+		{
+			if(text_y & 1)
+			{	pData += info.ptr_offset;
+				info.ptr_offset = -info.ptr_offset;
+			}
+			text_y >>= 1;
+		}
+		char *textOut = (char*)&pData[(int)text_y * (int)pitch + (int)text_x*info.bytes];
+		drawText(info, textOut, m_label);
+
+		if(sample)
+		{
+			// the bytes of each row the label covers, packed formats in whole 48 pixel groups
+			DWORD text_w = m_labelWidth;
+			sample->hasText = true;
+			sample->row = &pData[(int)text_y * (int)pitch] - pDataOrig;
+			sample->ptr_offset = info.ptr_offset;
+			if(info.bytes)
+			{
+				sample->start = text_x*info.bytes;
+				sample->end = (text_x + text_w)*info.bytes;
+			}
+			else
+			{
+				sample->start = getPitch(format, text_x / 48 * 48);
+				sample->end = getPitch(format, (text_x + text_w + 47) / 48 * 48);
+				if(sample->end > m_rowBytes)
+					sample->end = m_rowBytes;
+			}
+		}
+	}
+}
+
+// Copies the background back over the label a sample was last given
+void FrameRenderer::restoreText(BYTE *pDataOrig, const SampleText &sample)
+{
+	intptr_t row = sample.row;
+	intptr_t ptr_offset = sample.ptr_offset;
+	for(unsigned int y=0; y<8; y++)
+	{
+		memcpy(&pDataOrig[row + sample.start], &m_background[row + sample.start], sample.end - sample.start);
+		row += ptr_offset;
+		ptr_offset = -ptr_offset;
+		if(ptr_offset >= 0)
+			row += m_backgroundInfo.pitch;
+	}
+}
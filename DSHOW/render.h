@@ -0,0 +1,200 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+// Formats the pin offers, in the order GetMediaType lists them
+enum OUR_FORMATS
+{
+	FORMATS_RGB32,
+	FORMATS_ARGB32,
+	FORMATS_A2RGB32, // a2 r10 g10 b10
+	FORMATS_A2BGR32, // a2 b10 g10 r10
+	FORMATS_RGB24,
+	FORMATS_RGB16_555,
+	FORMATS_RGB16_565,
+	FORMATS_ARGB16_1555,
+	FORMATS_ARGB16_4444,
+	FORMATS_RGB8,
+	FORMATS_r210, // rgb 10 bit bswap (each 32 bit have 10 bit rgb with 2 bit unused)
+	FORMATS_v210, // 4:2:2, uyvy 10 bit, with 30/32 bits used
+	FORMATS_v408, // 4:4:4  UYVA total of 32 bit
+	FORMATS_v410, // 4:4:4  VYU 2 bit unused with 10 bit, total of 32 bit
+	FORMATS_R10k, // rgb 10 bit bswap (each 32 bit have 2 bit unused and 10 bit rgb)
+	FORMATS_AYUV, // 4:4:4 packed total of 32 bit
+	FORMATS_v308, // 4:4:4  UYV  total of 24 bit
+	FORMATS_YUY2, // 4:2:2  YUYV
+	FORMATS_UYVY, // 4:2:2  UYVY
+	FORMATS_YVYU, // 4:2:2  YVYU
+	FORMATS_HDYC, // 4:2:2, UYVY, bt709
+	FORMATS_I420, // 4:2:0, Y,U,V
+	FORMATS_YV12, // 4:2:0, Y,V,U
+	FORMATS_I422, // 4:2:2, Y,U,V
+	FORMATS_YV16, // 4:2:2, Y,V,U
+	FORMATS_I444, // 4:4:4, Y,U,V
+	FORMATS_YV24, // 4:4:4, Y,V,U
+	FORMATS_NV12, // 4:2:0, Y,U+V
+	FORMATS_NV21, // 4:2:0, Y,V+U
+	FORMATS_NV16, // 4:2:0, Y,U+V
+	FORMATS_NV11, // 4:1:1, Y,U+V
+	FORMATS_444P, // 4:4:4, Y,U,V, same as I444
+	FORMATS_440P, // 4:4:0, Y,U,V
+	FORMATS_422P, // 4:2:2, Y,U,V, same as I422
+	FORMATS_411P, // 4:1:1, Y,U,V
+	FORMATS_YUV9, // 4:1:0, Y,U,V chroma: 1/4 width, 1/4 height
+	FORMATS_YVU9, // 4:1:0, Y,V,U chroma: 1/4 width, 1/4 height
+	FORMATS_Y800, // 8 bit gray
+	FORMATS_Y416, // AVYU 16 bit, total of 64 bit
+	FORMATS_Y410, // AVYU 10 bit with 2 bit alpha, total of 32 bit
+	FORMATS_Y216, // 4:2:2 YUYV 16 bit
+	FORMATS_Y210, // 4:2:2 YUYV 16 bit, lower 5 bits are zero
+	FORMATS_P216, // 4:2:2 y,u+v 16 bit
+	FORMATS_P210, // 4:2:2 y,u+v 16 bit, lower 5 bits are zero
+	FORMATS_P016, // 4:2:0 y,u+v 16 bit
+	FORMATS_P010, // 4:2:0 y,u+v 16 bit, lower 5 bits are zero
+	FORMATS_Y16,  // 16 bit gray
+	FORMATS_b16g, // 16 bit gray swap
+	FORMATS_RGB48, // (RGB0) 16 bit RGB, total of 48 bit
+	FORMATS_BGR48, // (BGR0) 16 bit RGB, total of 48 bit
+	FORMATS_RGB48_SWAP, // (0RGB) 16 bit RGB, total of 48 bit, swap
+	FORMATS_BGR48_SWAP, // (0BGR) 16 bit RGB, total of 48 bit, swap
+	FORMATS_RGBA64, // (RBA@) 16 bit RGBA, total of 64 bit
+	FORMATS_BGRA64, // (BRA@) 16 bit RGBA, total of 64 bit
+	FORMATS_RGBA64_SWAP, // (@RBA) 16 bit RGBA, total of 64 bit, swap
+	FORMATS_BGRA64_SWAP, // (@BRA) 16 bit RGBA, total of 64 bit, swap
+
+	// ffmpeg formats
+	FORMATS_RGB16_565f,
+	FORMATS_RGB16_555f,
+	FORMATS_RGB16_444f,
+	FORMATS_Y30016, // 4:4:4 Y,U,V 16 bit
+	FORMATS_Y31016, // 4:2:2 Y,U,V 16 bit
+	FORMATS_Y31116, // 4:0:0 Y,U,V 16 bit
+	FORMATS_Y16_F,  // 16 bit gray, same as Y16
+	FORMATS_GBRP,  // 8 bit G,B,R 3 planes
+	FORMATS_GBRP16,  // 8 bit G,B,R 3 planes
+	FORMATS_BGGR8,  // bayer
+	FORMATS_RGGB8,  // bayer
+	FORMATS_GBRG8,  // bayer
+	FORMATS_GRBG8,  // bayer
+	FORMATS_BGGR16,  // bayer
+	FORMATS_RGGB16,  // bayer
+	FORMATS_GBRG16,  // bayer
+	FORMATS_GRBG16,  // bayer
+
+	FORMATS_Y411, // 4:1:1 packed UYYVYY
+	FORMATS_Y41P, // 4:1:1 packed UYVYUYVYYYYY
+	FORMATS_CLJR, // 4:1:1 packed big engian DWORD(33333222221111100000UuuuuuVvvvvv)
+	FORMATS_IYUV, // same as I420
+	FORMATS_IMC1, // IMC? is various formats that use YUV 4:2:0 with 16 line padding
+	FORMATS_IMC2,
+	FORMATS_IMC3,
+	FORMATS_IMC4,
+
+	FORMATS_IUYV,  // interlaced UYVY
+	FORMATS_IY41,  // interlaced Y41P
+	FORMATS_M420,  // 4:2:0, Y,U+V vertically packed: YYYY,YYYY,UVUV
+
+	FORMATS_COUNT,
+};
+
+
+const char *our_format_to_text(OUR_FORMATS type);
+DWORD getPitch(OUR_FORMATS format, DWORD width);
+DWORD getImageHeightSize(OUR_FORMATS format, DWORD pitch, DWORD height);
+// Bytes from the start of a surface surfaceHeight rows of pitch bytes to the
+// first row in memory of a width by height picture at left, top.  false when
+// the format cannot be drawn there, formats with more than one plane or field
+// only go at the top left of a surface as tall as the picture.
+bool getTargetOffset(OUR_FORMATS format, DWORD pitch, DWORD surfaceHeight, DWORD left, DWORD top, DWORD width, DWORD height, bool bottomUp, DWORD &offset);
+
+class StripePool;
+
+// Draws the test pattern and moving label into frame buffers.  Knows nothing
+// of DirectShow, the pin hands it the format and the buffers to fill.
+class FrameRenderer
+{
+	OUR_FORMATS m_format;
+	int m_width;
+	int m_height;
+	bool m_bottomUp;			// DIB rows, the first row in memory is the bottom of the picture
+	int m_pitch;				// From setFormat, so frames look nothing up
+	DWORD m_offset;				// To the first row of the picture in memory
+	DWORD m_frameBytes;
+	DWORD m_copyOffset;			// What of the background goes into a new buffer,
+	DWORD m_copyBytes;			// m_copyRows rows of m_copyBytes, m_pitch apart
+	DWORD m_copyRows;
+	DWORD m_rowBytes;			// Of the picture, for the label
+	const char *m_label;
+	DWORD m_labelWidth;			// Pixels
+	DWORD m_streamingThreshold;	// Frames this size or larger use streaming stores, 0 for never
+	DWORD m_stripeHeight;		// Rows in each part of the frame handed to a thread, 0 for whole frames
+	StripePool *m_pool;
+	BYTE *m_background;			// The frame without text, laid out like a sample
+	DrawCharInfo m_backgroundInfo;
+	bool m_backgroundValid;		// Cleared when the format changes
+
+	// Where the label is in buffers we have filled, by buffer pointer
+	struct SampleText
+	{
+		BYTE *buffer;
+		bool hasText;
+		intptr_t row;			// First label row, from the start of the buffer
+		intptr_t ptr_offset;	// As DrawCharInfo, for formats with split fields
+		DWORD start;			// Bytes of each row under the label
+		DWORD end;
+	};
+	enum { SAMPLE_TEXT_COUNT = 16 };	// The fewest followed
+	SampleText *m_samples;
+	unsigned int m_sampleCount;
+	unsigned int m_nextSample;
+	void restoreText(BYTE *pDataOrig, const SampleText &sample);
+
+	char text8x8[2048];
+
+public:
+	FrameRenderer();
+	~FrameRenderer();
+
+	// renderThreads 0 for one per processor
+	void setTuning(DWORD streamingThreshold, DWORD renderThreads, DWORD stripeHeight);
+	// pitch, offset and frameBytes are for a surface downstream lays out,
+	// 0 for frames packed as the format's own
+	void setFormat(OUR_FORMATS format, int width, int height, bool bottomUp, DWORD pitch = 0, DWORD offset = 0, DWORD frameBytes = 0);
+	bool hasFormat() {return m_format < FORMATS_COUNT;}
+	DWORD frameBytes() {return m_frameBytes;}
+	// Draws frame number framecount into pData, which holds frameBytes()
+	void render(BYTE *pData, unsigned int framecount);
+	// pData holds a whole frame drawn for the format now, so a late frame
+	// can go out with that picture instead of being drawn
+	bool canRepeat(BYTE *pData);
+	// Draws the background again on the next frame, as when the format changes
+	void invalidate() {m_backgroundValid = false;}
+	// Copies the whole background into the next buffers, as if they were new
+	void forgetBuffers() {memset(m_samples, 0, m_sampleCount * sizeof(SampleText));}
+	// Buffers that come round again, every sample buffer and ring slot.  With
+	// fewer, each is forgotten before it is back and gets the whole background.
+	void setBufferCount(unsigned int count);
+};
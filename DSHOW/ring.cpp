@@ -0,0 +1,195 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <windows.h>
+#include <string.h>
+#include <stddef.h>
+#include "ring.h"
+
+// Slot headers each get two cache lines, frames start on a page
+#define SLOT_HEADER_SIZE 128
+#define RING_PAGE 4096
+
+static DWORD roundUp(DWORD size, DWORD align)
+{
+	return (size + align - 1) & ~(align - 1);
+}
+
+FrameRing::FrameRing()
+{
+	m_mapping = NULL;
+	m_view = NULL;
+	m_header = NULL;
+	m_writer = false;
+	m_next = 0;
+}
+
+FrameRing::~FrameRing()
+{
+	close();
+}
+
+FrameSlotHeader *FrameRing::slot(LONG frame)
+{
+	DWORD index = (DWORD)frame % m_header->slotCount;
+	return (FrameSlotHeader *)(m_view + sizeof(FrameRingHeader) + index * m_header->slotHeaderSize);
+}
+
+static LONG writingSequence(LONG frame) {return (LONG)((DWORD)frame * 2 + 1);}
+static LONG publishedSequence(LONG frame) {return (LONG)((DWORD)frame * 2 + 2);}
+
+bool FrameRing::create(const char *name, unsigned int slots, DWORD frameBytes)
+{
+	close();
+	if(slots < 2 || frameBytes == 0)
+		return false;
+	DWORD headerSize = roundUp(sizeof(FrameRingHeader) + slots * SLOT_HEADER_SIZE, RING_PAGE);
+	DWORD slotSize = roundUp(frameBytes, RING_PAGE);
+	ULONGLONG total = headerSize + (ULONGLONG)slots * slotSize;
+
+	m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		(DWORD)(total >> 32), (DWORD)total, name);
+	if(!m_mapping)
+		return false;
+	bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+	m_view = (BYTE *)MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if(!m_view)
+	{
+		close();
+		return false;
+	}
+	m_header = (FrameRingHeader *)m_view;
+
+	if(existed)
+	{
+		// readers still hold the ring an earlier writer closed, so the name
+		// lives on.  Carry on where it left off if the frames fit, readers
+		// that have not noticed the close keep going.
+		if(m_header->magic != FRAME_RING_MAGIC || m_header->version != FRAME_RING_VERSION ||
+			!m_header->closed || m_header->slotCount != slots || m_header->slotSize < frameBytes)
+		{
+			m_header = NULL;
+			close();
+			return false;
+		}
+		m_writer = true;
+		m_next = m_header->published;
+		InterlockedExchange(&m_header->closed, 0);
+		return true;
+	}
+
+	memset(m_view, 0, headerSize);
+	m_header->version = FRAME_RING_VERSION;
+	m_header->headerSize = headerSize;
+	m_header->slotCount = slots;
+	m_header->slotSize = slotSize;
+	m_header->slotHeaderSize = SLOT_HEADER_SIZE;
+	// readers check the magic before anything else
+	InterlockedExchange((volatile LONG *)&m_header->magic, FRAME_RING_MAGIC);
+	m_writer = true;
+	m_next = 0;
+	return true;
+}
+
+bool FrameRing::open(const char *name)
+{
+	close();
+	m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	if(!m_mapping)
+		return false;
+	m_view = (BYTE *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!m_view)
+	{
+		close();
+		return false;
+	}
+	FrameRingHeader *header = (FrameRingHeader *)m_view;
+	if(header->magic != FRAME_RING_MAGIC || header->version != FRAME_RING_VERSION)
+	{
+		close();
+		return false;
+	}
+	MemoryBarrier();
+	m_header = header;
+	return true;
+}
+
+void FrameRing::close()
+{
+	if(m_header && m_writer)
+		InterlockedExchange(&m_header->closed, 1);
+	m_header = NULL;
+	m_writer = false;
+	if(m_view)
+		UnmapViewOfFile(m_view);
+	m_view = NULL;
+	if(m_mapping)
+		CloseHandle(m_mapping);
+	m_mapping = NULL;
+}
+
+BYTE *FrameRing::beginFrame(DWORD bytes)
+{
+	if(!m_writer || bytes > m_header->slotSize)
+		return NULL;
+	// readers of the frame that was here see the odd sequence from now on
+	InterlockedExchange(&slot(m_next)->sequence, writingSequence(m_next));
+	return m_view + m_header->headerSize + ((DWORD)m_next % m_header->slotCount) * m_header->slotSize;
+}
+
+void FrameRing::publishFrame(const FrameSlotHeader &info)
+{
+	if(!m_writer)
+		return;
+	FrameSlotHeader *s = slot(m_next);
+	const size_t skip = offsetof(FrameSlotHeader, format);
+	memcpy((BYTE *)s + skip, (const BYTE *)&info + skip, sizeof(FrameSlotHeader) - skip);
+	// the exchange orders the frame, streaming stores too, before the sequence
+	InterlockedExchange(&s->sequence, publishedSequence(m_next));
+	m_next++;
+	InterlockedExchange(&m_header->published, m_next);
+}
+
+const BYTE *FrameRing::readFrame(LONG frame, FrameSlotHeader *info)
+{
+	if(!m_header || (LONG)(m_header->published - frame) <= 0)
+		return NULL;
+	FrameSlotHeader *s = slot(frame);
+	LONG sequence = s->sequence;
+	MemoryBarrier();
+	if(sequence != publishedSequence(frame))
+		return NULL;
+	*info = *s;
+	if(!stillValid(frame))
+		return NULL;
+	return m_view + m_header->headerSize + ((DWORD)frame % m_header->slotCount) * m_header->slotSize;
+}
+
+bool FrameRing::stillValid(LONG frame)
+{
+	MemoryBarrier();
+	return m_header && slot(frame)->sequence == publishedSequence(frame);
+}
@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// A ring of frames in shared memory, for readers that are not DirectShow
+// graphs.  One writer draws each frame straight into a slot and readers map
+// the same memory and use the frame where it lies, so neither side copies.
+//
+// Layout: a FrameRingHeader, then slotCount FrameSlotHeaders of
+// slotHeaderSize bytes each, then from headerSize on the frames, slotSize
+// bytes apart.  Frame n is in slot n % slotCount.
+//
+// Publishing is a seqlock.  The writer sets a slot's sequence odd, fills in
+// the frame and its header, sets the sequence even and then moves
+// published on.  A reader takes the even sequence, uses the frame, and
+// checks the sequence again; if it moved the writer came round and the
+// frame is torn.  The writer never waits for readers, a reader that falls
+// more than slotCount frames behind skips to the newest.
+
+#define FRAME_RING_MAGIC 0x47525344		// "DSRG"
+#define FRAME_RING_VERSION 2
+#define FRAME_RING_NAME "Local\\DShowTestCaptureRing"	// The pin's, with SharedRing set
+#define FRAME_RING_MAX_SLOTS 64		// Most slots the pin makes
+
+struct FrameRingHeader
+{
+	DWORD magic;				// FRAME_RING_MAGIC, written last once the ring is ready
+	DWORD version;
+	DWORD headerSize;			// Bytes before the first frame, a multiple of 4096
+	DWORD slotCount;
+	DWORD slotSize;				// Bytes from one frame to the next, a multiple of 4096
+	DWORD slotHeaderSize;		// Bytes from one FrameSlotHeader to the next
+	volatile LONG published;	// Frames published, the newest is published - 1
+	volatile LONG closed;		// Set when the writer goes, readers open the name again for a new ring
+	DWORD reserved[8];
+};
+
+struct FrameSlotHeader
+{
+	volatile LONG sequence;		// 2n+1 while frame n is written, 2n+2 once it is published
+	DWORD format;				// OUR_FORMATS
+	DWORD compression;			// biCompression, BI_RGB or a FOURCC
+	DWORD bitCount;				// biBitCount
+	LONG width;					// biWidth, the surface, which can be wider than the picture
+	LONG height;				// biHeight, positive for bottom-up RGB
+	DWORD pitch;				// Bytes per row, of the first plane for planar formats
+	DWORD size;					// Bytes of frame
+	LONG targetLeft;			// The picture in the surface, as rcTarget, all of it when
+	LONG targetTop;				// downstream gave no target
+	LONG targetWidth;
+	LONG targetHeight;
+	DWORD offset;				// Bytes to the first row of the picture in memory, the bottom row when bottom-up
+	DWORD reserved;				// Keeps the times 8 byte aligned for every compiler
+	LONGLONG start;				// Sample times, 100 ns
+	LONGLONG stop;
+	LONGLONG frame;				// Media time, the frame number
+	LONGLONG counter;			// QueryPerformanceCounter as it was published
+};
+
+class FrameRing
+{
+	HANDLE m_mapping;
+	BYTE *m_view;
+	FrameRingHeader *m_header;
+	bool m_writer;
+	LONG m_next;				// Writer, the frame beginFrame fills
+
+	FrameSlotHeader *slot(LONG frame);
+
+public:
+	FrameRing();
+	~FrameRing();
+
+	// Writer.  Makes the named ring with slots frames of up to frameBytes.
+	// On Windows name is a file mapping name such as Local\DShowTestCaptureRing.
+	bool create(const char *name, unsigned int slots, DWORD frameBytes);
+	// Reader.  Fails until the writer has made the ring.
+	bool open(const char *name);
+	// A writer marks the ring closed for its readers
+	void close();
+	bool isOpen() {return m_header != NULL;}
+	const FrameRingHeader *header() {return m_header;}
+
+	// Writer.  The next frame's memory, marked as being written, or NULL if
+	// bytes do not fit in a slot.
+	BYTE *beginFrame(DWORD bytes);
+	// Writer.  Copies info, all but the sequence, into the slot beginFrame
+	// handed out and publishes it.
+	void publishFrame(const FrameSlotHeader &info);
+
+	// Reader.  Frame number frame if it is still in the ring, with its header
+	// copied to info, NULL if it has been overwritten or is not published yet.
+	const BYTE *readFrame(LONG frame, FrameSlotHeader *info);
+	// Reader.  After using what readFrame returned, whether the writer left
+	// it alone meanwhile.
+	bool stillValid(LONG frame);
+};
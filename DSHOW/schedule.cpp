@@ -0,0 +1,255 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+#include <windows.h>
+#include <mmsystem.h>
+#include <string.h>
+#include "schedule.h"
+
+// a second behind on our own clock starts again from now instead of sending
+// every missed frame at once
+#define SCHEDULER_RESYNC 10000000
+// never slower than a frame a second
+#define LATE_MAX_FRAME_TIME 10000000
+// frames on time in a row before the rate goes back up, and frames after
+// slowing down before the rate can go down again
+#define LATE_RECOVER_FRAMES 60
+#define LATE_HOLD_OFF_FRAMES 8
+
+long long framesToTime(long long frames, long long frameTime)
+{
+	if(frameTime > 0)
+	{
+		// 1001/1000 seconds / fps in 100 ns
+		long long fps = (10010000 + frameTime / 2) / frameTime;
+		if(fps > 0 && 10010000 % fps != 0 && (10010000 + fps / 2) / fps == frameTime)
+			return frames * 10010000 / fps;
+	}
+	return frames * frameTime;
+}
+
+CounterClock::CounterClock()
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	m_freq = freq.QuadPart;
+}
+
+long long CounterClock::now()
+{
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	long long ticks = count.QuadPart;
+	// split so ticks * 10000000 cannot overflow
+	return ticks / m_freq * 10000000 + ticks % m_freq * 10000000 / m_freq;
+}
+
+void CounterClock::sleepUntil(long long t, HANDLE wake)
+{
+	long long wait = t - now();
+	if(wait <= 0)
+		return;
+	if(wake)
+		WaitForSingleObject(wake, (DWORD)(wait / 10000));
+	else
+		Sleep((DWORD)(wait / 10000));
+}
+
+// InterlockedExchange64 needs Vista on x86, the compare exchange does not
+static void storeTime(volatile LONGLONG *p, LONGLONG value)
+{
+	LONGLONG old = *p;
+	LONGLONG seen;
+	while((seen = InterlockedCompareExchange64(p, value, old)) != old)
+		old = seen;
+}
+
+FrameScheduler::FrameScheduler()
+{
+	m_clock = &m_counter;
+	m_base = 0;
+	m_spinTime = 0;
+	m_timerPeriod = false;
+	m_watch = NULL;
+	m_watchValue = 0;
+	m_wake = NULL;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	stop();
+}
+
+void FrameScheduler::start(SchedulerClock *clock, long long spinTime)
+{
+	// Sleep and clock advises are good to about 1 ms instead of the 15.6 ms tick
+	if(!m_timerPeriod)
+		m_timerPeriod = timeBeginPeriod(1) == TIMERR_NOERROR;
+	m_clock = clock ? clock : &m_counter;
+	storeTime(&m_base, m_clock->now());
+	m_spinTime = spinTime;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void FrameScheduler::setBase(long long base)
+{
+	storeTime(&m_base, base);
+}
+
+void FrameScheduler::stop()
+{
+	if(m_timerPeriod)
+		timeEndPeriod(1);
+	m_timerPeriod = false;
+}
+
+long long FrameScheduler::wait(long long t)
+{
+	long long base = InterlockedCompareExchange64(&m_base, 0, 0);
+	long long due = base + t;
+	long long now = m_clock->now();
+	bool missed = now >= due;
+	if(!missed)
+	{
+		// a clock may wake early, sleep again until it is spinning distance away
+		bool cut = false;
+		while(due - now > m_spinTime && !(cut = m_watch && *m_watch != m_watchValue))
+		{
+			m_clock->sleepUntil(due - m_spinTime, m_wake);
+			now = m_clock->now();
+		}
+		while(now < due && !(cut = m_watch && *m_watch != m_watchValue))
+		{
+			YieldProcessor();
+			now = m_clock->now();
+		}
+		if(cut && now < due)
+			return now - due;
+	}
+
+	long long late = now - due;
+	m_stats.frames++;
+	if(missed)
+		m_stats.missed++;
+	else
+	{
+		m_stats.errorSum += late;
+		if(late > m_stats.errorMax)
+			m_stats.errorMax = late;
+	}
+	// the graph clock's stream time is fixed by Run, only our own moves
+	if(late > SCHEDULER_RESYNC && m_clock == &m_counter)
+	{
+		storeTime(&m_base, base + late);
+		m_stats.resyncs++;
+	}
+	return late;
+}
+
+LatePolicy::LatePolicy()
+{
+	start(LATE_SEND, 0);
+}
+
+void LatePolicy::start(LATE_MODE mode, long long frameTime)
+{
+	m_mode = mode < LATE_MODES ? mode : LATE_SEND;
+	m_targetTime = frameTime;
+	m_frameTime = frameTime;
+	m_lateUntil = 0;
+	m_onTime = 0;
+	m_holdOff = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void LatePolicy::slowDown()
+{
+	m_onTime = 0;
+	if(m_holdOff || m_frameTime <= 0 || m_frameTime >= LATE_MAX_FRAME_TIME)
+		return;
+	m_frameTime += m_frameTime / 4;
+	if(m_frameTime > LATE_MAX_FRAME_TIME)
+		m_frameTime = LATE_MAX_FRAME_TIME;
+	m_holdOff = LATE_HOLD_OFF_FRAMES;
+	m_stats.slowed++;
+}
+
+LATE_ACTION LatePolicy::decide(long long t, long long now)
+{
+	if(m_holdOff)
+		m_holdOff--;
+	if(now < t + m_frameTime && t >= m_lateUntil)
+		return FRAME_DRAW;
+	m_stats.late++;
+	switch(m_mode)
+	{
+	case LATE_DROP:
+		m_stats.dropped++;
+		return FRAME_SKIP;
+	case LATE_REPEAT:
+		// counted by repeated() if the buffer had a picture to repeat
+		return FRAME_REPEAT;
+	case LATE_SLOW:
+		slowDown();
+		break;
+	}
+	return FRAME_DRAW;
+}
+
+void LatePolicy::sent(long long late)
+{
+	if(m_mode != LATE_SLOW)
+		return;
+	if(late > m_frameTime / 2)
+	{
+		slowDown();
+		return;
+	}
+	// back up only when well clear of the deadline
+	if(m_frameTime > m_targetTime && late < m_frameTime / 4 && ++m_onTime >= LATE_RECOVER_FRAMES)
+	{
+		m_frameTime -= m_frameTime / 5;
+		if(m_frameTime < m_targetTime)
+			m_frameTime = m_targetTime;
+		m_onTime = 0;
+		m_stats.recovered++;
+	}
+}
+
+void LatePolicy::notify(long long late, long proportion, long long t)
+{
+	if(late <= 0 && (proportion <= 0 || proportion >= 1000))
+		return;
+	m_stats.notified++;
+	if(late > LATE_MAX_FRAME_TIME)
+		late = LATE_MAX_FRAME_TIME;
+	if(late > 0 && t + late > m_lateUntil)
+		m_lateUntil = t + late;
+	if(m_mode == LATE_SLOW)
+		slowDown();
+}
@@ -0,0 +1,159 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// 100 ns from frame 0 to frame n.  Frame times that are a 1000/1001 rate
+// rounded to 100 ns, like 333667 for 29.97 fps, count in the exact fraction
+// so they do not drift a millisecond an hour from the true rate.
+long long framesToTime(long long frames, long long frameTime);
+
+// Where the scheduler reads the time and how it sleeps, in 100 ns units.
+// The pin hands it the graph clock, the bench a stand-in.
+class SchedulerClock
+{
+public:
+	virtual ~SchedulerClock() {}
+	virtual long long now() = 0;
+	// Returns about t, early or late by however well the clock wakes up,
+	// or as soon as wake is set.  wake may be NULL.
+	virtual void sleepUntil(long long t, HANDLE wake) = 0;
+};
+
+// The performance counter and Sleep, for when there is no graph clock
+class CounterClock : public SchedulerClock
+{
+	long long m_freq;
+public:
+	CounterClock();
+	long long now();
+	void sleepUntil(long long t, HANDLE wake);
+};
+
+struct SchedulerStats
+{
+	unsigned long long frames;	// Frames waited for
+	unsigned long long missed;	// Already due when the wait started
+	unsigned long long resyncs;	// Restarted from now after falling a second behind
+	long long errorSum;			// Wake up past the deadline, 100 ns, for frames not missed
+	long long errorMax;
+};
+
+// Paces frames to absolute deadlines.  Each frame is due when the clock
+// reaches the base plus the frame's stream time, so drawing time and wake up
+// jitter never add up over the stream.  Waits sleep on the clock most of the
+// way and spin for the last part.
+class FrameScheduler
+{
+	CounterClock m_counter;
+	SchedulerClock *m_clock;
+	volatile LONGLONG m_base;	// Clock time of stream time 0, moved by wait and read by other
+								// threads, always through Interlocked so 32 bit builds never tear
+	long long m_spinTime;		// 100 ns before each deadline spent spinning
+	bool m_timerPeriod;			// timeBeginPeriod(1) in effect
+	volatile LONG *m_watch;		// Waits are cut short once this is no longer m_watchValue
+	LONG m_watchValue;
+	HANDLE m_wake;				// Set along with changing *m_watch
+	SchedulerStats m_stats;
+
+public:
+	FrameScheduler();
+	~FrameScheduler();
+
+	// Paces on clock, or the performance counter for NULL.  Stream time 0
+	// is now until setBase.
+	void start(SchedulerClock *clock, long long spinTime);
+	void stop();
+	void setBase(long long base);
+	long long now() {return m_clock->now();}
+	long long streamTime() {return m_clock->now() - InterlockedCompareExchange64(&m_base, 0, 0);}
+	// Waits end early once *changed is no longer value, whoever changes it
+	// sets wake
+	void watch(volatile LONG *changed, LONG value, HANDLE wake)
+		{m_watch = changed; m_watchValue = value; m_wake = wake;}
+	// Waits until stream time t, returns how late it woke in 100 ns, less
+	// than 0 when cut short by watch
+	long long wait(long long t);
+	const SchedulerStats &stats() {return m_stats;}
+};
+
+// What to do with frames that cannot make their time
+enum LATE_MODE
+{
+	LATE_SEND,		// draw and send them anyway
+	LATE_DROP,		// count them off without drawing or sending them
+	LATE_REPEAT,	// send the picture already in the buffer without drawing
+	LATE_SLOW,		// lower the frame rate until frames keep up, then raise it again
+	LATE_MODES
+};
+
+enum LATE_ACTION
+{
+	FRAME_DRAW,
+	FRAME_SKIP,
+	FRAME_REPEAT
+};
+
+struct LateStats
+{
+	unsigned long long late;		// Frames found late before drawing
+	unsigned long long dropped;		// Neither drawn nor sent
+	unsigned long long repeated;	// Sent without drawing
+	unsigned long long notified;	// Quality messages saying downstream was late
+	unsigned long long slowed;		// Times the frame rate went down
+	unsigned long long recovered;	// Times it went back up
+};
+
+// Decides what becomes of late frames.  A frame is late when the frame after
+// it is already due, or when downstream said it is behind past the frame's
+// time.  In LATE_SLOW the frame time goes up a quarter at a time while
+// frames are late and comes back down only after a run of frames on time,
+// so it does not swing back and forth at the edge of what keeps up.
+class LatePolicy
+{
+	LATE_MODE m_mode;
+	long long m_targetTime;		// Frame time asked for, 100 ns
+	long long m_frameTime;		// Frame time now, longer while slowed down
+	long long m_lateUntil;		// Stream time downstream is behind until
+	unsigned int m_onTime;		// Frames on time in a row
+	unsigned int m_holdOff;		// Frames before slowing down again
+	LateStats m_stats;
+
+	void slowDown();
+
+public:
+	LatePolicy();
+	void start(LATE_MODE mode, long long frameTime);
+	LATE_MODE mode() {return m_mode;}
+	// Frame time to stamp frames with
+	long long frameTime() {return m_frameTime;}
+	// Frame at stream time t, with the stream time now
+	LATE_ACTION decide(long long t, long long now);
+	// Frame sent, late as the scheduler woke for it
+	void sent(long long late);
+	// Quality message from downstream: late for the sample at stream time t
+	void notify(long long late, long proportion, long long t);
+	void repeated() {m_stats.repeated++;}
+	const LateStats &stats() {return m_stats;}
+};
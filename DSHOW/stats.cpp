@@ -0,0 +1,151 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <windows.h>
+#include <string.h>
+#include "stats.h"
+
+unsigned int statsBucket(LONGLONG value)
+{
+	if(value < 8)
+		return value < 0 ? 0 : (unsigned int)value;
+	unsigned int e = 3;
+	while(e < 39 && (value >> (e + 1)))
+		e++;
+	if(value >> (e + 1))
+		return STATS_BUCKETS - 1;
+	return 8 + (e - 3) * 8 + (unsigned int)((value >> (e - 3)) & 7);
+}
+
+LONGLONG statsBucketLow(unsigned int bucket)
+{
+	if(bucket < 8)
+		return bucket;
+	unsigned int e = (bucket - 8) / 8 + 3;
+	return (LONGLONG)(8 + (bucket - 8) % 8) << (e - 3);
+}
+
+// Readers wait out a record in progress, which never blocks
+static LONG evenSequence(volatile LONG *sequence)
+{
+	for(;;)
+	{
+		// interlocked reads, so the copy cannot move outside them
+		LONG s = InterlockedCompareExchange(sequence, 0, 0);
+		if(!(s & 1))
+			return s;
+		YieldProcessor();
+	}
+}
+
+static bool sequenceKept(volatile LONG *sequence, LONG s)
+{
+	return InterlockedCompareExchange(sequence, 0, 0) == s;
+}
+
+StageHistogram::StageHistogram()
+{
+	memset(&m_data, 0, sizeof(m_data));
+	m_sequence = 0;
+	m_resetAsked = 0;
+	m_resetDone = 0;
+}
+
+void StageHistogram::record(LONGLONG value)
+{
+	InterlockedIncrement(&m_sequence);
+	LONG asked = m_resetAsked;
+	if(asked != m_resetDone)
+	{
+		memset(&m_data, 0, sizeof(m_data));
+		m_resetDone = asked;
+	}
+	if(!m_data.count || value < m_data.min)
+		m_data.min = value;
+	if(!m_data.count || value > m_data.max)
+		m_data.max = value;
+	m_data.sum += value;
+	m_data.buckets[statsBucket(value)]++;
+	m_data.count++;
+	InterlockedIncrement(&m_sequence);
+}
+
+ULONGLONG StageHistogram::count()
+{
+	for(;;)
+	{
+		LONG s = evenSequence(&m_sequence);
+		ULONGLONG count = m_resetAsked != m_resetDone ? 0 : m_data.count;
+		if(sequenceKept(&m_sequence, s))
+			return count;
+	}
+}
+
+void StageHistogram::read(StatsHistogram *out)
+{
+	for(;;)
+	{
+		LONG s = evenSequence(&m_sequence);
+		if(m_resetAsked != m_resetDone)
+			memset(out, 0, sizeof(*out));
+		else
+			memcpy(out, &m_data, sizeof(*out));
+		if(sequenceKept(&m_sequence, s))
+			return;
+	}
+}
+
+StageCounter::StageCounter()
+{
+	m_total = 0;
+	m_sequence = 0;
+	m_resetAsked = 0;
+	m_resetDone = 0;
+}
+
+void StageCounter::add(ULONGLONG value)
+{
+	InterlockedIncrement(&m_sequence);
+	LONG asked = m_resetAsked;
+	if(asked != m_resetDone)
+	{
+		m_total = 0;
+		m_resetDone = asked;
+	}
+	m_total += value;
+	InterlockedIncrement(&m_sequence);
+}
+
+ULONGLONG StageCounter::total()
+{
+	for(;;)
+	{
+		LONG s = evenSequence(&m_sequence);
+		ULONGLONG total = m_resetAsked != m_resetDone ? 0 : m_total;
+		if(sequenceKept(&m_sequence, s))
+			return total;
+	}
+}
@@ -0,0 +1,108 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Telemetry the pin keeps while streaming, read and reset through the
+// pin's IKsPropertySet without stopping the stream.  Get with
+// PROPSETID_TestCaptureStats and a STATS_PROPERTY fills in a StatsCounters
+// or a StatsHistogram, Set with STATS_PROPERTY_RESET clears them all.
+// Times are in 100 ns.
+
+// {FEA35E02-EB64-4402-B162-D9409718B84C}
+DEFINE_GUID(PROPSETID_TestCaptureStats,
+0xfea35e02, 0xeb64, 0x4402, 0xb1, 0x62, 0xd9, 0x40, 0x97, 0x18, 0xb8, 0x4c);
+
+enum STATS_PROPERTY
+{
+	STATS_PROPERTY_COUNTERS,		// StatsCounters
+	STATS_PROPERTY_GETBUFFER,		// StatsHistogram of waiting in GetBuffer
+	STATS_PROPERTY_FILLBUFFER,		// drawing and stamping each frame
+	STATS_PROPERTY_RECEIVE,			// in downstream's Receive
+	STATS_PROPERTY_INTERVAL,		// from the start of one Receive to the next
+	STATS_PROPERTY_SCHEDULE_ERROR,	// how late frames went out, when paced
+	STATS_PROPERTY_RESET,			// Set only
+	STATS_PROPERTY_TRACE_DUMP,		// Set only, the data is a file name as a 0 terminated WCHAR string
+	STATS_PROPERTY_COUNT
+};
+#define STATS_STAGES (STATS_PROPERTY_RESET - STATS_PROPERTY_GETBUFFER)
+
+struct StatsCounters
+{
+	ULONGLONG framesDrawn;
+	ULONGLONG bytesDrawn;
+	ULONGLONG framesSent;
+};
+
+// Histograms are log linear, with 8 buckets to each power of two so a
+// value is never more than 12.5% above the bottom of its bucket.  Values
+// 0 to 7 have a bucket each, after that bucket 8 + (e - 3) * 8 + m holds
+// the values whose top bit is bit e and whose next 3 bits are m, up to
+// 2^40, about 30 hours.  statsBucketLow gives the bottom of a bucket.
+#define STATS_BUCKETS (8 + 37 * 8)
+
+struct StatsHistogram
+{
+	ULONGLONG count;
+	LONGLONG sum;
+	LONGLONG min;
+	LONGLONG max;
+	ULONG buckets[STATS_BUCKETS];
+};
+
+unsigned int statsBucket(LONGLONG value);
+LONGLONG statsBucketLow(unsigned int bucket);
+
+// Recorded into by one thread, read and reset from any.  A reset is only
+// asked for, the next record clears the counts on the recording thread,
+// and until then readers see none.  The sequence is odd while a record
+// changes the counts, readers copy them again until it was even and
+// unchanged around the copy.
+class StageHistogram
+{
+	StatsHistogram m_data;
+	volatile LONG m_sequence;
+	volatile LONG m_resetAsked;
+	LONG m_resetDone;
+public:
+	StageHistogram();
+	void record(LONGLONG value);
+	void reset() {InterlockedIncrement(&m_resetAsked);}
+	ULONGLONG count();
+	void read(StatsHistogram *out);
+};
+
+// A running total reset the same way
+class StageCounter
+{
+	ULONGLONG m_total;
+	volatile LONG m_sequence;
+	volatile LONG m_resetAsked;
+	LONG m_resetDone;
+public:
+	StageCounter();
+	void add(ULONGLONG value);
+	void reset() {InterlockedIncrement(&m_resetAsked);}
+	ULONGLONG total();
+};
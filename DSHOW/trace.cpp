@@ -0,0 +1,145 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+#include "schedule.h"
+#include "trace.h"
+
+static const char *traceEventNames[TRACE_EVENTS] =
+{
+	"state", "state_acted", "buffer_wait", "buffer_acquire", "frame_start", "frame_end",
+	"frame_drop", "queued", "deliver_start", "deliver_end", "buffer_release", "notify"
+};
+
+static const char *traceThreadNames[TRACE_THREADS] =
+{
+	"control", "worker", "delivery", "downstream"
+};
+
+TraceRing::TraceRing()
+{
+	m_events = NULL;
+	m_mask = 0;
+	m_next = 0;
+}
+
+TraceRing::~TraceRing()
+{
+	free(m_events);
+}
+
+void TraceRing::allocate(unsigned int events)
+{
+	if(m_events || !events)
+		return;
+	unsigned int size = 1;
+	while(size < events && size < 0x1000000)
+		size <<= 1;
+	TraceEvent *e = (TraceEvent *)calloc(size, sizeof(TraceEvent));
+	if(!e)
+		return;
+	m_mask = size - 1;
+	m_events = e;
+}
+
+void TraceRing::record(TRACE_EVENT type, TRACE_THREAD thread, LONG frame, LONG value)
+{
+	if(!m_events)
+		return;
+	LONG seq = InterlockedIncrement(&m_next);
+	TraceEvent &e = m_events[(seq - 1) & m_mask];
+	// marked unwritten while it changes, so dump skips it
+	InterlockedExchange(&e.seq, 0);
+	e.time = m_clock.now();
+	e.frame = frame;
+	e.value = value;
+	e.type = (WORD)type;
+	e.thread = (WORD)thread;
+	InterlockedExchange(&e.seq, seq);
+}
+
+bool TraceRing::dump(const WCHAR *path)
+{
+	if(!m_events)
+		return false;
+	size_t length = wcslen(path);
+	bool csv = length >= 4 && !_wcsicmp(path + length - 4, L".csv");
+	FILE *fp = NULL;
+	if(_wfopen_s(&fp, path, csv ? L"w" : L"wb") || !fp)
+		return false;
+
+	// copies out what the ring holds now, events written meanwhile either
+	// come out whole or not at all
+	LONG next = m_next;
+	DWORD size = (DWORD)m_mask + 1;
+	DWORD count = (DWORD)next < size ? (DWORD)next : size;
+	TraceEvent *copy = (TraceEvent *)malloc(count * sizeof(TraceEvent) + 1);
+	if(!copy)
+	{
+		fclose(fp);
+		return false;
+	}
+	DWORD kept = 0;
+	for(LONG seq = next - (LONG)count + 1; seq != next + 1; seq++)
+	{
+		TraceEvent &e = m_events[(seq - 1) & m_mask];
+		// interlocked reads, so the copy cannot move outside them
+		if(InterlockedCompareExchange(&e.seq, 0, 0) != seq)
+			continue;
+		TraceEvent c = e;
+		if(InterlockedCompareExchange(&e.seq, 0, 0) != seq)
+			continue;
+		c.seq = 0;
+		copy[kept++] = c;
+	}
+
+	bool ok;
+	if(csv)
+	{
+		ok = fprintf(fp, "time,thread,event,frame,value\n") > 0;
+		for(DWORD i=0; i<kept && ok; i++)
+		{
+			const TraceEvent &c = copy[i];
+			ok = fprintf(fp, "%lld,%s,%s,%ld,%ld\n", (long long)c.time,
+				c.thread < TRACE_THREADS ? traceThreadNames[c.thread] : "?",
+				c.type < TRACE_EVENTS ? traceEventNames[c.type] : "?", (long)c.frame, (long)c.value) > 0;
+		}
+	}
+	else
+	{
+		TraceFileHeader h;
+		memcpy(h.magic, "DSTR", 4);
+		h.version = 1;
+		h.eventSize = sizeof(TraceEvent);
+		h.count = kept;
+		ok = fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(copy, sizeof(TraceEvent), kept, fp) == kept;
+	}
+	free(copy);
+	return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,92 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// A ring of timestamped events from every thread that touches the stream,
+// for working out afterwards why a stream stuttered.  Recording takes one
+// interlocked increment and no lock, the oldest events are overwritten.
+// dump writes what the ring holds, oldest first.
+
+enum TRACE_EVENT
+{
+	TRACE_STATE,			// run, pause or stop asked for, value is the STREAM_STATE, frame the request
+	TRACE_STATE_ACTED,		// the worker acted on it
+	TRACE_BUFFER_WAIT,		// GetBuffer called
+	TRACE_BUFFER_ACQUIRE,	// GetBuffer returned, value is the HRESULT
+	TRACE_FRAME_START,		// drawing started
+	TRACE_FRAME_END,		// drawing ended, value is the bytes drawn, 0 for a repeat
+	TRACE_FRAME_DROP,		// late frame counted off without drawing
+	TRACE_QUEUED,			// pushed for delivery, value is the frames queued
+	TRACE_DELIVER_START,	// Receive called
+	TRACE_DELIVER_END,		// Receive returned, value is the HRESULT
+	TRACE_BUFFER_RELEASE,	// sample released after delivery, value 1 if it was not sent
+	TRACE_NOTIFY,			// quality message, value is Late in us, frame the Proportion
+	TRACE_EVENTS
+};
+
+enum TRACE_THREAD
+{
+	TRACE_CONTROL,		// the graph's calls on the filter
+	TRACE_WORKER,
+	TRACE_DELIVERY,
+	TRACE_DOWNSTREAM,	// quality messages
+	TRACE_THREADS
+};
+
+// As kept and as written to binary dumps, after a TraceFileHeader
+struct TraceEvent
+{
+	LONGLONG time;		// Performance counter, 100 ns
+	LONG frame;			// Frame number, or as the event says
+	LONG value;
+	WORD type;			// TRACE_EVENT
+	WORD thread;		// TRACE_THREAD
+	LONG seq;			// Index in the ring plus 1 once written, 0 in files
+};
+
+struct TraceFileHeader
+{
+	char magic[4];		// "DSTR"
+	DWORD version;		// 1
+	DWORD eventSize;	// sizeof(TraceEvent)
+	DWORD count;
+};
+
+class TraceRing
+{
+	TraceEvent *m_events;
+	LONG m_mask;
+	volatile LONG m_next;
+	CounterClock m_clock;
+public:
+	TraceRing();
+	~TraceRing();
+	// Once, before anything records.  Rounded up to a power of two, 0
+	// leaves tracing off.
+	void allocate(unsigned int events);
+	void record(TRACE_EVENT type, TRACE_THREAD thread, LONG frame, LONG value);
+	// CSV for a path ending .csv, otherwise binary
+	bool dump(const WCHAR *path);
+};
@@ -0,0 +1,278 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+// Times FrameRenderer, the code behind COutputPin1::FillBuffer, for every
+// format at a few frame sizes, without DirectShow.  One CSV row per format,
+// size and mode goes to stdout.
+//
+// Modes:
+//   draw   - the background is drawn again for every frame, as after a
+//            media type change
+//   copy   - the background is copied into every frame, as for buffers the
+//            renderer has not seen before
+//   steady - buffers come back and only the old label is repainted, as
+//            while streaming
+//
+// gbps counts whole frames, so in steady mode it is far more than the bytes
+// actually written.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <windows.h>
+#include "draw.h"
+#include "render.h"
+
+// the linker makes this on Windows, readTextFile passes it to GetModuleFileNameW
+EXTERN_C IMAGE_DOS_HEADER __ImageBase;
+IMAGE_DOS_HEADER __ImageBase;
+
+static const int defaultSizes[][2] =
+{
+	{640, 480},
+	{1920, 1080},
+	{3840, 2160},
+	{7680, 4320},
+};
+
+enum { MAX_CHOICES = 64, MAX_BUFFERS = 16 };
+
+enum BENCH_MODE { MODE_DRAW, MODE_COPY, MODE_STEADY, MODE_COUNT };
+static const char *modeNames[MODE_COUNT] = {"draw", "copy", "steady"};
+
+struct BenchOptions
+{
+	double seconds;				// Timed per format, size and mode
+	DWORD threads;				// As RenderThreads
+	DWORD stripeHeight;			// As StripeHeight
+	DWORD streamingThreshold;	// As StreamingThreshold
+	unsigned int buffers;		// Sample buffers handed out in turn
+	int formats[FORMATS_COUNT];
+	unsigned int formatCount;	// 0 for all
+	int sizes[MAX_CHOICES][2];
+	unsigned int sizeCount;		// 0 for defaultSizes
+	bool modes[MODE_COUNT];
+};
+
+static double now()
+{
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER t;
+	if(!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)freq.QuadPart;
+}
+
+static int findFormat(const char *name)
+{
+	for(int i=0; i<FORMATS_COUNT; i++)
+	{
+		if(!strcmp(name, our_format_to_text((OUR_FORMATS)i)))
+			return i;
+	}
+	return -1;
+}
+
+// Renders frames until opt.seconds have passed and prints the CSV row
+static void benchOne(FrameRenderer &renderer, OUR_FORMATS format, int width, int height, BENCH_MODE mode, const BenchOptions &opt)
+{
+	renderer.setFormat(format, width, height, false);
+	DWORD frameBytes = renderer.frameBytes();
+
+	BYTE *buffers[MAX_BUFFERS];
+	unsigned int count = 0;
+	for(; count<opt.buffers; count++)
+	{
+		buffers[count] = (BYTE *)_aligned_malloc(frameBytes + 64, 64);
+		if(!buffers[count])
+			break;
+	}
+	if(count < opt.buffers)
+	{
+		fprintf(stderr, "%s %dx%d: out of memory\n", our_format_to_text(format), width, height);
+		while(count)
+			_aligned_free(buffers[--count]);
+		return;
+	}
+
+	// the first pass draws the background and touches every buffer
+	unsigned int framecount = 0;
+	for(unsigned int i=0; i<count; i++)
+		renderer.render(buffers[i], ++framecount);
+
+	unsigned int frames = 0;
+	double start = now();
+	double elapsed = 0;
+	do
+	{
+		if(mode == MODE_DRAW)
+			renderer.invalidate();
+		else if(mode == MODE_COPY)
+			renderer.forgetBuffers();
+		renderer.render(buffers[frames % count], ++framecount);
+		frames++;
+		elapsed = now() - start;
+	} while(elapsed < opt.seconds || frames < count);
+
+	double pixels = (double)frames * width * height;
+	printf("%s,%d,%d,%u,%s,%u,%.6f,%.2f,%.3f,%.4f\n", our_format_to_text(format), width, height, frameBytes,
+		modeNames[mode], frames, elapsed, frames / elapsed,
+		(double)frames * frameBytes / elapsed / 1e9, elapsed * 1e9 / pixels);
+	fflush(stdout);
+
+	for(unsigned int i=0; i<count; i++)
+		_aligned_free(buffers[i]);
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: bench [options]\n"
+		"  -f FORMAT   only this format, by its label (RGB32, YUY2, v210, ...), may repeat\n"
+		"  -s WxH      only this frame size, may repeat, default 640x480 1920x1080 3840x2160 7680x4320\n"
+		"  -m MODE     draw, copy or steady, may repeat, default all three\n"
+		"  -t SECONDS  time for each format, size and mode, default 0.25\n"
+		"  -j THREADS  render threads, 0 for one per processor, default 0\n"
+		"  -h ROWS     stripe height, 0 for whole frames, default 64\n"
+		"  -S BYTES    streaming store threshold, 0 for never, default 4194304\n"
+		"  -b BUFFERS  sample buffers to rotate through, default 3\n"
+		"  -l          list the formats\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions opt;
+	memset(&opt, 0, sizeof(opt));
+	opt.seconds = 0.25;
+	opt.stripeHeight = 64;
+	opt.streamingThreshold = 4*1024*1024;
+	opt.buffers = 3;
+
+	for(int i=1; i<argc; i++)
+	{
+		const char *arg = argv[i];
+		if(arg[0] != '-' || !arg[1] || arg[2])
+			usage();
+		if(arg[1] == 'l')
+		{
+			for(int f=0; f<FORMATS_COUNT; f++)
+				printf("%s\n", our_format_to_text((OUR_FORMATS)f));
+			return 0;
+		}
+		if(i + 1 >= argc)
+			usage();
+		const char *value = argv[++i];
+		switch(arg[1])
+		{
+		case 'f':
+		{
+			int format = findFormat(value);
+			if(format < 0)
+			{
+				fprintf(stderr, "unknown format %s, -l lists them\n", value);
+				return 2;
+			}
+			if(opt.formatCount < FORMATS_COUNT)
+				opt.formats[opt.formatCount++] = format;
+			break;
+		}
+		case 's':
+		{
+			int w, h;
+			if(sscanf(value, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+				usage();
+			if(opt.sizeCount < MAX_CHOICES)
+			{
+				opt.sizes[opt.sizeCount][0] = w;
+				opt.sizes[opt.sizeCount][1] = h;
+				opt.sizeCount++;
+			}
+			break;
+		}
+		case 'm':
+		{
+			int mode = 0;
+			while(mode < MODE_COUNT && strcmp(value, modeNames[mode]))
+				mode++;
+			if(mode == MODE_COUNT)
+				usage();
+			opt.modes[mode] = true;
+			break;
+		}
+		case 't': opt.seconds = atof(value); break;
+		case 'j': opt.threads = (DWORD)atoi(value); break;
+		case 'h': opt.stripeHeight = (DWORD)atoi(value); break;
+		case 'S': opt.streamingThreshold = (DWORD)strtoul(value, NULL, 0); break;
+		case 'b':
+			opt.buffers = (unsigned int)atoi(value);
+			if(opt.buffers < 1 || opt.buffers > MAX_BUFFERS)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	if(!opt.modes[MODE_DRAW] && !opt.modes[MODE_COPY] && !opt.modes[MODE_STEADY])
+	{
+		for(int m=0; m<MODE_COUNT; m++)
+			opt.modes[m] = true;
+	}
+	if(!opt.formatCount)
+	{
+		for(int f=0; f<FORMATS_COUNT; f++)
+			opt.formats[opt.formatCount++] = f;
+	}
+	if(!opt.sizeCount)
+	{
+		for(unsigned int i=0; i<sizeof(defaultSizes)/sizeof(defaultSizes[0]); i++)
+		{
+			opt.sizes[i][0] = defaultSizes[i][0];
+			opt.sizes[i][1] = defaultSizes[i][1];
+		}
+		opt.sizeCount = sizeof(defaultSizes)/sizeof(defaultSizes[0]);
+	}
+
+	FrameRenderer renderer;
+	renderer.setTuning(opt.streamingThreshold, opt.threads, opt.stripeHeight);
+
+	printf("format,width,height,frame_bytes,mode,frames,seconds,fps,gbps,ns_per_pixel\n");
+	for(unsigned int f=0; f<opt.formatCount; f++)
+	{
+		for(unsigned int s=0; s<opt.sizeCount; s++)
+		{
+			for(int m=0; m<MODE_COUNT; m++)
+			{
+				if(opt.modes[m])
+					benchOne(renderer, (OUR_FORMATS)opt.formats[f], opt.sizes[s][0], opt.sizes[s][1], (BENCH_MODE)m, opt);
+			}
+		}
+	}
+	return 0;
+}
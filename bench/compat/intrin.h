@@ -0,0 +1,88 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// The MSVC intrinsics the drawing code uses, for gcc on x86
+
+#ifndef BENCH_COMPAT_INTRIN_H
+#define BENCH_COMPAT_INTRIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <x86intrin.h>
+#include <cpuid.h>
+
+// fill.cpp uses rep stosq on 64 bit builds
+#if defined(__x86_64__) && !defined(_M_AMD64)
+#define _M_AMD64
+#endif
+
+#define __forceinline inline __attribute__((always_inline))
+#define __declspec(x) __declspec_##x
+#define __declspec_thread __thread
+#define __declspec_align(n) __attribute__((aligned(n)))
+
+#undef __cpuid
+static inline void __cpuid(int info[4], int leaf)
+{
+	__cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+}
+// newer cpuid.h has its own
+#if defined(__clang__) || __GNUC__ < 11
+static inline void __cpuidex(int info[4], int leaf, int subleaf)
+{
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+}
+#endif
+
+static inline void __stosq(unsigned long long *dest, unsigned long long value, size_t count)
+{
+	__asm__ __volatile__("rep stosq" : "+D"(dest), "+c"(count) : "a"(value) : "memory");
+}
+
+static inline unsigned short _byteswap_ushort(unsigned short v) {return __builtin_bswap16(v);}
+static inline unsigned long _byteswap_ulong(unsigned long v) {return __builtin_bswap32((unsigned int)v);}
+static inline unsigned long long _byteswap_uint64(unsigned long long v) {return __builtin_bswap64(v);}
+
+#undef _lrotl
+static inline unsigned int _lrotl(unsigned int v, int shift)
+{
+	shift &= 31;
+	return shift ? (v << shift) | (v >> (32 - shift)) : v;
+}
+#undef _rotr64
+static inline unsigned long long _rotr64(unsigned long long v, int shift)
+{
+	shift &= 63;
+	return shift ? (v >> shift) | (v << (64 - shift)) : v;
+}
+#undef _rotl64
+static inline unsigned long long _rotl64(unsigned long long v, int shift)
+{
+	shift &= 63;
+	return shift ? (v << shift) | (v >> (64 - shift)) : v;
+}
+
+#endif
@@ -0,0 +1,362 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// Just enough of windows.h for draw.cpp, fill.cpp, pool.cpp, render.cpp,
+// schedule.cpp and ring.cpp to build with gcc on Linux, for the benchmarks.
+
+#ifndef BENCH_COMPAT_WINDOWS_H
+#define BENCH_COMPAT_WINDOWS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <intrin.h>
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef int LONG;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef size_t SIZE_T;
+typedef void *LPVOID;
+typedef void *HINSTANCE;
+typedef wchar_t WCHAR;
+typedef union { struct { DWORD LowPart; LONG HighPart; } u; LONGLONG QuadPart; } LARGE_INTEGER;
+typedef struct { WORD e_magic; } IMAGE_DOS_HEADER;
+
+#define WINAPI
+#define EXTERN_C extern "C"
+#define INFINITE 0xFFFFFFFF
+#define MAXLONG 0x7fffffff
+#define TRUE 1
+#define FALSE 0
+
+// Events, semaphores and threads are all waitable handles
+struct CompatHandle
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int kind;				// 0 event, 1 semaphore, 2 thread, 4 file mapping
+	BOOL manual;
+	long count;				// set for events, the count for semaphores
+	pthread_t thread;
+	DWORD (WINAPI *start)(LPVOID);
+	LPVOID param;
+	int fd;					// File mappings
+};
+typedef CompatHandle *HANDLE;
+
+static inline HANDLE compatNewHandle(int kind, BOOL manual, long count)
+{
+	HANDLE h = new CompatHandle;
+	h->fd = -1;
+	pthread_mutex_init(&h->mutex, NULL);
+	pthread_cond_init(&h->cond, NULL);
+	h->kind = kind;
+	h->manual = manual;
+	h->count = count;
+	return h;
+}
+static inline HANDLE CreateEvent(void *, BOOL manual, BOOL initial, void *)
+{
+	return compatNewHandle(0, manual, initial ? 1 : 0);
+}
+static inline HANDLE CreateSemaphore(void *, LONG initial, LONG, void *)
+{
+	return compatNewHandle(1, FALSE, initial);
+}
+static inline BOOL compatSignal(HANDLE h, long count)
+{
+	pthread_mutex_lock(&h->mutex);
+	if(h->kind == 0)
+		h->count = 1;
+	else
+		h->count += count;
+	pthread_cond_broadcast(&h->cond);
+	pthread_mutex_unlock(&h->mutex);
+	return TRUE;
+}
+static inline BOOL SetEvent(HANDLE h) {return compatSignal(h, 1);}
+static inline BOOL ReleaseSemaphore(HANDLE h, LONG count, LONG *) {return compatSignal(h, count);}
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+static inline DWORD WaitForSingleObject(HANDLE h, DWORD timeout)
+{
+	if(h->kind == 2)
+	{
+		pthread_join(h->thread, NULL);
+		h->kind = 3;
+		return 0;
+	}
+	if(h->kind == 3)
+		return 0;
+	struct timespec until;
+	if(timeout != INFINITE)
+	{
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += timeout / 1000;
+		until.tv_nsec += (long)(timeout % 1000) * 1000000;
+		if(until.tv_nsec >= 1000000000)
+		{
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+	}
+	pthread_mutex_lock(&h->mutex);
+	while(h->count == 0)
+	{
+		if(timeout == INFINITE)
+			pthread_cond_wait(&h->cond, &h->mutex);
+		else if(pthread_cond_timedwait(&h->cond, &h->mutex, &until) != 0)
+		{
+			pthread_mutex_unlock(&h->mutex);
+			return WAIT_TIMEOUT;
+		}
+	}
+	if(!(h->kind == 0 && h->manual))
+		h->count--;
+	pthread_mutex_unlock(&h->mutex);
+	return WAIT_OBJECT_0;
+}
+static inline DWORD WaitForMultipleObjects(DWORD count, HANDLE *handles, BOOL, DWORD timeout)
+{
+	for(DWORD i=0; i<count; i++)
+		WaitForSingleObject(handles[i], timeout);
+	return 0;
+}
+static inline BOOL CloseHandle(HANDLE h)
+{
+	if(h->kind == 2)
+		pthread_detach(h->thread);
+	if(h->fd >= 0)
+		close(h->fd);
+	pthread_cond_destroy(&h->cond);
+	pthread_mutex_destroy(&h->mutex);
+	delete h;
+	return TRUE;
+}
+static void *compatThreadStart(void *param)
+{
+	HANDLE h = (HANDLE)param;
+	h->start(h->param);
+	return NULL;
+}
+static inline HANDLE CreateThread(void *, size_t stack, DWORD (WINAPI *start)(LPVOID), LPVOID param, DWORD, DWORD *)
+{
+	HANDLE h = compatNewHandle(2, FALSE, 0);
+	h->start = start;
+	h->param = param;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	if(stack)
+		pthread_attr_setstacksize(&attr, stack < 65536 ? 65536 : stack);
+	pthread_create(&h->thread, &attr, compatThreadStart, h);
+	pthread_attr_destroy(&attr);
+	return h;
+}
+
+static inline LONG InterlockedIncrement(volatile LONG *p) {return __sync_add_and_fetch(p, 1);}
+static inline LONG InterlockedDecrement(volatile LONG *p) {return __sync_sub_and_fetch(p, 1);}
+static inline LONG InterlockedIncrement(volatile long *p) {return (LONG)__sync_add_and_fetch(p, 1);}
+static inline LONG InterlockedDecrement(volatile long *p) {return (LONG)__sync_sub_and_fetch(p, 1);}
+static inline LONG InterlockedExchange(volatile LONG *p, LONG value) {__sync_synchronize(); return __sync_lock_test_and_set(p, value);}
+static inline LONGLONG InterlockedCompareExchange64(volatile LONGLONG *p, LONGLONG value, LONGLONG comparand) {return __sync_val_compare_and_swap(p, comparand, value);}
+#define MemoryBarrier() __sync_synchronize()
+
+// File mappings.  Names with a / in them are files, others are POSIX
+// shared memory, as Local\Name becomes /Local.Name in /dev/shm.  Creating
+// always makes a new object, as the name goes on Windows once its last
+// handle closes, readers still mapping the old one keep it.
+#define INVALID_HANDLE_VALUE ((HANDLE)0)
+#define PAGE_READWRITE 4
+#define FILE_MAP_READ 4
+#define FILE_MAP_ALL_ACCESS 6
+#define ERROR_SUCCESS 0
+#define ERROR_ALREADY_EXISTS 183
+static inline DWORD GetLastError() {return ERROR_SUCCESS;}
+static inline int compatOpenMapping(const char *name, int flags)
+{
+	if(strchr(name, '/'))
+	{
+		if(flags & O_CREAT)
+			unlink(name);
+		return open(name, flags, 0644);
+	}
+	char shm[256];
+	snprintf(shm, sizeof(shm), "/%s", name);
+	for(char *c = shm + 1; *c; c++)
+	{
+		if(*c == '\\')
+			*c = '.';
+	}
+	if(flags & O_CREAT)
+		shm_unlink(shm);
+	return shm_open(shm, flags, 0644);
+}
+static inline HANDLE CreateFileMappingA(HANDLE, void *, DWORD, DWORD high, DWORD low, const char *name)
+{
+	int fd = compatOpenMapping(name, O_RDWR | O_CREAT | O_EXCL);
+	if(fd < 0)
+		return NULL;
+	if(ftruncate(fd, (off_t)(((ULONGLONG)high << 32) | low)) != 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	HANDLE h = compatNewHandle(4, FALSE, 0);
+	h->fd = fd;
+	return h;
+}
+static inline HANDLE OpenFileMappingA(DWORD, BOOL, const char *name)
+{
+	int fd = compatOpenMapping(name, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+	HANDLE h = compatNewHandle(4, FALSE, 0);
+	h->fd = fd;
+	return h;
+}
+// munmap needs the length, UnmapViewOfFile has only the address
+struct CompatView { void *p; size_t size; };
+static CompatView compatViews[16];
+static inline void *MapViewOfFile(HANDLE h, DWORD access, DWORD, DWORD, SIZE_T size)
+{
+	struct stat st;
+	if(!size)
+	{
+		if(fstat(h->fd, &st) != 0)
+			return NULL;
+		size = (size_t)st.st_size;
+	}
+	int prot = access == FILE_MAP_READ ? PROT_READ : PROT_READ | PROT_WRITE;
+	void *p = mmap(NULL, size, prot, MAP_SHARED, h->fd, 0);
+	if(p == MAP_FAILED)
+		return NULL;
+	for(int i=0; i<16; i++)
+	{
+		if(!compatViews[i].p)
+		{
+			compatViews[i].p = p;
+			compatViews[i].size = size;
+			return p;
+		}
+	}
+	munmap(p, size);
+	return NULL;
+}
+static inline BOOL UnmapViewOfFile(const void *p)
+{
+	for(int i=0; i<16; i++)
+	{
+		if(compatViews[i].p == p)
+		{
+			munmap(compatViews[i].p, compatViews[i].size);
+			compatViews[i].p = NULL;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+struct SYSTEM_INFO { DWORD dwNumberOfProcessors; };
+static inline void GetSystemInfo(SYSTEM_INFO *info)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	info->dwNumberOfProcessors = n > 0 ? (DWORD)n : 1;
+}
+
+static inline BOOL QueryPerformanceFrequency(LARGE_INTEGER *f)
+{
+	f->QuadPart = 1000000000;
+	return TRUE;
+}
+static inline BOOL QueryPerformanceCounter(LARGE_INTEGER *c)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	c->QuadPart = (LONGLONG)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	return TRUE;
+}
+
+static inline void Sleep(DWORD ms)
+{
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long)(ms % 1000) * 1000000;
+	nanosleep(&ts, NULL);
+}
+#define YieldProcessor() _mm_pause()
+
+// timer resolution is already fine grained
+#define TIMERR_NOERROR 0
+static inline unsigned int timeBeginPeriod(unsigned int) {return TIMERR_NOERROR;}
+static inline unsigned int timeEndPeriod(unsigned int) {return TIMERR_NOERROR;}
+
+static inline void *_aligned_malloc(size_t size, size_t alignment)
+{
+	void *p = NULL;
+	if(posix_memalign(&p, alignment, size))
+		return NULL;
+	return p;
+}
+static inline void _aligned_free(void *p) {free(p);}
+
+// readTextFile looks for 8X8.BMP beside the module, here the executable
+static inline DWORD GetModuleFileNameW(HINSTANCE, WCHAR *path, DWORD size)
+{
+	char buf[4096];
+	ssize_t n = readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+	if(n < 0)
+		n = 0;
+	buf[n] = 0;
+	size_t len = mbstowcs(path, buf, size - 1);
+	if(len == (size_t)-1)
+		len = 0;
+	path[len] = 0;
+	return (DWORD)len;
+}
+static inline int _wfopen_s(FILE **fp, const WCHAR *path, const WCHAR *mode)
+{
+	char name[4096];
+	char m[8];
+	if(wcstombs(name, path, sizeof(name)) == (size_t)-1 || wcstombs(m, mode, sizeof(m)) == (size_t)-1)
+		return 1;
+	*fp = fopen(name, m);
+	return *fp == NULL;
+}
+
+#endif
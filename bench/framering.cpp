@@ -0,0 +1,311 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+// The reference reader for the pin's SharedRing, and a writer that fills a
+// ring the way the pin does, so both sides run without DirectShow.  The
+// reader follows the ring, checks each slot header places the picture
+// inside its frame, sums every frame where it lies in the mapping and checks
+// it was not overwritten meanwhile, then prints one CSV row.
+//
+//   framering -w            writes frames until -n is reached
+//   framering               reads frames until -n is reached or the writer goes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "draw.h"
+#include "render.h"
+#include "ring.h"
+
+// the linker makes this on Windows, readTextFile passes it to GetModuleFileNameW
+EXTERN_C IMAGE_DOS_HEADER __ImageBase;
+IMAGE_DOS_HEADER __ImageBase;
+
+struct RingOptions
+{
+	const char *name;
+	bool write;
+	int frames;					// 0 for until the writer goes
+	double fps;
+	int format;
+	int width;
+	int height;
+	unsigned int slots;
+	int delay;					// Reader, microseconds spent on each frame
+	bool verbose;
+};
+
+static LONGLONG counter()
+{
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return t.QuadPart;
+}
+
+static LONGLONG counterFrequency()
+{
+	LARGE_INTEGER f;
+	QueryPerformanceFrequency(&f);
+	return f.QuadPart;
+}
+
+static void waitUntil(LONGLONG t)
+{
+	LONGLONG ms = (t - counter()) * 1000 / counterFrequency();
+	if(ms > 1)
+		Sleep((DWORD)(ms - 1));
+	while(counter() < t)
+		YieldProcessor();
+}
+
+static int findFormat(const char *name)
+{
+	for(int i=0; i<FORMATS_COUNT; i++)
+	{
+		if(!strcmp(name, our_format_to_text((OUR_FORMATS)i)))
+			return i;
+	}
+	return -1;
+}
+
+// The picture is in the surface and its first row, at offset, in the frame
+static bool targetInside(const FrameSlotHeader &info)
+{
+	LONG height = info.height < 0 ? -info.height : info.height;
+	if(info.targetLeft < 0 || info.targetTop < 0 || info.targetWidth <= 0 || info.targetHeight <= 0)
+		return false;
+	if(info.targetLeft + info.targetWidth > info.width || info.targetTop + info.targetHeight > height)
+		return false;
+	return info.offset < info.size;
+}
+
+static int writeRing(const RingOptions &opt)
+{
+	FrameRenderer renderer;
+	renderer.setTuning(4*1024*1024, 1, 0);
+	renderer.setBufferCount(opt.slots);
+	renderer.setFormat((OUR_FORMATS)opt.format, opt.width, opt.height, false);
+	DWORD frameBytes = renderer.frameBytes();
+
+	FrameRing ring;
+	if(!ring.create(opt.name, opt.slots, frameBytes))
+	{
+		fprintf(stderr, "cannot make the ring %s\n", opt.name);
+		return 1;
+	}
+
+	FrameSlotHeader info;
+	memset(&info, 0, sizeof(info));
+	info.format = opt.format;
+	info.width = opt.width;
+	info.height = -opt.height;
+	info.pitch = getPitch((OUR_FORMATS)opt.format, opt.width);
+	info.size = frameBytes;
+	// no downstream here, the picture is the whole surface
+	info.targetWidth = opt.width;
+	info.targetHeight = opt.height;
+
+	LONGLONG frequency = counterFrequency();
+	LONGLONG start = counter();
+	int frames = opt.frames ? opt.frames : 600;
+	for(int n=0; n<frames; n++)
+	{
+		waitUntil(start + (LONGLONG)(n * frequency / opt.fps));
+		BYTE *data = ring.beginFrame(frameBytes);
+		renderer.render(data, n + 1);
+		info.start = (LONGLONG)(n * 10000000.0 / opt.fps);
+		info.stop = (LONGLONG)((n + 1) * 10000000.0 / opt.fps);
+		info.frame = n;
+		info.counter = counter();
+		ring.publishFrame(info);
+	}
+	ring.close();
+	printf("written,%s,%dx%d,%u,%d\n", our_format_to_text((OUR_FORMATS)opt.format),
+		opt.width, opt.height, frameBytes, frames);
+	return 0;
+}
+
+static int readRing(const RingOptions &opt)
+{
+	FrameRing ring;
+	for(int tries = 0; !ring.open(opt.name); tries++)
+	{
+		if(tries == 500)
+		{
+			fprintf(stderr, "no ring %s\n", opt.name);
+			return 1;
+		}
+		Sleep(10);
+	}
+	const FrameRingHeader *header = ring.header();
+	LONGLONG frequency = counterFrequency();
+
+	unsigned long long sum = 0;
+	int read = 0;
+	int skipped = 0;		// Overwritten before we got to them
+	int torn = 0;			// Overwritten while we used them
+	int bad = 0;			// Headers whose picture is not inside the frame
+	double latencySum = 0;
+	double latencyMax = 0;
+	LONG next = header->published;
+	while(!opt.frames || read < opt.frames)
+	{
+		LONG published = header->published;
+		if((LONG)(published - next) <= 0)
+		{
+			if(header->closed)
+				break;
+			Sleep(1);
+			continue;
+		}
+		// the writer may be in the slot after the newest
+		if((LONG)(published - next) >= (LONG)header->slotCount)
+		{
+			skipped += published - 1 - next;
+			next = published - 1;
+		}
+
+		FrameSlotHeader info;
+		const BYTE *data = ring.readFrame(next, &info);
+		if(!data)
+		{
+			skipped++;
+			next++;
+			continue;
+		}
+		if(!targetInside(info))
+			bad++;
+		double latency = (double)(counter() - info.counter) * 1000000.0 / frequency;
+		const unsigned long long *words = (const unsigned long long *)data;
+		unsigned long long frameSum = 0;
+		for(DWORD i=0; i<info.size/8; i++)
+			frameSum += words[i];
+		if(opt.delay)
+			waitUntil(counter() + (LONGLONG)opt.delay * frequency / 1000000);
+		if(!ring.stillValid(next))
+		{
+			torn++;
+			next++;
+			continue;
+		}
+		if(opt.verbose)
+			printf("frame,%lld,%lld,%u,%ld,%ld,%ld,%ld,%u,%.1f,%016llx\n", info.frame, info.start, info.size,
+				(long)info.targetLeft, (long)info.targetTop, (long)info.targetWidth, (long)info.targetHeight,
+				info.offset, latency, frameSum);
+		sum += frameSum;
+		latencySum += latency;
+		if(latency > latencyMax)
+			latencyMax = latency;
+		read++;
+		next++;
+	}
+	printf("read,skipped,torn,bad,mean_latency_us,max_latency_us,sum\n");
+	printf("%d,%d,%d,%d,%.1f,%.1f,%016llx\n", read, skipped, torn, bad,
+		read ? latencySum / read : 0.0, latencyMax, sum);
+	return 0;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: framering [options] [name]\n"
+		"  name        the ring, default Local\\DShowTestCaptureRing, a path for a file\n"
+		"  -w          write frames instead of reading them\n"
+		"  -n FRAMES   frames to write or read, default 600 written, reading until the writer goes\n"
+		"  -r FPS      writer frame rate, default 60\n"
+		"  -f FORMAT   writer format, by its label, default YUY2\n"
+		"  -s WxH      writer frame size, default 1920x1080\n"
+		"  -k SLOTS    writer slots, as SharedRing, default 4\n"
+		"  -d MICROS   reader time spent on each frame, default 0\n"
+		"  -v          reader prints a row for every frame\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	RingOptions opt;
+	memset(&opt, 0, sizeof(opt));
+	opt.name = FRAME_RING_NAME;
+	opt.fps = 60;
+	opt.format = FORMATS_YUY2;
+	opt.width = 1920;
+	opt.height = 1080;
+	opt.slots = 4;
+
+	for(int i=1; i<argc; i++)
+	{
+		const char *arg = argv[i];
+		if(arg[0] != '-')
+		{
+			opt.name = arg;
+			continue;
+		}
+		if(!arg[1] || arg[2])
+			usage();
+		if(arg[1] == 'w' || arg[1] == 'v')
+		{
+			if(arg[1] == 'w')
+				opt.write = true;
+			else
+				opt.verbose = true;
+			continue;
+		}
+		if(i + 1 >= argc)
+			usage();
+		const char *value = argv[++i];
+		switch(arg[1])
+		{
+		case 'n': opt.frames = atoi(value); break;
+		case 'r':
+			opt.fps = atof(value);
+			if(opt.fps <= 0)
+				usage();
+			break;
+		case 'f':
+			opt.format = findFormat(value);
+			if(opt.format < 0)
+			{
+				fprintf(stderr, "unknown format %s, bench -l lists them\n", value);
+				return 2;
+			}
+			break;
+		case 's':
+			if(sscanf(value, "%dx%d", &opt.width, &opt.height) != 2 || opt.width <= 0 || opt.height <= 0)
+				usage();
+			break;
+		case 'k':
+			opt.slots = (unsigned int)atoi(value);
+			if(opt.slots < 2)
+				usage();
+			break;
+		case 'd': opt.delay = atoi(value); break;
+		default:
+			usage();
+		}
+	}
+	return opt.write ? writeRing(opt) : readRing(opt);
+}
@@ -0,0 +1,194 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2015   Samuel Williams
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+// Runs FrameScheduler the way COutputPin1 does, against a stand-in for the
+// graph clock that runs a set number of parts per million fast or slow of
+// the performance counter, like an audio renderer's clock.  Frames should
+// follow the stand-in, so stream_seconds matches the stream and
+// counter_seconds is off by the drift.  With a drawing time longer than the
+// frame time, -l shows what each LatePolicy mode does about it.  One CSV row
+// goes to stdout.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include "schedule.h"
+
+// The performance counter, scaled by 1 + ppm / 1000000
+class StandInClock : public SchedulerClock
+{
+	CounterClock m_counter;
+	long long m_start;
+	double m_rate;
+public:
+	StandInClock(double ppm)
+	{
+		m_start = m_counter.now();
+		m_rate = 1.0 + ppm / 1000000.0;
+	}
+	long long now()
+	{
+		return m_start + (long long)((m_counter.now() - m_start) * m_rate);
+	}
+	void sleepUntil(long long t, HANDLE)
+	{
+		long long wait = (long long)((t - now()) / m_rate);
+		if(wait > 0)
+			Sleep((DWORD)(wait / 10000));
+	}
+};
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: pacing [options]\n"
+		"  -r FPS      frame rate, default 59.94\n"
+		"  -n FRAMES   frames to send, default 600\n"
+		"  -p PPM      stand-in clock drift, default 500\n"
+		"  -c          pace on the performance counter, as with no graph clock\n"
+		"  -S MICROS   spin time, as SpinTime, default 2000\n"
+		"  -w MICROS   drawing time for each frame, default 2000\n"
+		"  -l MODE     late frames, as LatePolicy: 0 send, 1 drop, 2 repeat, 3 slow, default 0\n");
+	exit(2);
+}
+
+static const char *lateModeNames[LATE_MODES] = {"send", "drop", "repeat", "slow"};
+
+// Stamps frames as COutputPin1 does, in whole frames since the frame time
+// last changed
+struct SampleTimes
+{
+	long long base;
+	long long step;
+	long long frame;
+
+	long long next(long long frameTime)
+	{
+		if(step != frameTime)
+		{
+			base += framesToTime(frame, step);
+			step = frameTime;
+			frame = 0;
+		}
+		return base + framesToTime(frame++, step);
+	}
+};
+
+int main(int argc, char **argv)
+{
+	double fps = 59.94;
+	long long frames = 600;
+	double ppm = 500;
+	bool counter = false;
+	long long spin = 2000;
+	long long work = 2000;
+	int mode = LATE_SEND;
+
+	for(int i=1; i<argc; i++)
+	{
+		const char *arg = argv[i];
+		if(arg[0] != '-' || !arg[1] || arg[2])
+			usage();
+		if(arg[1] == 'c')
+		{
+			counter = true;
+			continue;
+		}
+		if(i + 1 >= argc)
+			usage();
+		const char *value = argv[++i];
+		switch(arg[1])
+		{
+		case 'r': fps = atof(value); break;
+		case 'n': frames = atoll(value); break;
+		case 'p': ppm = atof(value); break;
+		case 'S': spin = atoll(value); break;
+		case 'w': work = atoll(value); break;
+		case 'l': mode = atoi(value); break;
+		default: usage();
+		}
+	}
+	if(fps <= 0 || frames < 1 || mode < 0 || mode >= LATE_MODES)
+		usage();
+
+	// as AvgTimePerFrame, 29.97 is 333667
+	long long frameTime = (long long)(10000000 / fps);
+
+	StandInClock standIn(ppm);
+	CounterClock wall;
+	FrameScheduler scheduler;
+	scheduler.start(counter ? NULL : &standIn, spin * 10);
+	// the graph starts streams a little in the future
+	long long tStart = scheduler.now() + 100000;
+	scheduler.setBase(tStart);
+
+	LatePolicy late;
+	late.start((LATE_MODE)mode, frameTime);
+	SampleTimes stamps = {0, frameTime, 0};
+
+	// from sending the first frame to sending the last
+	long long streamStart = 0, wallStart = 0, firstDue = -1, lastDue = 0;
+	for(long long n=0; n<frames; n++)
+	{
+		long long t = stamps.next(late.frameTime());
+		LATE_ACTION action = late.decide(t, scheduler.streamTime());
+		if(action == FRAME_SKIP)
+			continue;
+		// drawing it, a repeat sends the last picture again
+		if(action == FRAME_REPEAT)
+			late.repeated();
+		else
+		{
+			long long done = wall.now() + work * 10;
+			while(wall.now() < done)
+				YieldProcessor();
+		}
+		late.sent(scheduler.wait(t));
+		if(firstDue < 0)
+		{
+			streamStart = scheduler.now();
+			wallStart = wall.now();
+			firstDue = t;
+		}
+		lastDue = t;
+	}
+	double streamSeconds = (scheduler.now() - streamStart) / 10000000.0;
+	double counterSeconds = (wall.now() - wallStart) / 10000000.0;
+	scheduler.stop();
+
+	const SchedulerStats &s = scheduler.stats();
+	const LateStats &l = late.stats();
+	unsigned long long waited = s.frames - s.missed;
+	printf("clock,frame_time,frames,ppm,missed,resyncs,mean_error_us,max_error_us,due_seconds,stream_seconds,counter_seconds,"
+		"late_policy,late,dropped,repeated,slowed,recovered,final_frame_time\n");
+	printf("%s,%lld,%lld,%.1f,%llu,%llu,%.1f,%.1f,%.6f,%.6f,%.6f,%s,%llu,%llu,%llu,%llu,%llu,%lld\n", counter ? "counter" : "stand-in", frameTime, frames,
+		counter ? 0.0 : ppm, s.missed, s.resyncs, waited ? s.errorSum / (double)waited / 10 : 0.0, s.errorMax / 10.0,
+		(lastDue - firstDue) / 10000000.0, streamSeconds, counterSeconds,
+		lateModeNames[mode], l.late, l.dropped, l.repeated, l.slowed, l.recovered, late.frameTime());
+	return 0;
+}